@@ -1311,11 +1311,10 @@ class _StackerAppState extends State<StackerApp> {
     if (_analysisResult == null) return [];
 
     if (_usePercentMode) {
-      // Sort frames by quality and take top percentage
-      final sortedScores = List<FrameScore>.from(_analysisResult!.scores);
-      sortedScores.sort((a, b) => b.qualityScore.compareTo(a.qualityScore)); // Descending
+      // Take the top percentage by quality
       final count = (_analysisResult!.scores.length * _selectBestPercent / 100).round();
-      return sortedScores.take(count).map((s) => s.frameIndex).toList()..sort();
+      if (count <= 0) return [];
+      return _analysisResult!.getTopNFrames(count).map((s) => s.frameIndex).toList()..sort();
     } else {
       // Range mode - just return frame indices in range
       return List.generate(_rangeEnd - _rangeStart, (i) => _rangeStart + i);
@@ -12,6 +12,8 @@ export 'src/video/frame_extractor.dart' show FrameExtractor, VideoInfo;
 export 'src/sharpening/wavelet_sharpener.dart' show WaveletSharpener, WaveletDecomposition, WaveletPreset;
 export 'src/quality/quality_assessor.dart' show QualityAssessor;
 export 'src/alignment/phase_correlator.dart' show PhaseCorrelator, AlignmentResult;
+export 'src/alignment/frame_transform.dart' show FrameTransform;
+export 'src/alignment/warp_grid.dart' show WarpGrid;
 export 'src/stacking/sigma_clip_stacker.dart' show SigmaClipStacker;
 
 /// Library version
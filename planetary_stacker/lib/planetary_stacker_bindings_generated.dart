@@ -0,0 +1,845 @@
+// ignore_for_file: always_specify_types
+// ignore_for_file: camel_case_types
+// ignore_for_file: non_constant_identifier_names
+
+// AUTO GENERATED FILE, DO NOT EDIT.
+//
+// Generated by `package:ffigen`.
+// ignore_for_file: type=lint
+import 'dart:ffi' as ffi;
+
+/// Bindings for `src/planetary_stacker.h`.
+///
+/// Regenerate bindings with `dart run ffigen --config ffigen.yaml`.
+///
+class PlanetaryStackerBindings {
+  /// Holds the symbol lookup function.
+  final ffi.Pointer<T> Function<T extends ffi.NativeType>(String symbolName)
+      _lookup;
+
+  /// The symbols are looked up in [dynamicLibrary].
+  PlanetaryStackerBindings(ffi.DynamicLibrary dynamicLibrary)
+      : _lookup = dynamicLibrary.lookup;
+
+  /// The symbols are looked up with [lookup].
+  PlanetaryStackerBindings.fromLookup(
+      ffi.Pointer<T> Function<T extends ffi.NativeType>(String symbolName)
+          lookup)
+      : _lookup = lookup;
+
+  /// Analyze video frame quality in a single streaming decode pass.
+  ///
+  /// Frames are decoded sequentially and scored in memory; no intermediate
+  /// image files are written.
+  ///
+  /// [video_path]: Path to the input video (MP4/MOV, or SER / uncompressed AVI,
+  /// which are memory-mapped and need no decoding)
+  /// [sample_step]: Score every Nth frame (1 = all frames)
+  /// [callback]: Optional progress callback (may be NULL)
+  /// [user_data]: Passed through to the callback
+  ///
+  /// Returns a result to be released with ps_free_analysis_result(),
+  /// or NULL on failure.
+  ffi.Pointer<PSAnalysisResult> ps_analyze_video(
+    ffi.Pointer<ffi.Char> video_path,
+    int sample_step,
+    PSProgressCallback callback,
+    ffi.Pointer<ffi.Void> user_data,
+  ) {
+    return _ps_analyze_video(
+      video_path,
+      sample_step,
+      callback,
+      user_data,
+    );
+  }
+
+  late final _ps_analyze_videoPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Pointer<PSAnalysisResult> Function(
+              ffi.Pointer<ffi.Char>,
+              ffi.Int32,
+              PSProgressCallback,
+              ffi.Pointer<ffi.Void>)>>('ps_analyze_video');
+  late final _ps_analyze_video = _ps_analyze_videoPtr.asFunction<
+      ffi.Pointer<PSAnalysisResult> Function(ffi.Pointer<ffi.Char>, int,
+          PSProgressCallback, ffi.Pointer<ffi.Void>)>();
+
+  /// Default analysis options (sample_step = 3, luma_only = 1, cache off,
+  /// cache_memory_mb = 512, worker_threads = 0, decode_segments = 0,
+  /// downscale = 1, fast_decode = 0, track_planet = 1,
+  /// redetect_interval = 30, tile_size = 0, selection off, rescore_count = 0,
+  /// score_cache = 0, rank_count = 0)
+  PSAnalysisOptions ps_default_analysis_options() {
+    return _ps_default_analysis_options();
+  }
+
+  late final _ps_default_analysis_optionsPtr =
+      _lookup<ffi.NativeFunction<PSAnalysisOptions Function()>>(
+          'ps_default_analysis_options');
+  late final _ps_default_analysis_options = _ps_default_analysis_optionsPtr
+      .asFunction<PSAnalysisOptions Function()>();
+
+  /// Same as ps_analyze_video() with explicit options.
+  /// [options] may be NULL to use ps_default_analysis_options().
+  ffi.Pointer<PSAnalysisResult> ps_analyze_video_with_options(
+    ffi.Pointer<ffi.Char> video_path,
+    ffi.Pointer<PSAnalysisOptions> options,
+    PSProgressCallback callback,
+    ffi.Pointer<ffi.Void> user_data,
+  ) {
+    return _ps_analyze_video_with_options(
+      video_path,
+      options,
+      callback,
+      user_data,
+    );
+  }
+
+  late final _ps_analyze_video_with_optionsPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Pointer<PSAnalysisResult> Function(
+              ffi.Pointer<ffi.Char>,
+              ffi.Pointer<PSAnalysisOptions>,
+              PSProgressCallback,
+              ffi.Pointer<ffi.Void>)>>('ps_analyze_video_with_options');
+  late final _ps_analyze_video_with_options =
+      _ps_analyze_video_with_optionsPtr.asFunction<
+          ffi.Pointer<PSAnalysisResult> Function(
+              ffi.Pointer<ffi.Char>,
+              ffi.Pointer<PSAnalysisOptions>,
+              PSProgressCallback,
+              ffi.Pointer<ffi.Void>)>();
+
+  /// Sharpness (Laplacian variance) of image files such as extracted frames,
+  /// scored on all cores with a work-stealing scheduler.
+  ///
+  /// [paths]: [count] image file paths
+  /// [worker_threads]: Scoring threads (0 = one per core)
+  /// [out_variances]: Receives [count] values in the order of [paths]; NaN
+  /// for images that cannot be read
+  ///
+  /// Returns 0 on success, -1 on failure.
+  int ps_score_images(
+    ffi.Pointer<ffi.Pointer<ffi.Char>> paths,
+    int count,
+    int worker_threads,
+    ffi.Pointer<ffi.Double> out_variances,
+    PSProgressCallback callback,
+    ffi.Pointer<ffi.Void> user_data,
+  ) {
+    return _ps_score_images(
+      paths,
+      count,
+      worker_threads,
+      out_variances,
+      callback,
+      user_data,
+    );
+  }
+
+  late final _ps_score_imagesPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(
+              ffi.Pointer<ffi.Pointer<ffi.Char>>,
+              ffi.Int32,
+              ffi.Int32,
+              ffi.Pointer<ffi.Double>,
+              PSProgressCallback,
+              ffi.Pointer<ffi.Void>)>>('ps_score_images');
+  late final _ps_score_images = _ps_score_imagesPtr.asFunction<
+      int Function(
+          ffi.Pointer<ffi.Pointer<ffi.Char>>,
+          int,
+          int,
+          ffi.Pointer<ffi.Double>,
+          PSProgressCallback,
+          ffi.Pointer<ffi.Void>)>();
+
+  /// Extract selected frames in a single process, decoding each GOP once.
+  ///
+  /// The indices are sorted and grouped by keyframe interval, then decoded in
+  /// one forward sweep. Each frame is written to
+  /// [output_dir]/frame_NNNNNN.png, named by its frame index.
+  ///
+  /// [frame_indices]: Frame indices to extract (any order)
+  /// [count]: Number of entries in [frame_indices]
+  ///
+  /// Returns the number of frames written, or -1 on failure.
+  int ps_extract_frames(
+    ffi.Pointer<ffi.Char> video_path,
+    ffi.Pointer<ffi.Int64> frame_indices,
+    int count,
+    ffi.Pointer<ffi.Char> output_dir,
+    PSProgressCallback callback,
+    ffi.Pointer<ffi.Void> user_data,
+  ) {
+    return _ps_extract_frames(
+      video_path,
+      frame_indices,
+      count,
+      output_dir,
+      callback,
+      user_data,
+    );
+  }
+
+  late final _ps_extract_framesPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(
+              ffi.Pointer<ffi.Char>,
+              ffi.Pointer<ffi.Int64>,
+              ffi.Int32,
+              ffi.Pointer<ffi.Char>,
+              PSProgressCallback,
+              ffi.Pointer<ffi.Void>)>>('ps_extract_frames');
+  late final _ps_extract_frames = _ps_extract_framesPtr.asFunction<
+      int Function(ffi.Pointer<ffi.Char>, ffi.Pointer<ffi.Int64>, int,
+          ffi.Pointer<ffi.Char>, PSProgressCallback, ffi.Pointer<ffi.Void>)>();
+
+  /// Same as ps_extract_frames(), but writes the frames (BGR, 8-bit) to a
+  /// binary frame spool at [spool_path] instead of a PNG per frame. See
+  /// ps_spool_open() for reading it back.
+  ///
+  /// [compress]: Non-zero to store LZ4-compressed records (ignored when the
+  /// library was built without LZ4)
+  ///
+  /// Returns the number of frames written, or -1 on failure.
+  int ps_extract_frames_to_spool(
+    ffi.Pointer<ffi.Char> video_path,
+    ffi.Pointer<ffi.Int64> frame_indices,
+    int count,
+    ffi.Pointer<ffi.Char> spool_path,
+    int compress,
+    PSProgressCallback callback,
+    ffi.Pointer<ffi.Void> user_data,
+  ) {
+    return _ps_extract_frames_to_spool(
+      video_path,
+      frame_indices,
+      count,
+      spool_path,
+      compress,
+      callback,
+      user_data,
+    );
+  }
+
+  late final _ps_extract_frames_to_spoolPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(
+              ffi.Pointer<ffi.Char>,
+              ffi.Pointer<ffi.Int64>,
+              ffi.Int32,
+              ffi.Pointer<ffi.Char>,
+              ffi.Int32,
+              PSProgressCallback,
+              ffi.Pointer<ffi.Void>)>>('ps_extract_frames_to_spool');
+  late final _ps_extract_frames_to_spool =
+      _ps_extract_frames_to_spoolPtr.asFunction<
+          int Function(
+              ffi.Pointer<ffi.Char>,
+              ffi.Pointer<ffi.Int64>,
+              int,
+              ffi.Pointer<ffi.Char>,
+              int,
+              PSProgressCallback,
+              ffi.Pointer<ffi.Void>)>();
+
+  /// Open a spool for reading. Returns NULL on failure.
+  ffi.Pointer<PSSpool> ps_spool_open(
+    ffi.Pointer<ffi.Char> spool_path,
+  ) {
+    return _ps_spool_open(
+      spool_path,
+    );
+  }
+
+  late final _ps_spool_openPtr = _lookup<
+          ffi.NativeFunction<ffi.Pointer<PSSpool> Function(ffi.Pointer<ffi.Char>)>>(
+      'ps_spool_open');
+  late final _ps_spool_open = _ps_spool_openPtr
+      .asFunction<ffi.Pointer<PSSpool> Function(ffi.Pointer<ffi.Char>)>();
+
+  /// Number of frames in [spool]
+  int ps_spool_count(
+    ffi.Pointer<PSSpool> spool,
+  ) {
+    return _ps_spool_count(
+      spool,
+    );
+  }
+
+  late final _ps_spool_countPtr =
+      _lookup<ffi.NativeFunction<ffi.Int32 Function(ffi.Pointer<PSSpool>)>>(
+          'ps_spool_count');
+  late final _ps_spool_count =
+      _ps_spool_countPtr.asFunction<int Function(ffi.Pointer<PSSpool>)>();
+
+  /// Source video frame index of spool frame [i], read from its record
+  /// without decoding the pixels. Returns -1 if [i] is out of range.
+  int ps_spool_frame_index(
+    ffi.Pointer<PSSpool> spool,
+    int i,
+  ) {
+    return _ps_spool_frame_index(
+      spool,
+      i,
+    );
+  }
+
+  late final _ps_spool_frame_indexPtr = _lookup<
+          ffi.NativeFunction<ffi.Int64 Function(ffi.Pointer<PSSpool>, ffi.Int32)>>(
+      'ps_spool_frame_index');
+  late final _ps_spool_frame_index = _ps_spool_frame_indexPtr
+      .asFunction<int Function(ffi.Pointer<PSSpool>, int)>();
+
+  /// Get frame [i] (0 <= i < ps_spool_count()) in append order.
+  /// Returns 0 on success, -1 on failure.
+  int ps_spool_get_frame(
+    ffi.Pointer<PSSpool> spool,
+    int i,
+    ffi.Pointer<PSSpoolFrame> out_frame,
+  ) {
+    return _ps_spool_get_frame(
+      spool,
+      i,
+      out_frame,
+    );
+  }
+
+  late final _ps_spool_get_framePtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Pointer<PSSpool>, ffi.Int32,
+              ffi.Pointer<PSSpoolFrame>)>>('ps_spool_get_frame');
+  late final _ps_spool_get_frame = _ps_spool_get_framePtr.asFunction<
+      int Function(ffi.Pointer<PSSpool>, int, ffi.Pointer<PSSpoolFrame>)>();
+
+  /// Unmap and release [spool] (NULL is ignored)
+  void ps_spool_close(
+    ffi.Pointer<PSSpool> spool,
+  ) {
+    return _ps_spool_close(
+      spool,
+    );
+  }
+
+  late final _ps_spool_closePtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Pointer<PSSpool>)>>(
+          'ps_spool_close');
+  late final _ps_spool_close =
+      _ps_spool_closePtr.asFunction<void Function(ffi.Pointer<PSSpool>)>();
+
+  /// Prepare an aligner for [reference], with alignment points of
+  /// [tile_size] pixels (0 = global alignment only).
+  /// Returns NULL on failure.
+  ffi.Pointer<PSAligner> ps_aligner_create(
+    ffi.Pointer<PSImage> reference,
+    int tile_size,
+  ) {
+    return _ps_aligner_create(
+      reference,
+      tile_size,
+    );
+  }
+
+  late final _ps_aligner_createPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Pointer<PSAligner> Function(
+              ffi.Pointer<PSImage>, ffi.Int32)>>('ps_aligner_create');
+  late final _ps_aligner_create = _ps_aligner_createPtr
+      .asFunction<ffi.Pointer<PSAligner> Function(ffi.Pointer<PSImage>, int)>();
+
+  /// Shift of [frame] (same size as the reference) onto the reference. May
+  /// be called from several threads at once.
+  /// Returns 0 on success, -1 on failure.
+  int ps_aligner_align(
+    ffi.Pointer<PSAligner> aligner,
+    ffi.Pointer<PSImage> frame,
+    ffi.Pointer<PSShift> out_shift,
+  ) {
+    return _ps_aligner_align(
+      aligner,
+      frame,
+      out_shift,
+    );
+  }
+
+  late final _ps_aligner_alignPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Pointer<PSAligner>, ffi.Pointer<PSImage>,
+              ffi.Pointer<PSShift>)>>('ps_aligner_align');
+  late final _ps_aligner_align = _ps_aligner_alignPtr.asFunction<
+      int Function(ffi.Pointer<PSAligner>, ffi.Pointer<PSImage>,
+          ffi.Pointer<PSShift>)>();
+
+  /// Geometry of [aligner]'s local alignment grid (cols = rows = 0 when it
+  /// was created without a tile size or the reference has no room for one).
+  /// Returns 0 on success, -1 on failure.
+  int ps_aligner_grid(
+    ffi.Pointer<PSAligner> aligner,
+    ffi.Pointer<PSWarpGrid> out_grid,
+  ) {
+    return _ps_aligner_grid(
+      aligner,
+      out_grid,
+    );
+  }
+
+  late final _ps_aligner_gridPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Pointer<PSAligner>,
+              ffi.Pointer<PSWarpGrid>)>>('ps_aligner_grid');
+  late final _ps_aligner_grid = _ps_aligner_gridPtr.asFunction<
+      int Function(ffi.Pointer<PSAligner>, ffi.Pointer<PSWarpGrid>)>();
+
+  /// Local shifts of [frame] given its global [shift] from ps_aligner_align():
+  /// cols * rows (dx, dy) pairs, row-major, written to [out_shifts]. Nodes
+  /// without a reliable match are filled in from their neighbours. May be
+  /// called from several threads at once.
+  /// Returns 0 on success, -1 on failure.
+  int ps_aligner_align_local(
+    ffi.Pointer<PSAligner> aligner,
+    ffi.Pointer<PSImage> frame,
+    ffi.Pointer<PSShift> shift,
+    ffi.Pointer<ffi.Float> out_shifts,
+  ) {
+    return _ps_aligner_align_local(
+      aligner,
+      frame,
+      shift,
+      out_shifts,
+    );
+  }
+
+  late final _ps_aligner_align_localPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Pointer<PSAligner>, ffi.Pointer<PSImage>,
+              ffi.Pointer<PSShift>,
+              ffi.Pointer<ffi.Float>)>>('ps_aligner_align_local');
+  late final _ps_aligner_align_local = _ps_aligner_align_localPtr.asFunction<
+      int Function(ffi.Pointer<PSAligner>, ffi.Pointer<PSImage>,
+          ffi.Pointer<PSShift>, ffi.Pointer<ffi.Float>)>();
+
+  /// Release [aligner] (NULL is ignored)
+  void ps_aligner_free(
+    ffi.Pointer<PSAligner> aligner,
+  ) {
+    return _ps_aligner_free(
+      aligner,
+    );
+  }
+
+  late final _ps_aligner_freePtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Pointer<PSAligner>)>>(
+          'ps_aligner_free');
+  late final _ps_aligner_free =
+      _ps_aligner_freePtr.asFunction<void Function(ffi.Pointer<PSAligner>)>();
+
+  /// Resample [frame] through [grid] with [shifts] (as written by
+  /// ps_aligner_align_local) into [out_data], which has the frame's size,
+  /// type and step. Bilinear, with reflected borders.
+  /// Returns 0 on success, -1 on failure.
+  int ps_warp_frame(
+    ffi.Pointer<PSImage> frame,
+    ffi.Pointer<PSWarpGrid> grid,
+    ffi.Pointer<ffi.Float> shifts,
+    ffi.Pointer<ffi.Uint8> out_data,
+  ) {
+    return _ps_warp_frame(
+      frame,
+      grid,
+      shifts,
+      out_data,
+    );
+  }
+
+  late final _ps_warp_framePtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Pointer<PSImage>, ffi.Pointer<PSWarpGrid>,
+              ffi.Pointer<ffi.Float>,
+              ffi.Pointer<ffi.Uint8>)>>('ps_warp_frame');
+  late final _ps_warp_frame = _ps_warp_framePtr.asFunction<
+      int Function(ffi.Pointer<PSImage>, ffi.Pointer<PSWarpGrid>,
+          ffi.Pointer<ffi.Float>, ffi.Pointer<ffi.Uint8>)>();
+
+  /// Read video metadata from the frame index sidecar ([video_path].psidx).
+  ///
+  /// The sidecar is built by a demux-only pass and saved on first use, so
+  /// later calls (and later seeks) don't need to re-probe the file. SER and
+  /// uncompressed AVI files are described by their own header (no sidecar).
+  ///
+  /// Returns 0 on success, -1 on failure.
+  int ps_get_video_info(
+    ffi.Pointer<ffi.Char> video_path,
+    ffi.Pointer<PSVideoInfo> out_info,
+  ) {
+    return _ps_get_video_info(
+      video_path,
+      out_info,
+    );
+  }
+
+  late final _ps_get_video_infoPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Pointer<ffi.Char>,
+              ffi.Pointer<PSVideoInfo>)>>('ps_get_video_info');
+  late final _ps_get_video_info = _ps_get_video_infoPtr.asFunction<
+      int Function(ffi.Pointer<ffi.Char>, ffi.Pointer<PSVideoInfo>)>();
+
+  /// Release a result returned by ps_analyze_video()
+  void ps_free_analysis_result(
+    ffi.Pointer<PSAnalysisResult> result,
+  ) {
+    return _ps_free_analysis_result(
+      result,
+    );
+  }
+
+  late final _ps_free_analysis_resultPtr = _lookup<
+          ffi.NativeFunction<ffi.Void Function(ffi.Pointer<PSAnalysisResult>)>>(
+      'ps_free_analysis_result');
+  late final _ps_free_analysis_result = _ps_free_analysis_resultPtr
+      .asFunction<void Function(ffi.Pointer<PSAnalysisResult>)>();
+
+  /// Get the last error message for the calling thread.
+  /// The returned string is valid until the next API call on this thread.
+  ffi.Pointer<ffi.Char> ps_get_last_error() {
+    return _ps_get_last_error();
+  }
+
+  late final _ps_get_last_errorPtr =
+      _lookup<ffi.NativeFunction<ffi.Pointer<ffi.Char> Function()>>(
+          'ps_get_last_error');
+  late final _ps_get_last_error =
+      _ps_get_last_errorPtr.asFunction<ffi.Pointer<ffi.Char> Function()>();
+
+  /// Native library version string
+  ffi.Pointer<ffi.Char> ps_get_version() {
+    return _ps_get_version();
+  }
+
+  late final _ps_get_versionPtr =
+      _lookup<ffi.NativeFunction<ffi.Pointer<ffi.Char> Function()>>(
+          'ps_get_version');
+  late final _ps_get_version =
+      _ps_get_versionPtr.asFunction<ffi.Pointer<ffi.Char> Function()>();
+}
+
+/// Progress callback.
+///
+/// [current]: Units of work completed so far
+/// [total]: Total units of work (may be an estimate)
+/// [user_data]: Opaque pointer passed through from the caller
+///
+/// May be invoked from a worker thread; the callback must not assume it
+/// runs on the thread that started the operation.
+typedef PSProgressCallback
+    = ffi.Pointer<ffi.NativeFunction<PSProgressCallbackFunction>>;
+typedef PSProgressCallbackFunction = ffi.Void Function(
+    ffi.Int32 current, ffi.Int32 total, ffi.Pointer<ffi.Void> user_data);
+typedef DartPSProgressCallbackFunction = void Function(
+    int current, int total, ffi.Pointer<ffi.Void> user_data);
+
+/// Quality score for a single analyzed frame
+final class PSFrameScore extends ffi.Struct {
+  /// Frame index in the video (presentation order, 0-based): the number
+  /// ps_extract_frames() takes, whatever the sample step
+  @ffi.Int64()
+  external int frame_index;
+
+  /// Presentation time in seconds from the start of the stream
+  @ffi.Double()
+  external double timestamp;
+
+  /// Normalized quality score (0.0 to 1.0, higher = sharper)
+  @ffi.Double()
+  external double quality_score;
+
+  /// Raw sharpness metric (Laplacian variance)
+  @ffi.Double()
+  external double raw_score;
+
+  /// Region of interest (planet bounding box)
+  @ffi.Int32()
+  external int roi_x;
+
+  @ffi.Int32()
+  external int roi_y;
+
+  @ffi.Int32()
+  external int roi_width;
+
+  @ffi.Int32()
+  external int roi_height;
+
+  /// Mean squared Sobel gradient magnitude
+  @ffi.Double()
+  external double gradient_energy;
+
+  /// Share of the frame's energy at high spatial frequencies (0 = smooth,
+  /// about 1 = pixel noise); computed in the same pass as raw_score
+  @ffi.Double()
+  external double high_frequency_ratio;
+}
+
+/// Result of a video analysis pass
+final class PSAnalysisResult extends ffi.Struct {
+  /// Frame scores sorted by quality, best first
+  external ffi.Pointer<PSFrameScore> scores;
+
+  @ffi.Int32()
+  external int count;
+
+  /// Video metadata
+  @ffi.Int64()
+  external int total_frames;
+
+  @ffi.Int32()
+  external int width;
+
+  @ffi.Int32()
+  external int height;
+
+  @ffi.Double()
+  external double frame_rate;
+
+  /// Per-tile sharpness (PSAnalysisOptions.tile_size): [count] rows of
+  /// tile_cols * tile_rows Laplacian variances, row i for scores[i], tiles
+  /// row-major over the scored region. NaN where a frame's region had
+  /// fewer tiles. NULL when tile maps are off.
+  external ffi.Pointer<ffi.Float> tile_sharpness;
+
+  @ffi.Int32()
+  external int tile_cols;
+
+  @ffi.Int32()
+  external int tile_rows;
+
+  /// Tile edge in full-resolution pixels
+  @ffi.Int32()
+  external int tile_size;
+
+  /// Frames picked with temporal spread (PSAnalysisOptions.select_count),
+  /// best first. NULL when selection is off.
+  external ffi.Pointer<ffi.Int64> selected_frames;
+
+  @ffi.Int32()
+  external int selected_count;
+}
+
+/// Options for ps_analyze_video_with_options()
+final class PSAnalysisOptions extends ffi.Struct {
+  /// Score every Nth frame (1 = all frames)
+  @ffi.Int32()
+  external int sample_step;
+
+  /// Non-zero: score the decoder's luma (Y) plane directly instead of
+  /// converting each frame to BGR and back to grayscale
+  @ffi.Int32()
+  external int luma_only;
+
+  /// Single-decode mode: keep the best [cache_frames] sampled frames in
+  /// memory during the pass and write them to the frame spool
+  /// [cache_spool_path] when it completes, so selected frames don't need a
+  /// second decode. 0 disables the cache.
+  @ffi.Int32()
+  external int cache_frames;
+
+  /// Cached frames are held PNG-compressed when [cache_frames] raw frames
+  /// would exceed this budget
+  @ffi.Int32()
+  external int cache_memory_mb;
+
+  /// Frame spool file for the cached frames (cache off when NULL)
+  external ffi.Pointer<ffi.Char> cache_spool_path;
+
+  /// Scoring threads running alongside the decoder (0 = auto)
+  @ffi.Int32()
+  external int worker_threads;
+
+  /// Keyframe-aligned segments of the video decoded in parallel, each with
+  /// its own decoder (0 = auto, 1 = a single sequential decoder)
+  @ffi.Int32()
+  external int decode_segments;
+
+  /// Score a 1/downscale thumbnail of each frame (1, 2 or 4). Several
+  /// times faster on 4K video; rankings get slightly noisier.
+  @ffi.Int32()
+  external int downscale;
+
+  /// Non-zero: let the codec decode at reduced resolution where supported
+  /// and skip its deblocking filter. Faster, but decoded frames are then
+  /// unfit for stacking, so the frame cache is disabled.
+  @ffi.Int32()
+  external int fast_decode;
+
+  /// Non-zero: score only the planetary disk (found by thresholding,
+  /// tracked between detections) plus a margin instead of the whole frame.
+  /// PSFrameScore.roi_* report the scored region.
+  @ffi.Int32()
+  external int track_planet;
+
+  /// Frames between full disk detections while tracking
+  @ffi.Int32()
+  external int redetect_interval;
+
+  /// Edge in pixels of the tiles of the per-tile sharpness map
+  /// (PSAnalysisResult.tile_sharpness); 0 = no map
+  @ffi.Int32()
+  external int tile_size;
+
+  /// Pick the best [select_count] frames during the pass (0 = off), at
+  /// most [select_quota] from every [select_window] consecutive frames so
+  /// the selection is spread over the capture. select_window = 0 picks the
+  /// plain top N; select_quota = 0 allows twice a window's even share.
+  /// The frame cache then holds each window's picks.
+  @ffi.Int32()
+  external int select_count;
+
+  @ffi.Int32()
+  external int select_window;
+
+  @ffi.Int32()
+  external int select_quota;
+
+  /// Coarse-to-fine scoring (with downscale > 1): the best [rescore_count]
+  /// frames by thumbnail score, plus half as many again as a margin, are
+  /// scored a second time at full resolution after the pass, so the frames
+  /// that can make the cut are ranked exactly. 0 = off.
+  @ffi.Int32()
+  external int rescore_count;
+
+  /// Non-zero: reuse the scores of an earlier pass over the same video
+  /// with the same scoring options from the sidecar [video_path].psscore,
+  /// and write one after a fresh pass, along with the packet index
+  /// ([video_path].psidx) if the pass had to build it. A reused pass
+  /// decodes only what the frame spool needs: the selection (or the best
+  /// cache_frames), extracted GOP by GOP. 0 writes nothing next to the
+  /// video.
+  @ffi.Int32()
+  external int score_cache;
+
+  /// Sort only the best [rank_count] scores, best first, and leave the
+  /// rest in frame order behind them (0 = sort all)
+  @ffi.Int32()
+  external int rank_count;
+}
+
+/// Frame spool: decoded frames stored back to back in one file with an
+/// offset table, replacing a directory of PNGs between pipeline stages.
+/// Uncompressed records are memory-mapped and returned without copying.
+final class PSSpool extends ffi.Opaque {}
+
+/// One frame of a spool
+final class PSSpoolFrame extends ffi.Struct {
+  /// Frame index in the source video
+  @ffi.Int64()
+  external int frame_index;
+
+  @ffi.Int32()
+  external int width;
+
+  @ffi.Int32()
+  external int height;
+
+  /// OpenCV type (16 = CV_8UC3)
+  @ffi.Int32()
+  external int type;
+
+  /// Bytes per row (rows are contiguous)
+  @ffi.Int32()
+  external int step;
+
+  /// Pixel data, valid until the next ps_spool_get_frame() on this spool
+  /// or ps_spool_close(). Read-only.
+  external ffi.Pointer<ffi.Uint8> data;
+}
+
+/// Pixel buffer handed to the engine (rows [step] bytes apart)
+final class PSImage extends ffi.Struct {
+  @ffi.Int32()
+  external int width;
+
+  @ffi.Int32()
+  external int height;
+
+  /// OpenCV type (0 = CV_8UC1, 16 = CV_8UC3 BGR)
+  @ffi.Int32()
+  external int type;
+
+  @ffi.Int32()
+  external int step;
+
+  external ffi.Pointer<ffi.Uint8> data;
+}
+
+/// Translation of a frame onto the alignment reference
+final class PSShift extends ffi.Struct {
+  /// Shift to apply to the frame, in pixels
+  @ffi.Double()
+  external double dx;
+
+  @ffi.Double()
+  external double dy;
+
+  /// Correlation peak strength (0 to 1, higher = more reliable)
+  @ffi.Double()
+  external double response;
+}
+
+/// Regular grid of local shifts: node (i, j) sits at pixel
+/// (origin_x + i * spacing, origin_y + j * spacing). Shifts are
+/// interpolated bilinearly between nodes; beyond the outer nodes the
+/// nearest node's shift holds.
+final class PSWarpGrid extends ffi.Struct {
+  @ffi.Float()
+  external double origin_x;
+
+  @ffi.Float()
+  external double origin_y;
+
+  @ffi.Int32()
+  external int spacing;
+
+  /// Nodes per row and rows of nodes (0 = no grid)
+  @ffi.Int32()
+  external int cols;
+
+  @ffi.Int32()
+  external int rows;
+}
+
+/// Aligner: phase correlation against one reference frame whose spectrum
+/// is computed once, so each frame costs one forward and one inverse
+/// transform. Only a power-of-two square around the planet (sized from the
+/// disk in the reference) is transformed, whatever the frame size.
+///
+/// With a tile size, that square is also tiled into alignment points for
+/// local alignment: each point is found in the frame by a normalised
+/// cross-correlation search around its globally aligned position, giving
+/// a grid of shifts that follows the seeing across the disk.
+final class PSAligner extends ffi.Opaque {}
+
+/// Video metadata from the frame index
+final class PSVideoInfo extends ffi.Struct {
+  @ffi.Int32()
+  external int width;
+
+  @ffi.Int32()
+  external int height;
+
+  /// Exact number of frames (counted from the packet index)
+  @ffi.Int64()
+  external int frame_count;
+
+  @ffi.Int64()
+  external int duration_ms;
+
+  @ffi.Double()
+  external double frame_rate;
+
+  /// Number of keyframes (GOP starts)
+  @ffi.Int32()
+  external int keyframe_count;
+}
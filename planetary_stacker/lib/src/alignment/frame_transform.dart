@@ -0,0 +1,36 @@
+import 'warp_grid.dart';
+
+/// How one frame maps onto the alignment reference
+///
+/// Alignment only measures; the frame itself is left untouched and the
+/// stacker samples it through this transform as it accumulates, so no
+/// aligned copy of any frame is ever made.
+class FrameTransform {
+  /// Shift moving the frame onto the reference (pixels)
+  final double shiftX;
+  final double shiftY;
+
+  /// Confidence of the alignment (correlation peak strength, 0 = failed)
+  final double confidence;
+
+  /// Local shifts across the disk, global shift included (null = the
+  /// whole frame moves by [shiftX], [shiftY])
+  final WarpGrid? grid;
+
+  const FrameTransform({
+    required this.shiftX,
+    required this.shiftY,
+    required this.confidence,
+    this.grid,
+  });
+
+  /// The reference frame's own transform
+  static const identity = FrameTransform(shiftX: 0, shiftY: 0, confidence: 1);
+
+  /// Whether sampling through this transform reads the frame unchanged
+  bool get isIdentity => shiftX == 0 && shiftY == 0 && grid == null;
+
+  @override
+  String toString() =>
+      'FrameTransform(shift: (${shiftX.toStringAsFixed(2)}, ${shiftY.toStringAsFixed(2)}), confidence: ${confidence.toStringAsFixed(3)}${grid != null ? ', $grid' : ''})';
+}
@@ -1,5 +1,8 @@
 import 'package:opencv_dart/opencv_dart.dart' as cv;
 
+import '../native/native_aligner.dart';
+import 'frame_transform.dart';
+
 /// Progress callback type
 typedef ProgressCallback = void Function(int progress, String message);
 
@@ -34,6 +37,12 @@ class AlignmentResult {
 /// Phase correlation is a frequency-domain technique that detects
 /// translation (shift) between two images with sub-pixel accuracy.
 /// It's robust to illumination changes and works well with planetary images.
+///
+/// With the native engine, frames can also be aligned locally: the disk is
+/// tiled into alignment points, each found by normalised cross-correlation
+/// near its globally aligned position, giving a warp grid that the
+/// stacker samples the frame through, so seeing distortions within the
+/// disk are undone as well.
 class PhaseCorrelator {
   /// Align a single frame to a reference frame
   ///
@@ -45,81 +54,35 @@ class PhaseCorrelator {
     required cv.Mat referenceFrame,
     required cv.Mat targetFrame,
   }) async {
-    // Convert to grayscale if not already
-    final refGray = referenceFrame.channels == 1
-        ? referenceFrame.clone()
-        : cv.cvtColor(referenceFrame, cv.COLOR_BGR2GRAY);
-
-    final targetGray = targetFrame.channels == 1
-        ? targetFrame.clone()
-        : cv.cvtColor(targetFrame, cv.COLOR_BGR2GRAY);
-
+    final refFloat = _toFloatGray(referenceFrame);
     try {
-      // Convert to float32 for phase correlation
-      final refFloat = refGray.convertTo(cv.MatType.CV_32FC1);
-      final targetFloat = targetGray.convertTo(cv.MatType.CV_32FC1);
-
-      // Perform phase correlation
-      // Returns the detected shift of target relative to reference
-      // phaseCorrelate(target, ref) = how much target is offset from ref
-      final (shift, response) = cv.phaseCorrelate(targetFloat, refFloat);
-
-      // Create translation matrix for warpAffine
-      // phaseCorrelate returns how to shift target to match reference
-      // Matrix format:
-      // [1, 0, tx]
-      // [0, 1, ty]
-      final translationMatrix = cv.Mat.zeros(2, 3, cv.MatType.CV_64FC1);
-      translationMatrix.set<double>(0, 0, 1.0);
-      translationMatrix.set<double>(0, 2, shift.x);
-      translationMatrix.set<double>(1, 1, 1.0);
-      translationMatrix.set<double>(1, 2, shift.y);
-
-      // Apply translation to the original color frame
-      final aligned = cv.warpAffine(
-        targetFrame,
-        translationMatrix,
-        (targetFrame.cols, targetFrame.rows),
-        flags: cv.INTER_LINEAR,
-        borderMode: cv.BORDER_REFLECT,
-      );
-
-      // Cleanup intermediate matrices
+      return _alignToReference(refFloat, targetFrame);
+    } finally {
       refFloat.dispose();
-      targetFloat.dispose();
-      translationMatrix.dispose();
-      refGray.dispose();
-      targetGray.dispose();
-
-      return AlignmentResult(
-        alignedFrame: aligned,
-        shiftX: shift.x,
-        shiftY: shift.y,
-        confidence: response,
-      );
-    } catch (e) {
-      // If alignment fails, return the original frame
-      refGray.dispose();
-      targetGray.dispose();
-      return AlignmentResult(
-        alignedFrame: targetFrame.clone(),
-        shiftX: 0.0,
-        shiftY: 0.0,
-        confidence: 0.0,
-      );
     }
   }
 
   /// Align multiple frames to a reference frame
   ///
-  /// [frames]: List of frames to align (will be modified)
+  /// Only measures: the frames are left as they are, and the stacker
+  /// samples each one through its transform, so no aligned copies are
+  /// made. The reference is prepared once for the whole batch. With the
+  /// native engine bundled its spectrum is computed once too, so each
+  /// frame costs one forward and one inverse transform.
+  ///
+  /// [frames]: List of frames to align (not modified)
   /// [referenceIndex]: Index of the reference frame (default: 0 = first frame)
+  /// [tileSize]: Also align locally, on alignment points of this many
+  ///   pixels, giving each transform a warp grid (0 = global translation
+  ///   only). Native engine only.
   /// [onProgress]: Optional progress callback
   ///
-  /// Returns list of aligned frames (reference frame is cloned unchanged)
-  Future<List<cv.Mat>> alignFrames({
+  /// Returns one transform per frame ([FrameTransform.identity] for the
+  /// reference; zero shift and confidence where alignment failed)
+  Future<List<FrameTransform>> alignFrames({
     required List<cv.Mat> frames,
     int referenceIndex = 0,
+    int tileSize = 0,
     ProgressCallback? onProgress,
   }) async {
     if (frames.isEmpty) {
@@ -131,43 +94,141 @@ class PhaseCorrelator {
     }
 
     final referenceFrame = frames[referenceIndex];
-    final alignedFrames = <cv.Mat>[];
-
-    for (int i = 0; i < frames.length; i++) {
-      if (i == referenceIndex) {
-        // Reference frame doesn't need alignment
-        alignedFrames.add(frames[i].clone());
-      } else {
-        final result = await alignFrame(
-          referenceFrame: referenceFrame,
-          targetFrame: frames[i],
+    final transforms = <FrameTransform>[];
+    final aligner = NativeAligner.isAvailable ? NativeAligner(referenceFrame, tileSize: tileSize) : null;
+    final refFloat = aligner == null ? _toFloatGray(referenceFrame) : null;
+
+    try {
+      for (int i = 0; i < frames.length; i++) {
+        if (i == referenceIndex) {
+          // Reference frame doesn't need alignment
+          transforms.add(FrameTransform.identity);
+        } else if (aligner != null) {
+          transforms.add(_transformNative(aligner, frames[i]));
+        } else {
+          transforms.add(_transformTo(refFloat!, frames[i]));
+        }
+
+        onProgress?.call(
+          ((i + 1) * 100 / frames.length).round(),
+          'Aligning frame ${i + 1}/${frames.length}',
         );
-        alignedFrames.add(result.alignedFrame);
       }
+    } finally {
+      aligner?.close();
+      refFloat?.dispose();
+    }
 
-      onProgress?.call(
-        ((i + 1) * 100 / frames.length).round(),
-        'Aligning frame ${i + 1}/${frames.length}',
-      );
+    return transforms;
+  }
+
+  /// [targetFrame] shifted onto the reference whose float grayscale is
+  /// [refFloat]
+  AlignmentResult _alignToReference(cv.Mat refFloat, cv.Mat targetFrame) {
+    final transform = _transformTo(refFloat, targetFrame);
+    return AlignmentResult(
+      // If alignment fails, the original frame
+      alignedFrame: transform.confidence > 0
+          ? _translate(targetFrame, transform.shiftX, transform.shiftY)
+          : targetFrame.clone(),
+      shiftX: transform.shiftX,
+      shiftY: transform.shiftY,
+      confidence: transform.confidence,
+    );
+  }
+
+  /// Transform of [targetFrame] onto the reference whose float grayscale
+  /// is [refFloat] (zero shift and confidence if alignment fails)
+  FrameTransform _transformTo(cv.Mat refFloat, cv.Mat targetFrame) {
+    final targetFloat = _toFloatGray(targetFrame);
+
+    try {
+      // Perform phase correlation
+      // Returns the detected shift of target relative to reference
+      // phaseCorrelate(target, ref) = how much target is offset from ref
+      final (shift, response) = cv.phaseCorrelate(targetFloat, refFloat);
+      return FrameTransform(shiftX: shift.x, shiftY: shift.y, confidence: response);
+    } catch (e) {
+      return const FrameTransform(shiftX: 0, shiftY: 0, confidence: 0);
+    } finally {
+      targetFloat.dispose();
+    }
+  }
+
+  /// Transform of [frame] onto [aligner]'s reference, with a warp grid
+  /// when the aligner has alignment points (zero shift and confidence if
+  /// alignment fails)
+  FrameTransform _transformNative(NativeAligner aligner, cv.Mat frame) {
+    try {
+      if (aligner.hasGrid) {
+        final result = aligner.alignLocal(frame);
+        return FrameTransform(
+          shiftX: result.dx,
+          shiftY: result.dy,
+          confidence: result.response,
+          grid: result.grid,
+        );
+      }
+      final shift = aligner.align(frame);
+      return FrameTransform(shiftX: shift.dx, shiftY: shift.dy, confidence: shift.response);
+    } catch (e) {
+      return const FrameTransform(shiftX: 0, shiftY: 0, confidence: 0);
     }
+  }
 
-    return alignedFrames;
+  /// Float32 grayscale copy of [frame] for phase correlation
+  cv.Mat _toFloatGray(cv.Mat frame) {
+    final gray = frame.channels == 1 ? frame.clone() : cv.cvtColor(frame, cv.COLOR_BGR2GRAY);
+    try {
+      return gray.convertTo(cv.MatType.CV_32FC1);
+    } finally {
+      gray.dispose();
+    }
+  }
+
+  /// [frame] translated by ([dx], [dy]) pixels
+  cv.Mat _translate(cv.Mat frame, double dx, double dy) {
+    // Create translation matrix for warpAffine
+    // Matrix format:
+    // [1, 0, tx]
+    // [0, 1, ty]
+    final translationMatrix = cv.Mat.zeros(2, 3, cv.MatType.CV_64FC1);
+    translationMatrix.set<double>(0, 0, 1.0);
+    translationMatrix.set<double>(0, 2, dx);
+    translationMatrix.set<double>(1, 1, 1.0);
+    translationMatrix.set<double>(1, 2, dy);
+
+    try {
+      // Apply translation to the original color frame
+      return cv.warpAffine(
+        frame,
+        translationMatrix,
+        (frame.cols, frame.rows),
+        flags: cv.INTER_LINEAR,
+        borderMode: cv.BORDER_REFLECT,
+      );
+    } finally {
+      translationMatrix.dispose();
+    }
   }
 
   /// Align frames from file paths
   ///
   /// [framePaths]: List of paths to frame images
   /// [referenceIndex]: Index of the reference frame (default: 0)
+  /// [tileSize]: Local alignment tile size, as for [alignFrames]
   /// [onProgress]: Optional progress callback
   ///
-  /// Returns list of aligned cv.Mat frames (caller must dispose)
-  Future<List<cv.Mat>> alignFramesFromPaths({
+  /// Returns the frames that loaded (caller must dispose) with their
+  /// transforms, as for [alignFrames]
+  Future<({List<cv.Mat> frames, List<FrameTransform> transforms})> alignFramesFromPaths({
     required List<String> framePaths,
     int referenceIndex = 0,
+    int tileSize = 0,
     ProgressCallback? onProgress,
   }) async {
     if (framePaths.isEmpty) {
-      return [];
+      return (frames: <cv.Mat>[], transforms: <FrameTransform>[]);
     }
 
     // Load all frames
@@ -185,17 +246,19 @@ class PhaseCorrelator {
     }
 
     // Align frames
-    final aligned = await alignFrames(
-      frames: frames,
-      referenceIndex: referenceIndex,
-      onProgress: (p, m) => onProgress?.call(50 + (p * 0.5).round(), m),
-    );
-
-    // Dispose original frames (aligned are new copies)
-    for (final frame in frames) {
-      frame.dispose();
+    try {
+      final transforms = await alignFrames(
+        frames: frames,
+        referenceIndex: referenceIndex,
+        tileSize: tileSize,
+        onProgress: (p, m) => onProgress?.call(50 + (p * 0.5).round(), m),
+      );
+      return (frames: frames, transforms: transforms);
+    } catch (e) {
+      for (final frame in frames) {
+        frame.dispose();
+      }
+      rethrow;
     }
-
-    return aligned;
   }
 }
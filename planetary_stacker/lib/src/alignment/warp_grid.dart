@@ -0,0 +1,91 @@
+import 'dart:typed_data';
+
+/// Local alignment of one frame: shifts on a regular grid of nodes
+///
+/// Node (i, j) sits at pixel ([originX] + i * [spacing],
+/// [originY] + j * [spacing]). Between nodes the shift is interpolated
+/// bilinearly; beyond the outer nodes the nearest node's shift holds.
+/// Each shift moves the frame onto the reference, global shift included.
+class WarpGrid {
+  final double originX;
+  final double originY;
+
+  /// Pixels between neighbouring nodes (the alignment tile size)
+  final int spacing;
+
+  /// Nodes across
+  final int columns;
+
+  /// Nodes down
+  final int rows;
+
+  /// columns x rows (dx, dy) pairs, row-major
+  final Float32List shifts;
+
+  // Node shifts interpolated to the current row, reused for every row
+  late final Float32List _rowX = Float32List(columns);
+  late final Float32List _rowY = Float32List(columns);
+
+  // Horizontal brackets of each pixel column: the same on every row, so
+  // computed once per row width
+  Int32List _left = Int32List(0);
+  Int32List _right = Int32List(0);
+  Float64List _weight = Float64List(0);
+
+  WarpGrid({
+    required this.originX,
+    required this.originY,
+    required this.spacing,
+    required this.columns,
+    required this.rows,
+    required this.shifts,
+  });
+
+  int get nodeCount => columns * rows;
+
+  /// Shifts of the pixels of row [y], [dx].length of them from column 0,
+  /// into [dx] and [dy]
+  void rowShifts(int y, Float32List dx, Float32List dy) {
+    final width = dx.length;
+    if (_left.length != width) {
+      _left = Int32List(width);
+      _right = Int32List(width);
+      _weight = Float64List(width);
+      for (int x = 0; x < width; x++) {
+        final (left, right, u) = _bracket(x.toDouble(), originX, columns);
+        _left[x] = left;
+        _right[x] = right;
+        _weight[x] = u;
+      }
+    }
+
+    // Node shifts interpolated to this row, then along it
+    final (lo, hi, t) = _bracket(y.toDouble(), originY, rows);
+    final rowX = _rowX;
+    final rowY = _rowY;
+    for (int i = 0; i < columns; i++) {
+      final a = (lo * columns + i) * 2;
+      final b = (hi * columns + i) * 2;
+      rowX[i] = shifts[a] + (shifts[b] - shifts[a]) * t;
+      rowY[i] = shifts[a + 1] + (shifts[b + 1] - shifts[a + 1]) * t;
+    }
+    for (int x = 0; x < width; x++) {
+      final left = _left[x];
+      final right = _right[x];
+      final u = _weight[x];
+      dx[x] = rowX[left] + (rowX[right] - rowX[left]) * u;
+      dy[x] = rowY[left] + (rowY[right] - rowY[left]) * u;
+    }
+  }
+
+  // Nodes either side of [position] on an axis of [count] nodes starting
+  // at [origin], and the weight of the second; clamped to the outer nodes
+  (int, int, double) _bracket(double position, double origin, int count) {
+    final g = ((position - origin) / spacing).clamp(0.0, (count - 1).toDouble());
+    final lo = g.floor().clamp(0, count - 1);
+    return (lo, (lo + 1).clamp(0, count - 1), g - lo);
+  }
+
+  @override
+  String toString() => 'WarpGrid(${columns}x$rows nodes, spacing: $spacing)';
+}
@@ -1,8 +1,17 @@
+import 'dart:typed_data';
+
+import 'quality/score_statistics.dart';
+
 /// Frame quality analysis result
 class FrameScore {
-  /// Frame index in the video
+  /// Frame index in the video (decoder order, 0-based), whatever the
+  /// sample step; the index to extract or stack the frame by
   final int frameIndex;
 
+  /// Presentation time in seconds from the start of the stream (null
+  /// when the analyzer doesn't report it)
+  final double? timestamp;
+
   /// Quality score (higher = sharper)
   final double qualityScore;
 
@@ -13,6 +22,7 @@ class FrameScore {
     required this.frameIndex,
     required this.qualityScore,
     required this.roi,
+    this.timestamp,
   });
 
   @override
@@ -38,45 +48,100 @@ class Rectangle {
   String toString() => 'Rectangle(x: $x, y: $y, w: $width, h: $height)';
 }
 
+/// Per-tile sharpness of every analyzed frame
+///
+/// Each frame's scored region is cut into [columns] x [rows] tiles of
+/// [tileSize] pixels anchored at its top-left corner, so when the planet
+/// is tracked a tile covers the same part of the disk in every frame.
+/// Lets later stages rank frames per region without re-reading pixels.
+class TileQualityMap {
+  /// Tile edge in pixels
+  final int tileSize;
+
+  /// Tiles across
+  final int columns;
+
+  /// Tiles down
+  final int rows;
+
+  /// frames x tiles Laplacian variances; frame i matches
+  /// [AnalysisResult.scores][i]. NaN for tiles outside a frame's region.
+  final Float32List values;
+
+  const TileQualityMap({
+    required this.tileSize,
+    required this.columns,
+    required this.rows,
+    required this.values,
+  });
+
+  int get tileCount => columns * rows;
+
+  /// Tile sharpness of the [i]th scored frame (row-major)
+  Float32List frame(int i) =>
+      Float32List.sublistView(values, i * tileCount, (i + 1) * tileCount);
+}
+
 /// Video analysis result
 class AnalysisResult {
-  /// All analyzed frame scores (sorted by quality, descending)
+  /// All analyzed frame scores. The native analyzer returns them best
+  /// first (only the best rankCount of them when asked) and the Dart
+  /// fallback in frame order; use [getTopFrames] rather than relying on
+  /// either.
   final List<FrameScore> scores;
 
   /// Total number of frames in the video
   final int totalFrames;
 
+  /// Per-tile sharpness, when requested from the native analyzer
+  final TileQualityMap? tileMap;
+
+  /// Frame indices the native analyzer picked while scoring, best first,
+  /// spread over the capture (at most a quota per window of frames); null
+  /// unless selection was requested
+  final List<int>? selectedFrames;
+
   const AnalysisResult({
     required this.scores,
     required this.totalFrames,
+    this.tileMap,
+    this.selectedFrames,
   });
 
-  /// Get the top N% of frames
+  /// Get the top N% of frames, best first
   List<FrameScore> getTopFrames(double percentage) {
     final count = (scores.length * percentage).round().clamp(1, scores.length);
-    return scores.take(count).toList();
+    return getTopNFrames(count);
   }
 
-  /// Get a specific number of top frames
+  /// Get a specific number of top frames, best first
+  ///
+  /// Selected with a bounded heap, so the full score list is never copied
+  /// or sorted; ties keep the earlier score.
   List<FrameScore> getTopNFrames(int n) {
-    return scores.take(n.clamp(1, scores.length)).toList();
+    return selectTop(scores, n.clamp(1, scores.length), (FrameScore s) => s.qualityScore);
   }
 
   /// Get quality statistics
+  ///
+  /// One pass in constant memory; the median is a P² estimate (exact for
+  /// up to five frames).
   QualityStats get stats {
     if (scores.isEmpty) {
       return const QualityStats(min: 0, max: 0, mean: 0, median: 0);
     }
 
-    final qualities = scores.map((s) => s.qualityScore).toList();
-    qualities.sort();
-
-    final min = qualities.first;
-    final max = qualities.last;
-    final mean = qualities.reduce((a, b) => a + b) / qualities.length;
-    final median = qualities[qualities.length ~/ 2];
+    final summary = ScoreStatistics();
+    for (final score in scores) {
+      summary.add(score.qualityScore);
+    }
 
-    return QualityStats(min: min, max: max, mean: mean, median: median);
+    return QualityStats(
+      min: summary.min,
+      max: summary.max,
+      mean: summary.mean,
+      median: summary.median,
+    );
   }
 
   @override
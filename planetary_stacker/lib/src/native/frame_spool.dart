@@ -0,0 +1,85 @@
+import 'dart:ffi';
+
+import 'package:ffi/ffi.dart';
+import 'package:opencv_dart/opencv_dart.dart' as cv;
+
+import '../../planetary_stacker_bindings_generated.dart';
+import 'native_library.dart';
+
+/// Reader for a native frame spool (`.psspool`)
+///
+/// A spool holds decoded frames back to back in one memory-mapped file,
+/// so loading a frame is a single copy instead of a PNG decode.
+class FrameSpool {
+  final Pointer<PSSpool> _handle;
+  final Pointer<PSSpoolFrame> _frame = calloc<PSSpoolFrame>();
+  bool _closed = false;
+
+  FrameSpool._(this._handle);
+
+  /// Open the spool at [path]
+  ///
+  /// Throws if the file is missing or not a complete spool.
+  factory FrameSpool.open(String path) {
+    final bindings = nativeBindings!;
+    final nativePath = path.toNativeUtf8();
+    try {
+      final handle = bindings.ps_spool_open(nativePath.cast<Char>());
+      if (handle == nullptr) {
+        final error = bindings.ps_get_last_error().cast<Utf8>().toDartString();
+        throw Exception('Failed to open frame spool: $error');
+      }
+      return FrameSpool._(handle);
+    } finally {
+      malloc.free(nativePath);
+    }
+  }
+
+  /// Number of frames in the spool
+  int get length => nativeBindings!.ps_spool_count(_handle);
+
+  /// Video frame indices in spool order, read from the records without
+  /// decoding any frame
+  List<int> get frameIndices {
+    if (_closed) {
+      throw StateError('Frame spool is closed');
+    }
+    final bindings = nativeBindings!;
+    return [
+      for (int i = 0; i < length; i++) bindings.ps_spool_frame_index(_handle, i),
+    ];
+  }
+
+  /// Copy frame [i] (spool order) into a new Mat (caller must dispose)
+  cv.Mat readFrame(int i) {
+    _load(i);
+    final frame = _frame.ref;
+    final mat = cv.Mat.create(
+      rows: frame.height,
+      cols: frame.width,
+      type: cv.MatType(frame.type),
+    );
+    mat.data.setAll(0, frame.data.asTypedList(frame.step * frame.height));
+    return mat;
+  }
+
+  /// Release the mapping; the spool can't be used afterwards
+  void close() {
+    if (_closed) {
+      return;
+    }
+    _closed = true;
+    nativeBindings!.ps_spool_close(_handle);
+    calloc.free(_frame);
+  }
+
+  void _load(int i) {
+    if (_closed) {
+      throw StateError('Frame spool is closed');
+    }
+    if (nativeBindings!.ps_spool_get_frame(_handle, i, _frame) != 0) {
+      final error = nativeBindings!.ps_get_last_error().cast<Utf8>().toDartString();
+      throw Exception('Failed to read spool frame $i: $error');
+    }
+  }
+}
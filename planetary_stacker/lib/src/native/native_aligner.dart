@@ -0,0 +1,142 @@
+import 'dart:ffi';
+import 'dart:typed_data';
+
+import 'package:ffi/ffi.dart';
+import 'package:opencv_dart/opencv_dart.dart' as cv;
+
+import '../../planetary_stacker_bindings_generated.dart';
+import '../alignment/warp_grid.dart';
+import 'native_library.dart';
+
+/// Global and local alignment on the native engine
+///
+/// The reference frame's spectrum is computed once when the aligner is
+/// created, so each [align] call transforms only the frame being aligned,
+/// and only a power-of-two square around the planet of it. Created with a
+/// tile size, the aligner also holds a grid of alignment points over that
+/// square for [alignLocal].
+class NativeAligner {
+  final Pointer<PSAligner> _handle;
+  final Pointer<PSImage> _image = calloc<PSImage>();
+  final Pointer<PSShift> _shift = calloc<PSShift>();
+  final Pointer<PSWarpGrid> _grid = calloc<PSWarpGrid>();
+  Pointer<Float> _nodes = nullptr;
+  bool _closed = false;
+
+  NativeAligner._(this._handle) {
+    nativeBindings!.ps_aligner_grid(_handle, _grid);
+    final nodes = _grid.ref.cols * _grid.ref.rows;
+    if (nodes > 0) {
+      _nodes = calloc<Float>(nodes * 2);
+    }
+  }
+
+  /// Whether the native library is bundled with this build
+  static bool get isAvailable => nativeBindings != null;
+
+  /// Prepare an aligner for [reference] (8-bit gray or BGR), with
+  /// alignment points of [tileSize] pixels (0 = global alignment only)
+  ///
+  /// Throws if the native engine rejects the frame.
+  factory NativeAligner(cv.Mat reference, {int tileSize = 0}) {
+    final bindings = nativeBindings!;
+    final image = calloc<PSImage>();
+    try {
+      _describe(image, reference);
+      final handle = bindings.ps_aligner_create(image, tileSize);
+      if (handle == nullptr) {
+        final error = bindings.ps_get_last_error().cast<Utf8>().toDartString();
+        throw Exception('Failed to prepare alignment reference: $error');
+      }
+      return NativeAligner._(handle);
+    } finally {
+      calloc.free(image);
+    }
+  }
+
+  /// Whether [alignLocal] has alignment points to work with
+  bool get hasGrid => _nodes != nullptr;
+
+  /// Shift that moves [frame] onto the reference, with the correlation
+  /// peak strength (0-1) as confidence
+  ({double dx, double dy, double response}) align(cv.Mat frame) {
+    _load(frame);
+    _alignLoaded();
+    final shift = _shift.ref;
+    return (dx: shift.dx, dy: shift.dy, response: shift.response);
+  }
+
+  /// Global shift of [frame] as [align], plus the local shifts of the
+  /// alignment grid (null when the aligner has none)
+  ({double dx, double dy, double response, WarpGrid? grid}) alignLocal(cv.Mat frame) {
+    _load(frame);
+    _alignLoaded();
+    final shift = _shift.ref;
+    if (!hasGrid) {
+      return (dx: shift.dx, dy: shift.dy, response: shift.response, grid: null);
+    }
+
+    final bindings = nativeBindings!;
+    if (bindings.ps_aligner_align_local(_handle, _image, _shift, _nodes) != 0) {
+      final error = bindings.ps_get_last_error().cast<Utf8>().toDartString();
+      throw Exception('Native local alignment failed: $error');
+    }
+    final geometry = _grid.ref;
+    final grid = WarpGrid(
+      originX: geometry.origin_x,
+      originY: geometry.origin_y,
+      spacing: geometry.spacing,
+      columns: geometry.cols,
+      rows: geometry.rows,
+      shifts: Float32List.fromList(_nodes.asTypedList(geometry.cols * geometry.rows * 2)),
+    );
+    return (dx: shift.dx, dy: shift.dy, response: shift.response, grid: grid);
+  }
+
+  /// Release the reference; the aligner can't be used afterwards
+  void close() {
+    if (_closed) {
+      return;
+    }
+    _closed = true;
+    nativeBindings!.ps_aligner_free(_handle);
+    calloc.free(_image);
+    calloc.free(_shift);
+    calloc.free(_grid);
+    if (_nodes != nullptr) {
+      calloc.free(_nodes);
+    }
+  }
+
+  // Describe [frame] in [_image]; the engine reads its pixels in place
+  void _load(cv.Mat frame) {
+    if (_closed) {
+      throw StateError('Aligner is closed');
+    }
+    _describe(_image, frame);
+  }
+
+  // Global shift of the loaded frame into [_shift]
+  void _alignLoaded() {
+    final bindings = nativeBindings!;
+    if (bindings.ps_aligner_align(_handle, _image, _shift) != 0) {
+      final error = bindings.ps_get_last_error().cast<Utf8>().toDartString();
+      throw Exception('Native alignment failed: $error');
+    }
+  }
+
+  // Geometry of [mat] and its own pixel buffer, which stays valid while
+  // the Mat does: no copy is made, and the engine only reads it during
+  // the call it is passed to
+  static void _describe(Pointer<PSImage> image, cv.Mat mat) {
+    if (!mat.isContinuous) {
+      throw ArgumentError('Frame must be continuous (clone a ROI first)');
+    }
+    image.ref
+      ..data = mat.dataPtr.cast<Uint8>()
+      ..width = mat.cols
+      ..height = mat.rows
+      ..type = mat.type.value
+      ..step = mat.cols * mat.elemSize;
+  }
+}
@@ -0,0 +1,274 @@
+import 'dart:async';
+import 'dart:ffi';
+import 'dart:isolate';
+import 'dart:typed_data';
+
+import 'package:ffi/ffi.dart';
+
+import '../../planetary_stacker_bindings_generated.dart';
+import '../frame_analysis.dart';
+import 'native_library.dart';
+
+/// Progress callback type
+typedef ProgressCallback = void Function(int progress, String message);
+
+/// Frame quality analysis on the native engine
+///
+/// Streams the video through libavcodec and scores frames in memory,
+/// so no intermediate PNG files are written or re-read.
+class NativeAnalyzer {
+  /// Whether the native library is bundled with this build
+  static bool get isAvailable => nativeBindings != null;
+
+  /// Analyze video frames for quality
+  ///
+  /// [videoPath]: Path to the input video file (MP4/MOV)
+  /// [sampleStep]: Score every Nth frame
+  /// [lumaOnly]: Score the decoder's Y plane directly (no colour conversion)
+  /// [cacheFrames]: Keep the best N sampled frames from this pass and write
+  /// them to the frame spool [cacheSpoolPath] (0 = off), so the selected
+  /// frames don't have to be decoded again
+  /// [cacheSpoolPath]: Spool file for the cached frames
+  /// [downscale]: Score a 1/N thumbnail (1, 2 or 4); much faster on 4K
+  /// [fastDecode]: Reduced-resolution, no-deblock decoding (disables the
+  /// frame cache, since decoded frames are no longer stack quality)
+  /// [trackPlanet]: Score only the region around the planetary disk
+  /// [tileSize]: Also record per-tile sharpness on tiles of this many
+  /// pixels (0 = off), see [AnalysisResult.tileMap]
+  /// [selectCount]: Pick the best N frames during the pass (0 = off), see
+  /// [AnalysisResult.selectedFrames]
+  /// [selectWindow]: Spread the picks: at most [selectQuota] from every
+  /// this many consecutive frames (0 = plain top N)
+  /// [selectQuota]: Picks per window (0 = twice a window's even share)
+  /// [rescoreCount]: With [downscale] > 1, score the best N frames (plus
+  /// a margin) again at full resolution after the pass, so the frames
+  /// that can make the cut are ranked exactly (0 = off)
+  /// [reuseScores]: Reuse the scores of an earlier pass over this video
+  /// with the same scoring options (kept in a `.psscore` sidecar next to
+  /// it, with its `.psidx` packet index) instead of decoding again; only
+  /// the frames [cacheSpoolPath] needs are then decoded. Off by default,
+  /// as it writes next to the video
+  /// [rankCount]: Only sort the best N scores, best first; the rest follow
+  /// in frame order (0 = sort all)
+  /// [onProgress]: Optional progress callback
+  Future<AnalysisResult> analyzeVideo({
+    required String videoPath,
+    int sampleStep = 3,
+    bool lumaOnly = true,
+    int cacheFrames = 0,
+    String? cacheSpoolPath,
+    int downscale = 1,
+    bool fastDecode = false,
+    bool trackPlanet = true,
+    int tileSize = 0,
+    int selectCount = 0,
+    int selectWindow = 0,
+    int selectQuota = 0,
+    int rescoreCount = 0,
+    bool reuseScores = false,
+    int rankCount = 0,
+    ProgressCallback? onProgress,
+  }) async {
+    // Native progress arrives on a decoder thread; a listener callable
+    // forwards it to this isolate.
+    final progress = NativeCallable<PSProgressCallbackFunction>.listener(
+      (int current, int total, Pointer<Void> _) {
+        if (total > 0) {
+          onProgress?.call(
+            (current * 100 / total).round().clamp(0, 100),
+            'Analyzing frame $current/$total',
+          );
+        }
+      },
+    );
+
+    try {
+      final callbackAddress = progress.nativeFunction.address;
+      return await Isolate.run(
+        () => _analyzeVideo(
+          videoPath,
+          sampleStep,
+          lumaOnly,
+          cacheFrames,
+          cacheSpoolPath,
+          downscale,
+          fastDecode,
+          trackPlanet,
+          tileSize,
+          selectCount,
+          selectWindow,
+          selectQuota,
+          rescoreCount,
+          reuseScores,
+          rankCount,
+          callbackAddress,
+        ),
+      );
+    } finally {
+      progress.close();
+    }
+  }
+
+  /// Laplacian variance of each image in [paths] (e.g. extracted frames),
+  /// scored on all cores with a work-stealing scheduler
+  ///
+  /// Values are in the order of [paths]; NaN for images that can't be read.
+  Future<List<double>> scoreImages({
+    required List<String> paths,
+    ProgressCallback? onProgress,
+  }) async {
+    final progress = NativeCallable<PSProgressCallbackFunction>.listener(
+      (int current, int total, Pointer<Void> _) {
+        if (total > 0) {
+          onProgress?.call(
+            (current * 100 / total).round().clamp(0, 100),
+            'Analyzing frame $current/$total',
+          );
+        }
+      },
+    );
+
+    try {
+      final callbackAddress = progress.nativeFunction.address;
+      return await Isolate.run(() => _scoreImages(paths, callbackAddress));
+    } finally {
+      progress.close();
+    }
+  }
+}
+
+/// Runs on a background isolate; blocks until every image is scored.
+List<double> _scoreImages(List<String> paths, int callbackAddress) {
+  final bindings = nativeBindings!;
+  final nativePaths = calloc<Pointer<Char>>(paths.length);
+  final variances = calloc<Double>(paths.length);
+
+  try {
+    for (int i = 0; i < paths.length; i++) {
+      nativePaths[i] = paths[i].toNativeUtf8().cast<Char>();
+    }
+
+    final status = bindings.ps_score_images(
+      nativePaths,
+      paths.length,
+      0,
+      variances,
+      Pointer<NativeFunction<PSProgressCallbackFunction>>.fromAddress(callbackAddress),
+      nullptr,
+    );
+    if (status != 0) {
+      final error = bindings.ps_get_last_error().cast<Utf8>().toDartString();
+      throw Exception('Native scoring failed: $error');
+    }
+    return List<double>.of(variances.asTypedList(paths.length));
+  } finally {
+    for (int i = 0; i < paths.length; i++) {
+      if (nativePaths[i] != nullptr) {
+        malloc.free(nativePaths[i]);
+      }
+    }
+    calloc.free(nativePaths);
+    calloc.free(variances);
+  }
+}
+
+/// Runs on a background isolate; blocks until the native pass completes.
+AnalysisResult _analyzeVideo(
+  String videoPath,
+  int sampleStep,
+  bool lumaOnly,
+  int cacheFrames,
+  String? cacheSpoolPath,
+  int downscale,
+  bool fastDecode,
+  bool trackPlanet,
+  int tileSize,
+  int selectCount,
+  int selectWindow,
+  int selectQuota,
+  int rescoreCount,
+  bool reuseScores,
+  int rankCount,
+  int callbackAddress,
+) {
+  final bindings = nativeBindings!;
+  final path = videoPath.toNativeUtf8();
+  final spoolPath = cacheSpoolPath?.toNativeUtf8();
+  final options = calloc<PSAnalysisOptions>();
+
+  try {
+    options.ref = bindings.ps_default_analysis_options();
+    options.ref.sample_step = sampleStep;
+    options.ref.luma_only = lumaOnly ? 1 : 0;
+    options.ref.downscale = downscale;
+    options.ref.fast_decode = fastDecode ? 1 : 0;
+    options.ref.track_planet = trackPlanet ? 1 : 0;
+    options.ref.tile_size = tileSize;
+    options.ref.select_count = selectCount;
+    options.ref.select_window = selectWindow;
+    options.ref.select_quota = selectQuota;
+    options.ref.rescore_count = rescoreCount;
+    options.ref.score_cache = reuseScores ? 1 : 0;
+    options.ref.rank_count = rankCount;
+    if (spoolPath != null) {
+      options.ref.cache_frames = cacheFrames;
+      options.ref.cache_spool_path = spoolPath.cast<Char>();
+    }
+
+    final result = bindings.ps_analyze_video_with_options(
+      path.cast<Char>(),
+      options,
+      Pointer<NativeFunction<PSProgressCallbackFunction>>.fromAddress(callbackAddress),
+      nullptr,
+    );
+
+    if (result == nullptr) {
+      final error = bindings.ps_get_last_error().cast<Utf8>().toDartString();
+      throw Exception('Native analysis failed: $error');
+    }
+
+    try {
+      final native = result.ref;
+      final scores = <FrameScore>[];
+      for (int i = 0; i < native.count; i++) {
+        final s = native.scores[i];
+        scores.add(FrameScore(
+          frameIndex: s.frame_index,
+          timestamp: s.timestamp,
+          qualityScore: s.quality_score,
+          roi: Rectangle(x: s.roi_x, y: s.roi_y, width: s.roi_width, height: s.roi_height),
+        ));
+      }
+
+      TileQualityMap? tileMap;
+      if (native.tile_sharpness != nullptr) {
+        final tiles = native.tile_cols * native.tile_rows;
+        tileMap = TileQualityMap(
+          tileSize: native.tile_size,
+          columns: native.tile_cols,
+          rows: native.tile_rows,
+          values: Float32List.fromList(
+            native.tile_sharpness.asTypedList(native.count * tiles),
+          ),
+        );
+      }
+
+      return AnalysisResult(
+        scores: scores,
+        totalFrames: native.total_frames,
+        tileMap: tileMap,
+        selectedFrames: native.selected_frames != nullptr
+            ? native.selected_frames.asTypedList(native.selected_count).toList()
+            : null,
+      );
+    } finally {
+      bindings.ps_free_analysis_result(result);
+    }
+  } finally {
+    calloc.free(options);
+    if (spoolPath != null) {
+      malloc.free(spoolPath);
+    }
+    malloc.free(path);
+  }
+}
@@ -0,0 +1,187 @@
+import 'dart:async';
+import 'dart:ffi';
+import 'dart:isolate';
+
+import 'package:ffi/ffi.dart';
+
+import '../../planetary_stacker_bindings_generated.dart';
+import '../video/frame_extractor.dart' show VideoInfo;
+import 'native_library.dart';
+
+/// Progress callback type
+typedef ProgressCallback = void Function(int progress, String message);
+
+/// Selected-frame extraction on the native engine
+///
+/// Decodes each GOP that contains a requested frame once, in a single
+/// forward sweep, instead of launching one FFmpeg process and seek per frame.
+class NativeExtractor {
+  /// Whether the native library is bundled with this build
+  static bool get isAvailable => nativeBindings != null;
+
+  /// Read video metadata from the native frame index
+  ///
+  /// Frame counts are exact (counted from the packet index rather than
+  /// estimated from duration x frame rate). The index is cached next to the
+  /// video, so repeat calls don't re-read the file.
+  Future<VideoInfo> getVideoInfo(String videoPath) {
+    return Isolate.run(() => _getVideoInfo(videoPath));
+  }
+
+  /// Extract frames by index into [outputDir] as `frame_NNNNNN.png`
+  ///
+  /// [videoPath]: Path to the video file
+  /// [frameIndices]: Frame indices to extract (any order)
+  /// [outputDir]: Existing directory for the PNG files
+  /// [onProgress]: Optional progress callback
+  ///
+  /// Returns the number of frames written
+  Future<int> extractFrames({
+    required String videoPath,
+    required List<int> frameIndices,
+    required String outputDir,
+    ProgressCallback? onProgress,
+  }) async {
+    return _run(
+      (callbackAddress) => _extractFrames(
+        videoPath,
+        frameIndices,
+        outputDir,
+        null,
+        callbackAddress,
+      ),
+      onProgress,
+    );
+  }
+
+  /// Extract frames by index into a binary frame spool at [spoolPath]
+  ///
+  /// Cheaper than PNG files for frames that are read straight back by the
+  /// next stage; open the result with `FrameSpool.open`.
+  ///
+  /// [compress]: Store LZ4-compressed records (smaller file, small
+  /// decompression cost; ignored if the native build lacks LZ4)
+  ///
+  /// Returns the number of frames written
+  Future<int> extractFramesToSpool({
+    required String videoPath,
+    required List<int> frameIndices,
+    required String spoolPath,
+    bool compress = false,
+    ProgressCallback? onProgress,
+  }) async {
+    return _run(
+      (callbackAddress) => _extractFrames(
+        videoPath,
+        frameIndices,
+        spoolPath,
+        compress,
+        callbackAddress,
+      ),
+      onProgress,
+    );
+  }
+
+  Future<int> _run(
+    int Function(int callbackAddress) extract,
+    ProgressCallback? onProgress,
+  ) async {
+    final progress = NativeCallable<PSProgressCallbackFunction>.listener(
+      (int current, int total, Pointer<Void> _) {
+        if (total > 0) {
+          onProgress?.call(
+            (current * 100 / total).round().clamp(0, 100),
+            'Extracting frame $current/$total',
+          );
+        }
+      },
+    );
+
+    try {
+      final callbackAddress = progress.nativeFunction.address;
+      return await Isolate.run(() => extract(callbackAddress));
+    } finally {
+      progress.close();
+    }
+  }
+}
+
+/// Runs on a background isolate; may build the index on first use.
+VideoInfo _getVideoInfo(String videoPath) {
+  final bindings = nativeBindings!;
+  final path = videoPath.toNativeUtf8();
+  final info = calloc<PSVideoInfo>();
+
+  try {
+    if (bindings.ps_get_video_info(path.cast<Char>(), info) != 0) {
+      final error = bindings.ps_get_last_error().cast<Utf8>().toDartString();
+      throw Exception('Failed to read video info from: $videoPath ($error)');
+    }
+
+    return VideoInfo(
+      width: info.ref.width,
+      height: info.ref.height,
+      frameCount: info.ref.frame_count,
+      durationMs: info.ref.duration_ms,
+      frameRate: info.ref.frame_rate,
+    );
+  } finally {
+    calloc.free(info);
+    malloc.free(path);
+  }
+}
+
+/// Runs on a background isolate; blocks until extraction completes.
+///
+/// Writes PNGs into the directory [output], or a spool file at [output]
+/// when [compressSpool] is non-null.
+int _extractFrames(
+  String videoPath,
+  List<int> frameIndices,
+  String output,
+  bool? compressSpool,
+  int callbackAddress,
+) {
+  final bindings = nativeBindings!;
+  final path = videoPath.toNativeUtf8();
+  final dir = output.toNativeUtf8();
+  final indices = calloc<Int64>(frameIndices.isEmpty ? 1 : frameIndices.length);
+
+  try {
+    for (int i = 0; i < frameIndices.length; i++) {
+      indices[i] = frameIndices[i];
+    }
+
+    final callback =
+        Pointer<NativeFunction<PSProgressCallbackFunction>>.fromAddress(callbackAddress);
+    final written = compressSpool == null
+        ? bindings.ps_extract_frames(
+            path.cast<Char>(),
+            indices,
+            frameIndices.length,
+            dir.cast<Char>(),
+            callback,
+            nullptr,
+          )
+        : bindings.ps_extract_frames_to_spool(
+            path.cast<Char>(),
+            indices,
+            frameIndices.length,
+            dir.cast<Char>(),
+            compressSpool ? 1 : 0,
+            callback,
+            nullptr,
+          );
+
+    if (written < 0) {
+      final error = bindings.ps_get_last_error().cast<Utf8>().toDartString();
+      throw Exception('Native frame extraction failed: $error');
+    }
+
+    return written;
+  } finally {
+    calloc.free(indices);
+    malloc.free(dir);
+    malloc.free(path);
+  }
+}
@@ -0,0 +1,31 @@
+import 'dart:ffi';
+import 'dart:io';
+
+import '../../planetary_stacker_bindings_generated.dart';
+
+const String _libName = 'planetary_stacker';
+
+/// Bindings to the native engine (src/), or null when the native library
+/// is not bundled with the app. Callers fall back to the Dart pipeline.
+///
+/// Each isolate opens the library on first access.
+final PlanetaryStackerBindings? nativeBindings = () {
+  try {
+    return PlanetaryStackerBindings(_openLibrary());
+  } catch (_) {
+    return null;
+  }
+}();
+
+DynamicLibrary _openLibrary() {
+  if (Platform.isMacOS || Platform.isIOS) {
+    return DynamicLibrary.open('$_libName.framework/$_libName');
+  }
+  if (Platform.isAndroid || Platform.isLinux) {
+    return DynamicLibrary.open('lib$_libName.so');
+  }
+  if (Platform.isWindows) {
+    return DynamicLibrary.open('$_libName.dll');
+  }
+  throw UnsupportedError('Unknown platform: ${Platform.operatingSystem}');
+}
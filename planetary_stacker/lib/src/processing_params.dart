@@ -10,11 +10,22 @@ class ProcessingParams {
   /// Maximum number of frames to use
   final int maxFrames;
 
+  /// Spread the selection over the capture: frames are picked at most
+  /// [windowQuota] from every [spreadWindow] consecutive frames, so one
+  /// short spell of good seeing can't supply the whole stack
+  /// (0 = plain top frames). Native engine only.
+  final int spreadWindow;
+
+  /// Frames per [spreadWindow] (0 = twice a window's even share)
+  final int windowQuota;
+
   /// Enable tile-based local alignment
-  /// Slower but better quality for large planets
+  /// Slower but better quality for large planets. Native engine only;
+  /// the Dart fallback aligns by global translation.
   final bool enableLocalAlign;
 
-  /// Tile size for local alignment (16, 32, or 64)
+  /// Tile size for local alignment (16, 32, or 64); also the spacing of
+  /// the alignment points
   final int tileSize;
 
   /// Sigma clipping threshold for outlier rejection
@@ -30,6 +41,8 @@ class ProcessingParams {
     this.keepPercentage = 0.25,
     this.minFrames = 50,
     this.maxFrames = 500,
+    this.spreadWindow = 30,
+    this.windowQuota = 0,
     this.enableLocalAlign = true,
     this.tileSize = 32,
     this.sigmaClipThreshold = 2.5,
@@ -1,6 +1,10 @@
-import 'dart:math' as math;
+import 'dart:typed_data';
+
 import 'package:opencv_dart/opencv_dart.dart' as cv;
 
+import '../native/native_analyzer.dart' show NativeAnalyzer;
+import 'score_statistics.dart';
+
 /// Progress callback type
 typedef ProgressCallback = void Function(int progress, String message);
 
@@ -71,78 +75,78 @@ class QualityAssessor {
     }
   }
 
-  /// Analyze multiple frames and return sorted quality scores
+  /// Analyze multiple frames and return their quality scores
+  ///
+  /// With the native engine bundled, frames are scored on every core at
+  /// once; otherwise one after another on this isolate. Scores are
+  /// normalised against running statistics, so the frames are scanned
+  /// once, and ranked with a heap bounded by [keep].
   ///
   /// [framePaths]: List of paths to frame images
+  /// [keep]: Only return the best [keep] frames (default: all of them)
+  /// [ranked]: false returns every readable frame in [framePaths] order
+  ///   instead, with no ranking at all (for callers that select later)
   /// [onProgress]: Optional progress callback
   ///
-  /// Returns list of FrameQualityScore objects sorted by quality (best first)
+  /// Returns a FrameQualityScore per readable frame, best first (ties in
+  /// [framePaths] order)
   Future<List<FrameQualityScore>> analyzeFrames({
     required List<String> framePaths,
+    int? keep,
+    bool ranked = true,
     ProgressCallback? onProgress,
   }) async {
     if (framePaths.isEmpty) {
       return [];
     }
 
-    final scores = <FrameQualityScore>[];
-    final variances = <double>[];
-
-    // First pass: calculate all variances
+    // NaN = unreadable frame
+    final native = NativeAnalyzer.isAvailable;
+    final variances = native
+        ? await NativeAnalyzer().scoreImages(paths: framePaths, onProgress: onProgress)
+        : Float64List(framePaths.length);
+    final stats = ScoreStatistics();
     for (int i = 0; i < framePaths.length; i++) {
-      try {
-        final variance = await calculateLaplacianVariance(framePaths[i]);
-        variances.add(variance);
-        scores.add(FrameQualityScore(
-          framePath: framePaths[i],
-          frameIndex: _extractFrameIndex(framePaths[i]),
-          rawVariance: variance,
-          normalizedScore: 0.0, // Will be normalized later
-        ));
-      } catch (e) {
-        // Skip frames that fail to load
-        continue;
+      if (!native) {
+        try {
+          variances[i] = await calculateLaplacianVariance(framePaths[i]);
+        } catch (e) {
+          // Skip frames that fail to load
+          variances[i] = double.nan;
+        }
+        onProgress?.call(
+          ((i + 1) * 100 / framePaths.length).round(),
+          'Analyzing frame ${i + 1}/${framePaths.length}',
+        );
       }
-
-      onProgress?.call(
-        ((i + 1) * 100 / framePaths.length).round(),
-        'Analyzing frame ${i + 1}/${framePaths.length}',
-      );
+      stats.add(variances[i]);
     }
 
-    if (scores.isEmpty) {
+    if (stats.count == 0) {
       return [];
     }
 
-    // Find min and max for normalization
-    final minVariance = variances.reduce(math.min);
-    final maxVariance = variances.reduce(math.max);
-    final range = maxVariance - minVariance;
-
-    // Normalize scores to 0-1 range
-    final normalizedScores = <FrameQualityScore>[];
-    for (final score in scores) {
-      final normalizedScore = range > 0
-          ? (score.rawVariance - minVariance) / range
-          : 1.0;
-
-      normalizedScores.add(FrameQualityScore(
-        framePath: score.framePath,
-        frameIndex: score.frameIndex,
-        rawVariance: score.rawVariance,
-        normalizedScore: normalizedScore,
-      ));
-    }
-
-    // Sort by quality (best first = highest score first)
-    normalizedScores.sort((a, b) => b.normalizedScore.compareTo(a.normalizedScore));
+    FrameQualityScore scoreOf(int i) => FrameQualityScore(
+          framePath: framePaths[i],
+          frameIndex: _extractFrameIndex(framePaths[i]),
+          rawVariance: variances[i],
+          normalizedScore: stats.normalize(variances[i]),
+        );
 
-    return normalizedScores;
+    final frames = Iterable<int>.generate(framePaths.length);
+    if (!ranked && keep == null) {
+      return frames.where((i) => !variances[i].isNaN).map(scoreOf).toList();
+    }
+    // selectTop skips the NaN (unreadable) frames
+    return selectTop(frames, keep ?? framePaths.length, (int i) => variances[i])
+        .map(scoreOf)
+        .toList();
   }
 
   /// Extract frame index from filename
   ///
-  /// Expects filenames like "frame_000123.png" or "frame_123.png"
+  /// Expects filenames like "frame_000123.png" or "frame_123.png", where
+  /// the number is the frame's index in the video (see FrameExtractor)
   int _extractFrameIndex(String path) {
     final filename = path.split('/').last.split('\\').last;
     final match = RegExp(r'frame_0*(\d+)\.png').firstMatch(filename);
@@ -0,0 +1,208 @@
+import 'dart:math' as math;
+import 'dart:typed_data';
+
+/// Streaming estimate of one quantile (the P² algorithm, Jain & Chlamtac)
+///
+/// Five markers track the minimum, the [p]/2, [p] and (1+[p])/2 quantiles
+/// and the maximum; as values arrive the inner markers are nudged towards
+/// their ideal positions along a piecewise-parabolic fit. Constant memory
+/// and time per value, and exact until the sixth value.
+class P2Quantile {
+  /// Quantile to estimate (0.5 = median)
+  final double p;
+
+  final _heights = Float64List(5);
+  final _positions = Float64List(5);
+  final _desired = Float64List(5);
+  final Float64List _increments;
+  int _count = 0;
+
+  P2Quantile(this.p) : _increments = Float64List.fromList([0, p / 2, p, (1 + p) / 2, 1]) {
+    assert(p >= 0 && p <= 1);
+  }
+
+  /// Number of values seen
+  int get count => _count;
+
+  void add(double x) {
+    if (_count < 5) {
+      _heights[_count++] = x;
+      if (_count == 5) {
+        _heights.sort();
+        for (int i = 0; i < 5; i++) {
+          _positions[i] = i + 1.0;
+        }
+        _desired.setAll(0, [1, 1 + 2 * p, 1 + 4 * p, 3 + 2 * p, 5]);
+      }
+      return;
+    }
+    _count++;
+
+    // Cell the value falls in, widening the extremes when it is new
+    int k;
+    if (x < _heights[0]) {
+      _heights[0] = x;
+      k = 0;
+    } else if (x >= _heights[4]) {
+      _heights[4] = x;
+      k = 3;
+    } else {
+      k = 0;
+      while (x >= _heights[k + 1]) {
+        k++;
+      }
+    }
+
+    for (int i = k + 1; i < 5; i++) {
+      _positions[i]++;
+    }
+    for (int i = 0; i < 5; i++) {
+      _desired[i] += _increments[i];
+    }
+
+    for (int i = 1; i < 4; i++) {
+      final offset = _desired[i] - _positions[i];
+      if ((offset >= 1 && _positions[i + 1] - _positions[i] > 1) ||
+          (offset <= -1 && _positions[i - 1] - _positions[i] < -1)) {
+        final d = offset.sign;
+        final parabolic = _parabolic(i, d);
+        _heights[i] = _heights[i - 1] < parabolic && parabolic < _heights[i + 1]
+            ? parabolic
+            : _linear(i, d.toInt());
+        _positions[i] += d;
+      }
+    }
+  }
+
+  /// Current estimate (NaN before any value)
+  double get value {
+    if (_count == 0) {
+      return double.nan;
+    }
+    if (_count < 5) {
+      final seen = Float64List.sublistView(_heights, 0, _count).toList()..sort();
+      return seen[(_count * p).floor().clamp(0, _count - 1)];
+    }
+    return _heights[2];
+  }
+
+  double _parabolic(int i, double d) {
+    final q = _heights;
+    final n = _positions;
+    return q[i] +
+        d / (n[i + 1] - n[i - 1]) *
+            ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+                (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+  }
+
+  double _linear(int i, int d) =>
+      _heights[i] + d * (_heights[i + d] - _heights[i]) / (_positions[i + d] - _positions[i]);
+}
+
+/// Running summary of a stream of scores: min, max, mean and an
+/// estimated median, in constant memory
+class ScoreStatistics {
+  int _count = 0;
+  double _min = double.infinity;
+  double _max = double.negativeInfinity;
+  double _mean = 0;
+  final _median = P2Quantile(0.5);
+
+  /// Add [value]; NaN (an unscored frame) is ignored
+  void add(double value) {
+    if (value.isNaN) {
+      return;
+    }
+    _count++;
+    _min = math.min(_min, value);
+    _max = math.max(_max, value);
+    _mean += (value - _mean) / _count;
+    _median.add(value);
+  }
+
+  int get count => _count;
+  double get min => _count > 0 ? _min : 0;
+  double get max => _count > 0 ? _max : 0;
+  double get mean => _mean;
+  double get median => _count > 0 ? _median.value : 0;
+
+  /// [value] mapped to 0-1 between the smallest and largest value seen
+  /// (1.0 when they are all equal)
+  double normalize(double value) {
+    final range = _max - _min;
+    return range > 0 ? (value - _min) / range : 1.0;
+  }
+}
+
+/// The [k] items of [items] with the highest [score], best first
+///
+/// Keeps a bounded min-heap of the best so far, so it takes O(n log k)
+/// time and O(k) memory and never sorts or copies the whole input. Ties
+/// keep the earlier item; items scoring NaN are skipped.
+List<T> selectTop<T>(Iterable<T> items, int k, double Function(T) score) {
+  if (k <= 0) {
+    return <T>[];
+  }
+
+  final heap = <_Ranked<T>>[];
+  int sequence = 0;
+  for (final item in items) {
+    final ranked = _Ranked(item, score(item), sequence++);
+    if (ranked.score.isNaN) {
+      continue;
+    }
+    if (heap.length < k) {
+      heap.add(ranked);
+      _siftUp(heap, heap.length - 1);
+    } else if (heap[0].isWorseThan(ranked)) {
+      heap[0] = ranked;
+      _siftDown(heap, 0);
+    }
+  }
+
+  heap.sort((a, b) => a.isWorseThan(b) ? 1 : -1);
+  return [for (final ranked in heap) ranked.item];
+}
+
+class _Ranked<T> {
+  final T item;
+  final double score;
+  final int sequence;
+
+  const _Ranked(this.item, this.score, this.sequence);
+
+  bool isWorseThan(_Ranked<T> other) =>
+      score < other.score || (score == other.score && sequence > other.sequence);
+}
+
+// Min-heap on quality: the root is the worst item kept
+void _siftUp<T>(List<_Ranked<T>> heap, int i) {
+  while (i > 0) {
+    final parent = (i - 1) >> 1;
+    if (!heap[i].isWorseThan(heap[parent])) {
+      return;
+    }
+    final swap = heap[i];
+    heap[i] = heap[parent];
+    heap[parent] = swap;
+    i = parent;
+  }
+}
+
+void _siftDown<T>(List<_Ranked<T>> heap, int i) {
+  while (true) {
+    final left = 2 * i + 1;
+    if (left >= heap.length) {
+      return;
+    }
+    final right = left + 1;
+    final worst = right < heap.length && heap[right].isWorseThan(heap[left]) ? right : left;
+    if (!heap[worst].isWorseThan(heap[i])) {
+      return;
+    }
+    final swap = heap[i];
+    heap[i] = heap[worst];
+    heap[worst] = swap;
+    i = worst;
+  }
+}
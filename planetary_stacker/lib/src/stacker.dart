@@ -7,9 +7,11 @@ import 'frame_analysis.dart';
 import 'processing_params.dart';
 import 'video/frame_extractor.dart';
 import 'quality/quality_assessor.dart';
+import 'alignment/frame_transform.dart';
 import 'alignment/phase_correlator.dart';
 import 'stacking/sigma_clip_stacker.dart';
 import 'sharpening/wavelet_sharpener.dart';
+import 'native/native_analyzer.dart';
 
 /// Progress callback typedef
 typedef ProgressCallback = void Function(int progress, String message);
@@ -20,8 +22,8 @@ typedef ProgressCallback = void Function(int progress, String message);
 /// 1. Extract frames from video
 /// 2. Analyze frame quality (Laplacian variance)
 /// 3. Select best frames
-/// 4. Align frames (phase correlation)
-/// 5. Stack frames (sigma clipping)
+/// 4. Align frames (phase correlation; transforms only, frames untouched)
+/// 5. Stack frames through their transforms (sigma clipping)
 /// 6. Sharpen result (wavelet sharpening)
 /// 7. Save output
 class PlanetaryStacker {
@@ -30,11 +32,15 @@ class PlanetaryStacker {
   final PhaseCorrelator _phaseCorrelator = PhaseCorrelator();
   final SigmaClipStacker _sigmaClipStacker = SigmaClipStacker();
   final WaveletSharpener _waveletSharpener = WaveletSharpener();
+  final NativeAnalyzer _nativeAnalyzer = NativeAnalyzer();
 
   /// Analyze video frames for quality
   ///
   /// Returns an [AnalysisResult] containing quality scores for all analyzed frames.
   ///
+  /// Uses the native streaming decoder when the native library is bundled;
+  /// otherwise extracts PNG frames with FFmpeg and scores them in Dart.
+  ///
   /// [videoPath]: Path to the input video file (MP4/MOV)
   /// [sampleStep]: Analyze every Nth frame (default: 3)
   /// [onProgress]: Optional progress callback
@@ -43,6 +49,17 @@ class PlanetaryStacker {
     int sampleStep = 3,
     ProgressCallback? onProgress,
   }) async {
+    if (NativeAnalyzer.isAvailable) {
+      onProgress?.call(0, 'Analyzing frame quality...');
+      final result = await _nativeAnalyzer.analyzeVideo(
+        videoPath: videoPath,
+        sampleStep: sampleStep,
+        onProgress: onProgress,
+      );
+      onProgress?.call(100, 'Analysis complete');
+      return result;
+    }
+
     onProgress?.call(0, 'Getting video info...');
 
     // Get video metadata
@@ -59,9 +76,11 @@ class PlanetaryStacker {
 
     onProgress?.call(45, 'Analyzing frame quality...');
 
-    // Analyze frame quality
+    // Analyze frame quality; AnalysisResult selects its own top frames,
+    // so the scores stay in frame order
     final qualityScores = await _qualityAssessor.analyzeFrames(
       framePaths: framePaths,
+      ranked: false,
       onProgress: (p, m) => onProgress?.call(45 + (p * 0.5).round(), m),
     );
 
@@ -99,61 +118,134 @@ class PlanetaryStacker {
     try {
       // Stage 1: Analyze frames (0-15%)
       onProgress?.call(0, 'Analyzing video...');
-      final analysis = await analyzeVideo(
-        videoPath: videoPath,
-        sampleStep: 2,
-        onProgress: (p, m) => onProgress?.call((p * 0.15).round(), m),
-      );
+
+      // Native single-decode mode: the analysis pass keeps the frames that
+      // selection will pick, so they aren't decoded a second time
+      String? cacheSpoolPath;
+      final AnalysisResult analysis;
+      if (NativeAnalyzer.isAvailable) {
+        final info = await _frameExtractor.getVideoInfo(videoPath);
+        final framesDir = await _frameExtractor.getFramesDirectory();
+        cacheSpoolPath = '${framesDir.path}/analysis.psspool';
+        final selectionSize = _selectionSize(
+          (info.frameCount / _processSampleStep).ceil(),
+          params,
+        );
+        analysis = await _nativeAnalyzer.analyzeVideo(
+          videoPath: videoPath,
+          sampleStep: _processSampleStep,
+          cacheFrames: selectionSize,
+          cacheSpoolPath: cacheSpoolPath,
+          downscale: _analysisDownscale(info.width),
+          tileSize: params.enableLocalAlign ? params.tileSize : 0,
+          selectCount: selectionSize,
+          selectWindow: params.spreadWindow,
+          selectQuota: params.windowQuota,
+          rescoreCount: selectionSize,
+          reuseScores: true,
+          rankCount: selectionSize,
+          onProgress: (p, m) => onProgress?.call((p * 0.15).round(), m),
+        );
+      } else {
+        analysis = await analyzeVideo(
+          videoPath: videoPath,
+          sampleStep: _processSampleStep,
+          onProgress: (p, m) => onProgress?.call((p * 0.15).round(), m),
+        );
+      }
 
       if (analysis.scores.isEmpty) {
         throw Exception('No frames could be analyzed');
       }
 
-      // Stage 2: Select best frames (15-20%)
+      // Stage 2: Select best frames (15-20%); the native pass has already
+      // picked them, spread over the capture
       onProgress?.call(15, 'Selecting best frames...');
-      final framesToUse = analysis.getTopFrames(params.keepPercentage);
-      final frameCount = framesToUse.length.clamp(params.minFrames, params.maxFrames);
-      final selectedFrames = framesToUse.take(frameCount).toList();
+      final frameIndices = analysis.selectedFrames ??
+          analysis
+              .getTopNFrames(_selectionSize(analysis.scores.length, params))
+              .map((f) => f.frameIndex)
+              .toList();
 
-      onProgress?.call(20, 'Selected ${selectedFrames.length} frames');
+      onProgress?.call(20, 'Selected ${frameIndices.length} frames');
 
       // Stage 3: Extract selected frames (20-35%)
       onProgress?.call(20, 'Extracting selected frames...');
-      final frameIndices = selectedFrames.map((f) => f.frameIndex).toList();
-      final framePaths = await _frameExtractor.extractFrames(
-        videoPath: videoPath,
-        frameIndices: frameIndices,
-        onProgress: (p, m) => onProgress?.call(20 + (p * 0.15).round(), m),
-      );
-
-      if (framePaths.isEmpty) {
-        throw Exception('No frames could be extracted');
-      }
-
-      // Stage 4: Load and align frames (35-55%)
-      onProgress?.call(35, 'Aligning frames...');
-      final alignedFrames = await _phaseCorrelator.alignFramesFromPaths(
-        framePaths: framePaths,
-        referenceIndex: 0, // Use best quality frame as reference
-        onProgress: (p, m) => onProgress?.call(35 + (p * 0.2).round(), m),
-      );
-
-      if (alignedFrames.isEmpty) {
-        throw Exception('Frame alignment failed');
+      // Alignment only measures each frame's transform; the stacker samples
+      // the frames through them, so no aligned copies are made
+      final List<cv.Mat> frames;
+      final List<FrameTransform> transforms;
+      if (cacheSpoolPath != null) {
+        // Frames come straight from the analysis spool (memory-mapped)
+        frames = await _frameExtractor.loadFramesWithCache(
+          videoPath: videoPath,
+          frameIndices: frameIndices,
+          cacheSpoolPath: cacheSpoolPath,
+          onProgress: (p, m) => onProgress?.call(20 + (p * 0.15).round(), m),
+        );
+
+        if (frames.isEmpty) {
+          throw Exception('No frames could be extracted');
+        }
+
+        // Stage 4: Align frames (35-55%)
+        onProgress?.call(35, 'Aligning frames...');
+        try {
+          transforms = await _phaseCorrelator.alignFrames(
+            frames: frames,
+            referenceIndex: 0, // Use best quality frame as reference
+            tileSize: params.enableLocalAlign ? params.tileSize : 0,
+            onProgress: (p, m) => onProgress?.call(35 + (p * 0.2).round(), m),
+          );
+        } catch (_) {
+          for (final frame in frames) {
+            frame.dispose();
+          }
+          rethrow;
+        }
+      } else {
+        final framePaths = await _frameExtractor.extractFrames(
+          videoPath: videoPath,
+          frameIndices: frameIndices,
+          onProgress: (p, m) => onProgress?.call(20 + (p * 0.15).round(), m),
+        );
+
+        if (framePaths.isEmpty) {
+          throw Exception('No frames could be extracted');
+        }
+
+        // Stage 4: Load and align frames (35-55%)
+        onProgress?.call(35, 'Aligning frames...');
+        final loaded = await _phaseCorrelator.alignFramesFromPaths(
+          framePaths: framePaths,
+          referenceIndex: 0, // Use best quality frame as reference
+          tileSize: params.enableLocalAlign ? params.tileSize : 0,
+          onProgress: (p, m) => onProgress?.call(35 + (p * 0.2).round(), m),
+        );
+        frames = loaded.frames;
+        transforms = loaded.transforms;
       }
 
       // Stage 5: Stack frames (55-75%)
-      onProgress?.call(55, 'Stacking frames...');
-      final stacked = await _sigmaClipStacker.stackFrames(
-        alignedFrames: alignedFrames,
-        sigmaThreshold: params.sigmaClipThreshold,
-        iterations: params.sigmaIterations,
-        onProgress: (p, m) => onProgress?.call(55 + (p * 0.2).round(), m),
-      );
-
-      // Dispose aligned frames (no longer needed)
-      for (final frame in alignedFrames) {
-        frame.dispose();
+      final cv.Mat stacked;
+      try {
+        if (frames.isEmpty) {
+          throw Exception('Frame alignment failed');
+        }
+
+        onProgress?.call(55, 'Stacking frames...');
+        stacked = await _sigmaClipStacker.stackFrames(
+          frames: frames,
+          transforms: transforms,
+          sigmaThreshold: params.sigmaClipThreshold,
+          iterations: params.sigmaIterations,
+          onProgress: (p, m) => onProgress?.call(55 + (p * 0.2).round(), m),
+        );
+      } finally {
+        // Dispose source frames (no longer needed)
+        for (final frame in frames) {
+          frame.dispose();
+        }
       }
 
       // Stage 6: Wavelet sharpening (75-90%)
@@ -205,6 +297,26 @@ class PlanetaryStacker {
     }
   }
 
+  /// Sample step used by [processVideo]'s analysis pass
+  static const int _processSampleStep = 2;
+
+  /// Thumbnail factor for [processVideo]'s coarse pass over [width]-pixel
+  /// video. The frames that can make the selection are rescored at full
+  /// resolution afterwards, so the thumbnails only have to separate
+  /// contenders from obvious rejects.
+  static int _analysisDownscale(int width) => width >= 1280 ? 4 : 2;
+
+  /// Number of frames [processVideo]'s selection stage keeps out of
+  /// [analyzedCount] scored frames; sizes both the native selection and
+  /// the analysis cache, so the cache holds the frames that get selected
+  static int _selectionSize(int analyzedCount, ProcessingParams params) {
+    if (analyzedCount <= 0) {
+      return 0;
+    }
+    final topCount = (analyzedCount * params.keepPercentage).round().clamp(1, analyzedCount);
+    return topCount < params.maxFrames ? topCount : params.maxFrames;
+  }
+
   /// Quick process with sensible defaults
   ///
   /// Uses automatic preset selection based on common planetary targets.
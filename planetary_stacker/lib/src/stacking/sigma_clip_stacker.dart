@@ -1,85 +1,62 @@
 import 'dart:math' as math;
+import 'dart:typed_data';
 import 'package:opencv_dart/opencv_dart.dart' as cv;
 
+import '../alignment/frame_transform.dart';
+
 /// Progress callback type
 typedef ProgressCallback = void Function(int progress, String message);
 
-/// Stacks aligned frames using sigma-clipped averaging
+/// Stacks frames using sigma-clipped averaging
 ///
 /// Sigma clipping rejects outlier pixels (cosmic rays, hot pixels, atmospheric
 /// spikes) by excluding values that deviate too far from the mean.
+///
+/// Frames are stacked as captured: each is sampled through its alignment
+/// transform (bilinear, reflected borders) one output row at a time, so no
+/// aligned copy of a frame is ever allocated.
 class SigmaClipStacker {
   /// Stack frames using sigma-clipped averaging
   ///
-  /// [alignedFrames]: List of aligned frames to stack (must all be same size)
+  /// [frames]: List of frames to stack (must all be same size, gray or BGR)
+  /// [transforms]: Alignment of each frame onto the reference, from
+  ///   [PhaseCorrelator.alignFrames] (null = frames are already aligned)
   /// [sigmaThreshold]: Reject pixels beyond this many standard deviations (default: 2.5)
   /// [iterations]: Number of clipping iterations (default: 2)
   /// [onProgress]: Optional progress callback
   ///
   /// Returns the stacked image
   Future<cv.Mat> stackFrames({
-    required List<cv.Mat> alignedFrames,
+    required List<cv.Mat> frames,
+    List<FrameTransform>? transforms,
     double sigmaThreshold = 2.5,
     int iterations = 2,
     ProgressCallback? onProgress,
   }) async {
-    if (alignedFrames.isEmpty) {
-      throw ArgumentError('No frames to stack');
-    }
+    final samplers = _samplers(frames, transforms);
+    final height = frames[0].rows;
+    final width = frames[0].cols;
+    final channels = frames[0].channels;
+    final rowLength = width * channels;
 
-    final height = alignedFrames[0].rows;
-    final width = alignedFrames[0].cols;
-    final channels = alignedFrames[0].channels;
+    final rows = [for (final _ in frames) Float64List(rowLength)];
+    final values = List<double>.filled(frames.length, 0);
+    final pixels = Uint8List(height * rowLength);
 
-    // Validate all frames have same dimensions
-    for (final frame in alignedFrames) {
-      if (frame.rows != height || frame.cols != width || frame.channels != channels) {
-        throw ArgumentError('All frames must have the same dimensions');
+    // Process each row: every frame sampled into its row buffer, then
+    // each pixel (and channel) clipped across the frames
+    for (int y = 0; y < height; y++) {
+      for (int i = 0; i < samplers.length; i++) {
+        samplers[i].sampleRow(y, rows[i]);
       }
-    }
-
-    // Create output matrix
-    final cv.Mat result;
-    if (channels == 1) {
-      result = cv.Mat.zeros(height, width, cv.MatType.CV_8UC1);
-    } else {
-      result = cv.Mat.zeros(height, width, cv.MatType.CV_8UC3);
-    }
 
-    // Process each pixel position
-    for (int y = 0; y < height; y++) {
-      for (int x = 0; x < width; x++) {
-        if (channels == 1) {
-          // Grayscale
-          final values = <double>[];
-          for (final frame in alignedFrames) {
-            values.add(frame.at<num>(y, x).toDouble());
-          }
-          final clippedMean = _sigmaClippedMean(values, sigmaThreshold, iterations);
-          result.set<int>(y, x, clippedMean.round().clamp(0, 255));
-        } else {
-          // Color (BGR) - process each channel
-          final valuesB = <double>[];
-          final valuesG = <double>[];
-          final valuesR = <double>[];
-
-          for (final frame in alignedFrames) {
-            final vec = frame.at<cv.Vec3b>(y, x);
-            valuesB.add(vec.val1.toDouble());
-            valuesG.add(vec.val2.toDouble());
-            valuesR.add(vec.val3.toDouble());
-          }
-
-          final meanB = _sigmaClippedMean(valuesB, sigmaThreshold, iterations);
-          final meanG = _sigmaClippedMean(valuesG, sigmaThreshold, iterations);
-          final meanR = _sigmaClippedMean(valuesR, sigmaThreshold, iterations);
-
-          result.set<cv.Vec3b>(y, x, cv.Vec3b(
-            meanB.round().clamp(0, 255),
-            meanG.round().clamp(0, 255),
-            meanR.round().clamp(0, 255),
-          ));
+      final offset = y * rowLength;
+      for (int k = 0; k < rowLength; k++) {
+        for (int i = 0; i < rows.length; i++) {
+          values[i] = rows[i][k];
         }
+        final clippedMean = _sigmaClippedMean(values, sigmaThreshold, iterations);
+        pixels[offset + k] = clippedMean.round().clamp(0, 255);
       }
 
       if (y % 50 == 0 || y == height - 1) {
@@ -90,7 +67,7 @@ class SigmaClipStacker {
       }
     }
 
-    return result;
+    return _toMat(pixels, height, width, channels);
   }
 
   /// Calculate sigma-clipped mean of values
@@ -141,52 +118,38 @@ class SigmaClipStacker {
   }
 
   /// Simple average stacking (no outlier rejection)
+  ///
+  /// [frames] and [transforms] as for [stackFrames]
   Future<cv.Mat> stackFramesSimple({
-    required List<cv.Mat> alignedFrames,
+    required List<cv.Mat> frames,
+    List<FrameTransform>? transforms,
     ProgressCallback? onProgress,
   }) async {
-    if (alignedFrames.isEmpty) {
-      throw ArgumentError('No frames to stack');
-    }
+    final samplers = _samplers(frames, transforms);
+    final height = frames[0].rows;
+    final width = frames[0].cols;
+    final channels = frames[0].channels;
+    final rowLength = width * channels;
 
-    final height = alignedFrames[0].rows;
-    final width = alignedFrames[0].cols;
-    final channels = alignedFrames[0].channels;
-    final numFrames = alignedFrames.length;
-
-    // Create output matrix
-    final cv.Mat result;
-    if (channels == 1) {
-      result = cv.Mat.zeros(height, width, cv.MatType.CV_8UC1);
-    } else {
-      result = cv.Mat.zeros(height, width, cv.MatType.CV_8UC3);
-    }
+    final row = Float64List(rowLength);
+    final sums = Float64List(rowLength);
+    final pixels = Uint8List(height * rowLength);
 
-    // Process each pixel
+    // Process each row, accumulating one frame at a time
     for (int y = 0; y < height; y++) {
-      for (int x = 0; x < width; x++) {
-        if (channels == 1) {
-          double sum = 0;
-          for (final frame in alignedFrames) {
-            sum += frame.at<num>(y, x).toDouble();
-          }
-          result.set<int>(y, x, (sum / numFrames).round().clamp(0, 255));
-        } else {
-          double sumB = 0, sumG = 0, sumR = 0;
-          for (final frame in alignedFrames) {
-            final vec = frame.at<cv.Vec3b>(y, x);
-            sumB += vec.val1;
-            sumG += vec.val2;
-            sumR += vec.val3;
-          }
-          result.set<cv.Vec3b>(y, x, cv.Vec3b(
-            (sumB / numFrames).round().clamp(0, 255),
-            (sumG / numFrames).round().clamp(0, 255),
-            (sumR / numFrames).round().clamp(0, 255),
-          ));
+      sums.fillRange(0, rowLength, 0);
+      for (final sampler in samplers) {
+        sampler.sampleRow(y, row);
+        for (int k = 0; k < rowLength; k++) {
+          sums[k] += row[k];
         }
       }
 
+      final offset = y * rowLength;
+      for (int k = 0; k < rowLength; k++) {
+        pixels[offset + k] = (sums[k] / samplers.length).round().clamp(0, 255);
+      }
+
       if (y % 50 == 0 || y == height - 1) {
         onProgress?.call(
           ((y + 1) * 100 / height).round(),
@@ -195,6 +158,133 @@ class SigmaClipStacker {
       }
     }
 
+    return _toMat(pixels, height, width, channels);
+  }
+
+  /// Samplers for [frames] through [transforms], after checking that the
+  /// frames can be stacked together
+  List<_FrameSampler> _samplers(List<cv.Mat> frames, List<FrameTransform>? transforms) {
+    if (frames.isEmpty) {
+      throw ArgumentError('No frames to stack');
+    }
+    if (transforms != null && transforms.length != frames.length) {
+      throw ArgumentError('Need one transform per frame');
+    }
+
+    final height = frames[0].rows;
+    final width = frames[0].cols;
+    final channels = frames[0].channels;
+    if (channels != 1 && channels != 3) {
+      throw ArgumentError('Frames must be grayscale or BGR');
+    }
+
+    // Validate all frames have same dimensions
+    for (final frame in frames) {
+      if (frame.rows != height || frame.cols != width || frame.channels != channels) {
+        throw ArgumentError('All frames must have the same dimensions');
+      }
+    }
+
+    return [
+      for (int i = 0; i < frames.length; i++)
+        _FrameSampler(frames[i], transforms?[i] ?? FrameTransform.identity),
+    ];
+  }
+
+  /// 8-bit Mat holding [pixels]
+  cv.Mat _toMat(Uint8List pixels, int height, int width, int channels) {
+    final result = cv.Mat.create(
+      rows: height,
+      cols: width,
+      type: channels == 1 ? cv.MatType.CV_8UC1 : cv.MatType.CV_8UC3,
+    );
+    result.data.setAll(0, pixels);
     return result;
   }
 }
+
+/// One frame read through its alignment transform, a row at a time
+///
+/// Reads the frame's own pixel buffer in place. Each output pixel takes
+/// the frame at its position minus the transform's shift there, blended
+/// bilinearly; positions off the frame reflect back in like
+/// BORDER_REFLECT, as warpAffine did for the aligned copies.
+class _FrameSampler {
+  final Uint8List _pixels;
+  final int _width;
+  final int _height;
+  final int _channels;
+  final FrameTransform _transform;
+
+  // Per-column shifts of the current row (warp grids only)
+  final Float32List? _dx;
+  final Float32List? _dy;
+
+  _FrameSampler(cv.Mat frame, this._transform)
+      : _pixels = frame.data,
+        _width = frame.cols,
+        _height = frame.rows,
+        _channels = frame.channels,
+        _dx = _transform.grid != null ? Float32List(frame.cols) : null,
+        _dy = _transform.grid != null ? Float32List(frame.cols) : null;
+
+  /// Row [y] of the aligned frame into [out] (width * channels values)
+  void sampleRow(int y, Float64List out) {
+    final rowLength = _width * _channels;
+    if (_transform.isIdentity) {
+      final offset = y * rowLength;
+      for (int k = 0; k < rowLength; k++) {
+        out[k] = _pixels[offset + k].toDouble();
+      }
+      return;
+    }
+
+    final grid = _transform.grid;
+    if (grid != null) {
+      grid.rowShifts(y, _dx!, _dy!);
+    }
+
+    // A plain translation has the same source row and weights all along
+    // the row; only a warp grid needs them per pixel
+    var sy = y - _transform.shiftY;
+    var y0 = sy.floor();
+    var fy = sy - y0;
+    var row0 = _reflect(y0, _height) * rowLength;
+    var row1 = _reflect(y0 + 1, _height) * rowLength;
+
+    for (int x = 0; x < _width; x++) {
+      final double sx;
+      if (grid != null) {
+        sx = x - _dx![x];
+        sy = y - _dy![x];
+        y0 = sy.floor();
+        fy = sy - y0;
+        row0 = _reflect(y0, _height) * rowLength;
+        row1 = _reflect(y0 + 1, _height) * rowLength;
+      } else {
+        sx = x - _transform.shiftX;
+      }
+      final x0 = sx.floor();
+      final fx = sx - x0;
+      final col0 = _reflect(x0, _width) * _channels;
+      final col1 = _reflect(x0 + 1, _width) * _channels;
+
+      for (int c = 0; c < _channels; c++) {
+        final top = _pixels[row0 + col0 + c] + (_pixels[row0 + col1 + c] - _pixels[row0 + col0 + c]) * fx;
+        final bottom = _pixels[row1 + col0 + c] + (_pixels[row1 + col1 + c] - _pixels[row1 + col0 + c]) * fx;
+        out[x * _channels + c] = top + (bottom - top) * fy;
+      }
+    }
+  }
+
+  /// BORDER_REFLECT index into [n] samples: fedcba|abcdefgh|hgfedcb
+  static int _reflect(int i, int n) {
+    if (n == 1) {
+      return 0;
+    }
+    while (i < 0 || i >= n) {
+      i = i < 0 ? -i - 1 : 2 * n - i - 1;
+    }
+    return i;
+  }
+}
@@ -2,9 +2,13 @@ import 'dart:io';
 import 'package:ffmpeg_kit_flutter_new/ffmpeg_kit.dart';
 import 'package:ffmpeg_kit_flutter_new/ffprobe_kit.dart';
 import 'package:ffmpeg_kit_flutter_new/return_code.dart';
+import 'package:opencv_dart/opencv_dart.dart' as cv;
 import 'package:path_provider/path_provider.dart';
 import 'package:path/path.dart' as p;
 
+import '../native/frame_spool.dart';
+import '../native/native_extractor.dart';
+
 /// Video metadata information
 class VideoInfo {
   final int width;
@@ -31,8 +35,14 @@ typedef ProgressCallback = void Function(int progress, String message);
 
 /// Extracts frames from video files using FFmpeg
 class FrameExtractor {
+  final NativeExtractor _nativeExtractor = NativeExtractor();
+
   /// Get video metadata
   Future<VideoInfo> getVideoInfo(String videoPath) async {
+    if (NativeExtractor.isAvailable) {
+      return _nativeExtractor.getVideoInfo(videoPath);
+    }
+
     final session = await FFprobeKit.getMediaInformation(videoPath);
     final info = session.getMediaInformation();
 
@@ -77,8 +87,10 @@ class FrameExtractor {
     );
   }
 
-  /// Get temporary directory for frame extraction
-  Future<Directory> _getFramesDirectory() async {
+  /// Get an empty temporary directory for frame extraction
+  ///
+  /// Any frames from a previous extraction are deleted.
+  Future<Directory> getFramesDirectory() async {
     final tempDir = await getTemporaryDirectory();
     final framesDir = Directory(p.join(tempDir.path, 'planetary_frames'));
 
@@ -97,31 +109,25 @@ class FrameExtractor {
   /// [sampleStep]: Extract every Nth frame (1 = all frames, 3 = every 3rd frame)
   /// [onProgress]: Optional progress callback
   ///
-  /// Returns list of paths to extracted PNG frames
+  /// Returns list of paths to extracted PNG frames, in frame order, each
+  /// named frame_<index>.png after its frame number in the video
   Future<List<String>> extractFramesForAnalysis({
     required String videoPath,
     int sampleStep = 3,
     ProgressCallback? onProgress,
   }) async {
-    final info = await getVideoInfo(videoPath);
-    final framesDir = await _getFramesDirectory();
+    final framesDir = await getFramesDirectory();
 
     onProgress?.call(0, 'Starting frame extraction...');
 
-    // Calculate how many frames we'll extract
-    final framesToExtract = (info.frameCount / sampleStep).ceil();
-
-    // Use FFmpeg to extract frames
-    // -vf select='not(mod(n,$sampleStep))' selects every Nth frame
-    // Using frame rate filter to control extraction
-    final outputPattern = p.join(framesDir.path, 'frame_%06d.png');
-
-    // Build FFmpeg command
-    // Extract every Nth frame using the select filter
+    // Every Nth decoded frame; the image muxer numbers its output 0, 1,
+    // 2, ... so output k is frame k * sampleStep, and is renamed to it
+    final outputPattern = p.join(framesDir.path, 'sample_%06d.png');
     final command = '-y -i "$videoPath" '
         '-vf "select=not(mod(n\\,$sampleStep))" '
         '-vsync vfr '
         '-pix_fmt rgb24 '
+        '-start_number 0 '
         '"$outputPattern"';
 
     final session = await FFmpegKit.execute(command);
@@ -134,20 +140,7 @@ class FrameExtractor {
 
     onProgress?.call(80, 'Collecting extracted frames...');
 
-    // List the extracted frames
-    final extractedFiles = await framesDir
-        .list()
-        .where((entity) => entity is File && entity.path.endsWith('.png'))
-        .map((entity) => entity.path)
-        .toList();
-
-    extractedFiles.sort(); // Ensure consistent ordering
-
-    // Create a mapping of extracted file names to original frame indices
-    final result = <String>[];
-    for (int i = 0; i < extractedFiles.length; i++) {
-      result.add(extractedFiles[i]);
-    }
+    final result = await _renameSamples(framesDir, (k) => k * sampleStep);
 
     onProgress?.call(100, 'Extracted ${result.length} frames');
 
@@ -160,7 +153,8 @@ class FrameExtractor {
   /// [frameIndices]: List of frame indices to extract
   /// [onProgress]: Optional progress callback
   ///
-  /// Returns list of paths to extracted PNG frames
+  /// Returns paths in the order of [frameIndices], skipping frames that
+  /// could not be decoded
   Future<List<String>> extractFrames({
     required String videoPath,
     required List<int> frameIndices,
@@ -170,42 +164,163 @@ class FrameExtractor {
       return [];
     }
 
-    final info = await getVideoInfo(videoPath);
-    final framesDir = await _getFramesDirectory();
-    final extractedPaths = <String>[];
+    if (NativeExtractor.isAvailable) {
+      return _extractFramesNative(
+        videoPath: videoPath,
+        frameIndices: frameIndices,
+        onProgress: onProgress,
+      );
+    }
+
+    final framesDir = await getFramesDirectory();
+
+    // One pass selecting the frames by decoder frame number, the same
+    // numbering analysis used; seeking to index / frame rate lands on the
+    // wrong frame when timestamps don't start at zero or the rate varies
+    final wanted = frameIndices.toSet().toList()..sort();
+    final select = wanted.map((i) => 'eq(n\\,$i)').join('+');
+    final command = '-y -i "$videoPath" '
+        '-vf "select=$select" '
+        '-vsync vfr '
+        '-pix_fmt rgb24 '
+        '-start_number 0 '
+        '"${p.join(framesDir.path, 'sample_%06d.png')}"';
+
+    onProgress?.call(0, 'Extracting ${wanted.length} frames...');
+
+    final session = await FFmpegKit.execute(command);
+    final returnCode = await session.getReturnCode();
+
+    if (!ReturnCode.isSuccess(returnCode)) {
+      final logs = await session.getAllLogsAsString();
+      throw Exception('Frame extraction failed: $logs');
+    }
+
+    final paths = await _renameSamples(framesDir, (k) => wanted[k]);
+    final extracted = {for (int k = 0; k < paths.length; k++) wanted[k]: paths[k]};
+
+    onProgress?.call(100, 'Extracted ${paths.length} frames');
 
-    for (int i = 0; i < frameIndices.length; i++) {
-      final frameIndex = frameIndices[i];
-      final outputPath = p.join(framesDir.path, 'frame_${frameIndex.toString().padLeft(6, '0')}.png');
+    return [
+      for (final frameIndex in frameIndices)
+        if (extracted[frameIndex] != null) extracted[frameIndex]!,
+    ];
+  }
+
+  /// Load frames kept by the native analysis cache, decoding only the
+  /// ones that are missing
+  ///
+  /// [cacheSpoolPath]: Frame spool written by the analysis pass
+  ///
+  /// Returns frames in the order of [frameIndices] (caller must dispose),
+  /// skipping frames that could not be decoded.
+  Future<List<cv.Mat>> loadFramesWithCache({
+    required String videoPath,
+    required List<int> frameIndices,
+    required String cacheSpoolPath,
+    ProgressCallback? onProgress,
+  }) async {
+    final spools = <FrameSpool>[];
+    // Frame index -> (spool, position in spool)
+    final located = <int, (FrameSpool, int)>{};
+
+    void addSpool(String path) {
+      final spool = FrameSpool.open(path);
+      spools.add(spool);
+      final indices = spool.frameIndices;
+      for (int i = 0; i < indices.length; i++) {
+        located[indices[i]] = (spool, i);
+      }
+    }
 
-      // Calculate timestamp for this frame
-      final timestamp = frameIndex / info.frameRate;
+    try {
+      if (await File(cacheSpoolPath).exists()) {
+        addSpool(cacheSpoolPath);
+      }
 
-      // FFmpeg command to extract single frame at specific time
-      // Using -ss before -i for fast seeking
-      final command = '-y '
-          '-ss ${timestamp.toStringAsFixed(6)} '
-          '-i "$videoPath" '
-          '-vframes 1 '
-          '-pix_fmt rgb24 '
-          '"$outputPath"';
+      final missing = frameIndices.where((i) => !located.containsKey(i)).toList();
+      if (missing.isNotEmpty) {
+        final extraSpoolPath = p.join(p.dirname(cacheSpoolPath), 'extracted.psspool');
+        await _nativeExtractor.extractFramesToSpool(
+          videoPath: videoPath,
+          frameIndices: missing,
+          spoolPath: extraSpoolPath,
+          onProgress: (progress, message) => onProgress?.call((progress * 0.8).round(), message),
+        );
+        addSpool(extraSpoolPath);
+      }
 
-      final session = await FFmpegKit.execute(command);
-      final returnCode = await session.getReturnCode();
+      final frames = <cv.Mat>[];
+      for (int i = 0; i < frameIndices.length; i++) {
+        final location = located[frameIndices[i]];
+        if (location != null) {
+          frames.add(location.$1.readFrame(location.$2));
+        }
+
+        onProgress?.call(
+          80 + ((i + 1) * 20 / frameIndices.length).round(),
+          'Loading frame ${i + 1}/${frameIndices.length}',
+        );
+      }
 
-      if (ReturnCode.isSuccess(returnCode) && await File(outputPath).exists()) {
-        extractedPaths.add(outputPath);
+      return frames;
+    } finally {
+      for (final spool in spools) {
+        spool.close();
       }
+    }
+  }
 
-      onProgress?.call(
-        ((i + 1) * 100 / frameIndices.length).round(),
-        'Extracting frame ${i + 1}/${frameIndices.length}',
-      );
+  /// Extract frames with the native GOP-batched extractor
+  ///
+  /// Returns paths in the order of [frameIndices], skipping frames that
+  /// could not be decoded.
+  Future<List<String>> _extractFramesNative({
+    required String videoPath,
+    required List<int> frameIndices,
+    ProgressCallback? onProgress,
+  }) async {
+    final framesDir = await getFramesDirectory();
+
+    await _nativeExtractor.extractFrames(
+      videoPath: videoPath,
+      frameIndices: frameIndices,
+      outputDir: framesDir.path,
+      onProgress: onProgress,
+    );
+
+    final extractedPaths = <String>[];
+    for (final frameIndex in frameIndices) {
+      final path = p.join(framesDir.path, 'frame_${frameIndex.toString().padLeft(6, '0')}.png');
+      if (await File(path).exists()) {
+        extractedPaths.add(path);
+      }
     }
 
     return extractedPaths;
   }
 
+  /// Rename the FFmpeg outputs sample_<k>.png in [framesDir] to
+  /// frame_<index>.png, where [frameIndexOf] maps the output number k to
+  /// the frame's index in the video. Returns the new paths in frame order.
+  Future<List<String>> _renameSamples(Directory framesDir, int Function(int) frameIndexOf) async {
+    final samples = await framesDir
+        .list()
+        .where((entity) => entity is File && p.basename(entity.path).startsWith('sample_'))
+        .map((entity) => entity.path)
+        .toList();
+    // Zero-padded, so name order is output order
+    samples.sort();
+
+    final renamed = <String>[];
+    for (int k = 0; k < samples.length; k++) {
+      final path = p.join(framesDir.path, 'frame_${frameIndexOf(k).toString().padLeft(6, '0')}.png');
+      await File(samples[k]).rename(path);
+      renamed.add(path);
+    }
+    return renamed;
+  }
+
   /// Clean up extracted frames
   Future<void> cleanup() async {
     final tempDir = await getTemporaryDirectory();
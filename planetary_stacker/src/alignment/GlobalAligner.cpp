@@ -0,0 +1,255 @@
+#include "GlobalAligner.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "Luma.hpp"
+#include "analysis/PlanetDetector.hpp"
+
+namespace planetary {
+
+namespace {
+
+// Transform sides: small enough to stay cheap, large enough for a disk
+// filling a phone frame
+constexpr int kMinSide = 64;
+constexpr int kMaxSide = 1024;
+
+// Square side per disk diameter: room for the disk plus some drift
+constexpr double kSidePerDiameter = 1.5;
+
+// Each edge of the Tukey window tapers over this share of the side,
+// which leaves the disk (2/3 of the side) in the flat middle
+constexpr double kTaperFraction = 1.0 / 6.0;
+
+// Frames that drifted more than side / this are correlated again with
+// the square centred on the planet
+constexpr int kRecentreDivisor = 8;
+
+// The peak is refined over a (2r+1)² window around the maximum
+constexpr int kPeakRadius = 2;
+
+// Gaussian roll-off of the whitened cross-power, in cycles per pixel.
+// Whitening alone lifts the noise-only high frequencies to the same weight
+// as the planet's detail; rolling them off keeps the peak compact and
+// cuts the sub-pixel error on noisy frames by about a third.
+constexpr double kLowPassSigma = 0.2;
+
+// Keeps the cross-power normalisation finite where both spectra vanish
+constexpr float kMagnitudeFloor = 1e-12f;
+
+int nextPowerOfTwo(int n) {
+    int p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+// Tukey (tapered cosine) window of [side] samples
+std::vector<float> tukey(int side) {
+    std::vector<float> window(static_cast<size_t>(side));
+    const double taper = std::max(side * kTaperFraction, 1.0);
+    for (int i = 0; i < side; ++i) {
+        const double edge = std::min(i, side - 1 - i);
+        window[i] = edge < taper ? static_cast<float>(0.5 * (1.0 - std::cos(CV_PI * edge / taper))) : 1.0f;
+    }
+    return window;
+}
+
+// Coordinate [x] of a periodic correlation of length [n] as a signed shift
+double wrap(double x, int n) {
+    return x > n / 2 ? x - n : x;
+}
+
+} // namespace
+
+int GlobalAligner::squareSide(int diameter, const cv::Size& frame) {
+    // Never more than the square that covers the whole frame
+    const int cover = nextPowerOfTwo(std::max(frame.width, frame.height));
+    int side;
+    if (diameter > 0) {
+        side = nextPowerOfTwo(static_cast<int>(std::ceil(diameter * kSidePerDiameter)));
+    } else {
+        // No disk: the largest square inside the frame
+        side = nextPowerOfTwo(std::min(frame.width, frame.height) + 1) / 2;
+    }
+    return std::clamp(std::min(side, cover), kMinSide, kMaxSide);
+}
+
+GlobalAligner::GlobalAligner(const cv::Mat& reference) : size_(reference.size()) {
+    if (reference.empty()) {
+        throw std::invalid_argument("Empty reference frame");
+    }
+    if (reference.channels() != 1 && reference.channels() < 3) {
+        throw std::invalid_argument("Reference must be gray or BGR");
+    }
+
+    // Centre the square on the disk when there is one
+    std::vector<float> luma(static_cast<size_t>(size_.area()));
+    toFloatLuma(reference, cv::Rect(cv::Point(), size_), luma.data(), static_cast<size_t>(size_.width));
+    const auto range = std::minmax_element(luma.begin(), luma.end());
+    const float low = *range.first;
+    const float scale = *range.second > low ? 255.0f / (*range.second - low) : 0.0f;
+    cv::Mat gray(size_.height, size_.width, CV_8U);
+    for (int y = 0; y < size_.height; ++y) {
+        const float* in = luma.data() + static_cast<size_t>(y) * size_.width;
+        uint8_t* out = gray.ptr<uint8_t>(y);
+        for (int x = 0; x < size_.width; ++x) {
+            out[x] = static_cast<uint8_t>((in[x] - low) * scale + 0.5f);
+        }
+    }
+    const cv::Rect disk = PlanetDetector::detect(gray).box;
+    side_ = squareSide(std::max(disk.width, disk.height), size_);
+    const cv::Point centre = disk.area() > 0
+        ? cv::Point(disk.x + disk.width / 2, disk.y + disk.height / 2)
+        : cv::Point(size_.width / 2, size_.height / 2);
+    origin_ = cv::Point(centre.x - side_ / 2, centre.y - side_ / 2);
+    fft_ = RealFft2d::plan(side_);
+
+    const std::vector<float> taper = tukey(side_);
+    window_.resize(static_cast<size_t>(side_) * side_);
+    for (int y = 0; y < side_; ++y) {
+        for (int x = 0; x < side_; ++x) {
+            window_[static_cast<size_t>(y) * side_ + x] = taper[y] * taper[x];
+        }
+    }
+
+    const int bins = fft_->bins();
+    low_pass_.resize(static_cast<size_t>(side_) * bins);
+    for (int y = 0; y < side_; ++y) {
+        const double fy = wrap(y, side_) / side_;
+        for (int x = 0; x < bins; ++x) {
+            const double fx = static_cast<double>(x) / side_;
+            low_pass_[static_cast<size_t>(y) * bins + x] =
+                static_cast<float>(std::exp(-(fx * fx + fy * fy) / (2 * kLowPassSigma * kLowPassSigma)));
+        }
+    }
+    // Unit mean, so a perfect match still peaks near 1
+    double total = 0;
+    for (const float weight : low_pass_) {
+        total += weight;
+    }
+    const float unit = static_cast<float>(low_pass_.size() / total);
+    for (float& weight : low_pass_) {
+        weight *= unit;
+    }
+
+    std::vector<float> square(window_.size());
+    reference_.resize(static_cast<size_t>(side_) * fft_->bins());
+    transform(reference, origin_, square.data(), reference_.data(), FftWorkspace::local());
+}
+
+void GlobalAligner::transform(const cv::Mat& frame, const cv::Point& origin, float* square,
+                              Complex* spectrum, FftWorkspace& workspace) const {
+    const size_t pixels = window_.size();
+    std::fill(square, square + pixels, 0.0f);
+
+    const cv::Rect inside = cv::Rect(origin, cv::Size(side_, side_)) & cv::Rect(cv::Point(), size_);
+    if (inside.area() > 0) {
+        // Only the square is converted, however large the frame
+        float* first = square + static_cast<size_t>(inside.y - origin.y) * side_ + (inside.x - origin.x);
+        toFloatLuma(frame, inside, first, static_cast<size_t>(side_));
+
+        // Zero mean, so the window and the padding add no edge of their own
+        double sum = 0;
+        for (int y = 0; y < inside.height; ++y) {
+            const float* row = first + static_cast<size_t>(y) * side_;
+            for (int x = 0; x < inside.width; ++x) {
+                sum += row[x];
+            }
+        }
+        const float mean = static_cast<float>(sum / inside.area());
+        for (int y = 0; y < inside.height; ++y) {
+            float* row = first + static_cast<size_t>(y) * side_;
+            for (int x = 0; x < inside.width; ++x) {
+                row[x] -= mean;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < pixels; ++i) {
+        square[i] *= window_[i];
+    }
+    fft_->forward(square, spectrum, workspace);
+}
+
+GlobalAligner::Shift GlobalAligner::align(const cv::Mat& frame) const {
+    if (frame.size() != size_) {
+        throw std::invalid_argument("Frame size differs from the reference");
+    }
+    if (frame.channels() != 1 && frame.channels() < 3) {
+        throw std::invalid_argument("Frame must be gray or BGR");
+    }
+
+    FftWorkspace& workspace = FftWorkspace::local();
+    float* square = workspace.real.reserve(window_.size());
+    Complex* spectrum = workspace.spectrum.reserve(reference_.size());
+
+    transform(frame, origin_, square, spectrum, workspace);
+    Shift shift = correlate(spectrum, square, workspace);
+
+    // The planet sits at reference position - shift in this frame. Far
+    // off centre the window fades it, so look again with the square on it.
+    const double recentre = static_cast<double>(side_) / kRecentreDivisor;
+    if (std::abs(shift.dx) > recentre || std::abs(shift.dy) > recentre) {
+        const cv::Point offset(cvRound(shift.dx), cvRound(shift.dy));
+        transform(frame, origin_ - offset, square, spectrum, workspace);
+        Shift centred = correlate(spectrum, square, workspace);
+        if (centred.response >= shift.response) {
+            centred.dx += offset.x;
+            centred.dy += offset.y;
+            shift = centred;
+        }
+    }
+    return shift;
+}
+
+GlobalAligner::Shift GlobalAligner::correlate(Complex* spectrum, float* correlation,
+                                              FftWorkspace& workspace) const {
+    // Normalised cross-power spectrum R * conj(F), the reference spectrum
+    // being stored as is: only the phase difference is kept, so the
+    // inverse transform is a sharp peak at the shift moving the frame onto
+    // the reference. The low-pass weight goes in with the normalisation.
+    for (size_t i = 0; i < reference_.size(); ++i) {
+        const Complex f = spectrum[i];
+        const Complex r = reference_[i];
+        const float re = r.re * f.re + r.im * f.im;
+        const float im = r.im * f.re - r.re * f.im;
+        const float gain = low_pass_[i] / std::max(std::sqrt(re * re + im * im), kMagnitudeFloor);
+        spectrum[i] = {re * gain, im * gain};
+    }
+    fft_->inverse(spectrum, correlation, workspace);
+
+    const size_t pixels = window_.size();
+    const size_t best = static_cast<size_t>(std::max_element(correlation, correlation + pixels) - correlation);
+    const cv::Point peak(static_cast<int>(best % side_), static_cast<int>(best / side_));
+
+    // Centroid of the positive correlation around the peak, wrapping at
+    // the edges (small shifts sit in the corners)
+    double sum = 0, sum_x = 0, sum_y = 0;
+    for (int dy = -kPeakRadius; dy <= kPeakRadius; ++dy) {
+        const float* row = correlation + static_cast<size_t>((peak.y + dy + side_) % side_) * side_;
+        for (int dx = -kPeakRadius; dx <= kPeakRadius; ++dx) {
+            const float value = row[(peak.x + dx + side_) % side_];
+            if (value > 0) {
+                sum += value;
+                sum_x += value * dx;
+                sum_y += value * dy;
+            }
+        }
+    }
+
+    Shift shift;
+    if (sum > 0) {
+        shift.dx = wrap(peak.x + sum_x / sum, side_);
+        shift.dy = wrap(peak.y + sum_y / sum, side_);
+        shift.response = std::clamp(static_cast<double>(correlation[best]), 0.0, 1.0);
+    }
+    return shift;
+}
+
+} // namespace planetary
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "RealFft.hpp"
+
+namespace planetary {
+
+/// Whole-frame translation of captured frames onto one reference frame, by
+/// phase correlation.
+///
+/// Only a square around the planet is correlated: its side is a power of
+/// two sized from the disk found in the reference (about 1.5 diameters, so
+/// the disk and some drift fit), which keeps the transforms small and on
+/// fast radix-2 sizes whatever the frame size. The square is apodised with
+/// a Tukey window, flat over the disk and tapering to zero at the edges,
+/// and zero-padded where it leaves the frame. Captures with no disk in the
+/// reference (lunar or solar surface) use the centre of the frame.
+///
+/// The reference square is prepared once: float luma, mean removed,
+/// windowed, transformed and stored. Aligning a frame then costs one
+/// forward FFT, a cross-power multiply and one inverse FFT, plus a second
+/// round re-centred on the planet when the frame has drifted far enough
+/// for the window to fade it. Transforms are real-to-complex (RealFft2d)
+/// with the plan shared by every aligner of the same size, and all
+/// per-frame buffers live in the calling thread's FftWorkspace, so align()
+/// makes no heap allocations once a thread has aligned its first frame.
+/// align() is const and may run on several threads at once.
+class GlobalAligner {
+public:
+    struct Shift {
+        double dx = 0;          // Translation moving the frame onto the reference
+        double dy = 0;
+        double response = 0;    // Correlation peak strength (0-1, higher = surer)
+    };
+
+    /// Prepare [reference] (8-bit, 16-bit or float; 1, 3 or 4 channels)
+    explicit GlobalAligner(const cv::Mat& reference);
+
+    /// Shift of [frame], which must have the reference's size
+    Shift align(const cv::Mat& frame) const;
+
+    const cv::Size& size() const { return size_; }
+
+    /// Square that is correlated, in reference frame coordinates (may
+    /// extend past the frame)
+    cv::Rect region() const { return cv::Rect(origin_, cv::Size(side_, side_)); }
+
+    /// Transform side for a disk of [diameter] pixels in a frame of
+    /// [frame] size (diameter 0 = no disk found)
+    static int squareSide(int diameter, const cv::Size& frame);
+
+private:
+    // Float luma of [frame] in the square at [origin] (written to
+    // [square]), mean removed, apodised and transformed into [spectrum]
+    void transform(const cv::Mat& frame, const cv::Point& origin, float* square,
+                   Complex* spectrum, FftWorkspace& workspace) const;
+
+    // Peak of the normalised cross-power of [spectrum] with the reference;
+    // [spectrum] is overwritten and [correlation] receives the surface
+    Shift correlate(Complex* spectrum, float* correlation, FftWorkspace& workspace) const;
+
+    cv::Size size_;
+    int side_ = 0;
+    cv::Point origin_;                  // Top-left of the reference square
+    std::shared_ptr<const RealFft2d> fft_;
+    std::vector<float> window_;         // Tukey window, side_ x side_
+    std::vector<Complex> reference_;    // Reference half spectrum
+    std::vector<float> low_pass_;       // Cross-power weight per bin
+};
+
+} // namespace planetary
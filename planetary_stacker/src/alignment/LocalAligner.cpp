@@ -0,0 +1,442 @@
+#include "LocalAligner.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#include <opencv2/imgproc.hpp>
+
+#include "Luma.hpp"
+#include "pipeline/WorkStealingPool.hpp"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define PS_SIMD_X86 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PS_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace planetary {
+
+namespace {
+
+constexpr int kMinTile = 8;
+
+// Search window half-width: tile / this, within bounds. Residual seeing
+// shifts after global alignment are a few pixels.
+constexpr int kRadiusDivisor = 4;
+constexpr int kMinRadius = 2;
+constexpr int kMaxRadius = 16;
+
+// Tiles with less contrast than this share of the best tile's are not
+// alignment points: on sky or a flat limb the NCC peak is noise
+constexpr double kContrastFraction = 0.15;
+
+// Weaker NCC peaks are not trusted
+constexpr float kMinScore = 0.5f;
+
+// Points further than this (pixels) from the median of their neighbours
+// are rejected; seeing bends the image smoothly between adjacent tiles
+constexpr float kOutlierDistance = 1.5f;
+
+// Neighbours that must agree before a point can be judged an outlier
+constexpr int kMinNeighbours = 2;
+
+// Sum over a [side] x [side] tile of [tile] (rows [side] floats apart)
+// times [patch] (rows [stride] floats apart)
+float correlateTile(const float* tile, const float* patch, int side, size_t stride) {
+    float total = 0;
+#if defined(PS_SIMD_NEON)
+    float32x4_t acc = vdupq_n_f32(0);
+#elif defined(PS_SIMD_X86)
+    __m128 acc = _mm_setzero_ps();
+#endif
+    for (int y = 0; y < side; ++y, tile += side, patch += stride) {
+        int x = 0;
+#if defined(PS_SIMD_NEON)
+        for (; x + 4 <= side; x += 4) {
+            acc = vmlaq_f32(acc, vld1q_f32(tile + x), vld1q_f32(patch + x));
+        }
+#elif defined(PS_SIMD_X86)
+        for (; x + 4 <= side; x += 4) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(tile + x), _mm_loadu_ps(patch + x)));
+        }
+#endif
+        for (; x < side; ++x) {
+            total += tile[x] * patch[x];
+        }
+    }
+#if defined(PS_SIMD_NEON) || defined(PS_SIMD_X86)
+    float lanes[4];
+#if defined(PS_SIMD_NEON)
+    vst1q_f32(lanes, acc);
+#else
+    _mm_storeu_ps(lanes, acc);
+#endif
+    total += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    return total;
+}
+
+// Offset of a parabola's vertex through (-1, a), (0, b), (1, c)
+float vertex(float a, float b, float c) {
+    const float curvature = a - 2 * b + c;
+    if (curvature >= 0) {
+        return 0;
+    }
+    return std::clamp(0.5f * (a - c) / curvature, -0.5f, 0.5f);
+}
+
+// Bracketing nodes and weight of position [position] on an axis of
+// [count] nodes at [origin] + k * [spacing], clamped to the outer nodes
+struct Lerp {
+    int lo;
+    int hi;
+    float t;
+};
+
+Lerp lerpAt(float position, float origin, int spacing, int count) {
+    const float g = std::clamp((position - origin) / spacing, 0.0f, static_cast<float>(count - 1));
+    const int lo = std::min(static_cast<int>(g), count - 1);
+    return {lo, std::min(lo + 1, count - 1), g - lo};
+}
+
+inline cv::Point2f mix(const cv::Point2f& a, const cv::Point2f& b, float t) {
+    return cv::Point2f(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t);
+}
+
+float median(std::array<float, 8>& values, int count) {
+    std::nth_element(values.begin(), values.begin() + count / 2, values.begin() + count);
+    return values[count / 2];
+}
+
+// Drop known nodes that disagree with the median of their known
+// neighbours; judged against the original set so order doesn't matter
+void rejectOutliers(const cv::Size& nodes, const std::vector<cv::Point2f>& shifts,
+                    std::vector<uint8_t>& known) {
+    const std::vector<uint8_t> before = known;
+    for (int j = 0; j < nodes.height; ++j) {
+        for (int i = 0; i < nodes.width; ++i) {
+            const int node = j * nodes.width + i;
+            if (!before[node]) {
+                continue;
+            }
+            std::array<float, 8> xs, ys;
+            int count = 0;
+            for (int dj = -1; dj <= 1; ++dj) {
+                for (int di = -1; di <= 1; ++di) {
+                    const int ni = i + di, nj = j + dj;
+                    if ((di == 0 && dj == 0) || ni < 0 || nj < 0 || ni >= nodes.width || nj >= nodes.height) {
+                        continue;
+                    }
+                    const int neighbour = nj * nodes.width + ni;
+                    if (before[neighbour]) {
+                        xs[count] = shifts[neighbour].x;
+                        ys[count] = shifts[neighbour].y;
+                        ++count;
+                    }
+                }
+            }
+            if (count >= kMinNeighbours) {
+                const float dx = shifts[node].x - median(xs, count);
+                const float dy = shifts[node].y - median(ys, count);
+                if (std::hypot(dx, dy) > kOutlierDistance) {
+                    known[node] = 0;
+                }
+            }
+        }
+    }
+}
+
+// Give every unknown node the mean of its known neighbours, growing out
+// from the known ones a ring at a time; [fallback] if none is known
+void fillUnknown(const cv::Size& nodes, std::vector<cv::Point2f>& shifts, std::vector<uint8_t>& known,
+                 const cv::Point2f& fallback) {
+    if (std::none_of(known.begin(), known.end(), [](uint8_t k) { return k != 0; })) {
+        std::fill(shifts.begin(), shifts.end(), fallback);
+        return;
+    }
+
+    bool missing = true;
+    while (missing) {
+        missing = false;
+        const std::vector<uint8_t> before = known;
+        for (int j = 0; j < nodes.height; ++j) {
+            for (int i = 0; i < nodes.width; ++i) {
+                const int node = j * nodes.width + i;
+                if (before[node]) {
+                    continue;
+                }
+                cv::Point2f sum(0, 0);
+                int count = 0;
+                for (int dj = -1; dj <= 1; ++dj) {
+                    for (int di = -1; di <= 1; ++di) {
+                        const int ni = i + di, nj = j + dj;
+                        if (ni < 0 || nj < 0 || ni >= nodes.width || nj >= nodes.height) {
+                            continue;
+                        }
+                        const int neighbour = nj * nodes.width + ni;
+                        if (before[neighbour]) {
+                            sum.x += shifts[neighbour].x;
+                            sum.y += shifts[neighbour].y;
+                            ++count;
+                        }
+                    }
+                }
+                if (count > 0) {
+                    shifts[node] = cv::Point2f(sum.x / count, sum.y / count);
+                    known[node] = 1;
+                } else {
+                    missing = true;
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+cv::Point2f WarpGrid::at(float x, float y) const {
+    if (empty()) {
+        return cv::Point2f(0, 0);
+    }
+    const Lerp gx = lerpAt(x, origin.x, spacing, nodes.width);
+    const Lerp gy = lerpAt(y, origin.y, spacing, nodes.height);
+    const cv::Point2f* lo = shifts.data() + static_cast<size_t>(gy.lo) * nodes.width;
+    const cv::Point2f* hi = shifts.data() + static_cast<size_t>(gy.hi) * nodes.width;
+    return mix(mix(lo[gx.lo], lo[gx.hi], gx.t), mix(hi[gx.lo], hi[gx.hi], gx.t), gy.t);
+}
+
+void WarpGrid::toMaps(const cv::Size& size, cv::Mat& map_x, cv::Mat& map_y) const {
+    map_x.create(size, CV_32FC1);
+    map_y.create(size, CV_32FC1);
+
+    // Horizontal brackets are the same on every row
+    std::vector<Lerp> columns(static_cast<size_t>(size.width));
+    for (int x = 0; x < size.width; ++x) {
+        columns[x] = empty() ? Lerp{0, 0, 0} : lerpAt(static_cast<float>(x), origin.x, spacing, nodes.width);
+    }
+
+    std::vector<cv::Point2f> row(empty() ? 1 : static_cast<size_t>(nodes.width), cv::Point2f(0, 0));
+    for (int y = 0; y < size.height; ++y) {
+        // Node shifts interpolated to this row, then along it
+        if (!empty()) {
+            const Lerp gy = lerpAt(static_cast<float>(y), origin.y, spacing, nodes.height);
+            const cv::Point2f* lo = shifts.data() + static_cast<size_t>(gy.lo) * nodes.width;
+            const cv::Point2f* hi = shifts.data() + static_cast<size_t>(gy.hi) * nodes.width;
+            for (int i = 0; i < nodes.width; ++i) {
+                row[i] = mix(lo[i], hi[i], gy.t);
+            }
+        }
+        float* xs = map_x.ptr<float>(y);
+        float* ys = map_y.ptr<float>(y);
+        for (int x = 0; x < size.width; ++x) {
+            const Lerp& gx = columns[x];
+            const cv::Point2f shift = mix(row[gx.lo], row[gx.hi], gx.t);
+            xs[x] = static_cast<float>(x) - shift.x;
+            ys[x] = static_cast<float>(y) - shift.y;
+        }
+    }
+}
+
+LocalAligner::LocalAligner(const cv::Mat& reference, const cv::Rect& region, int tile_size)
+    : size_(reference.size()), tile_(tile_size) {
+    if (reference.empty()) {
+        throw std::invalid_argument("Empty reference frame");
+    }
+    if (tile_size < kMinTile) {
+        throw std::invalid_argument("Tile size too small for local alignment");
+    }
+    radius_ = std::clamp(tile_ / kRadiusDivisor, kMinRadius, kMaxRadius);
+
+    // Tiles leave room for the search window inside the frame
+    const cv::Rect area = region & cv::Rect(radius_, radius_, size_.width - 2 * radius_,
+                                            size_.height - 2 * radius_);
+    const int cols = std::max(area.width, 0) / tile_;
+    const int rows = std::max(area.height, 0) / tile_;
+    grid_.spacing = tile_;
+    if (cols == 0 || rows == 0) {
+        return;
+    }
+
+    // Centre the tiling on the area; nodes are the tile centres
+    const cv::Point first(area.x + (area.width - cols * tile_) / 2, area.y + (area.height - rows * tile_) / 2);
+    grid_.origin = cv::Point2f(first.x + tile_ / 2.0f - 0.5f, first.y + tile_ / 2.0f - 0.5f);
+    grid_.nodes = cv::Size(cols, rows);
+
+    // Reference tiles, zero-mean and unit norm, with their contrast
+    const size_t pixels = static_cast<size_t>(tile_) * tile_;
+    std::vector<float> tiles(static_cast<size_t>(grid_.nodes.area()) * pixels);
+    std::vector<double> contrast(static_cast<size_t>(grid_.nodes.area()));
+    for (int j = 0; j < rows; ++j) {
+        for (int i = 0; i < cols; ++i) {
+            const int node = j * cols + i;
+            float* tile = tiles.data() + node * pixels;
+            toFloatLuma(reference, cv::Rect(first.x + i * tile_, first.y + j * tile_, tile_, tile_), tile,
+                        static_cast<size_t>(tile_));
+
+            double sum = 0;
+            for (size_t p = 0; p < pixels; ++p) {
+                sum += tile[p];
+            }
+            const float mean = static_cast<float>(sum / pixels);
+            double energy = 0;
+            for (size_t p = 0; p < pixels; ++p) {
+                tile[p] -= mean;
+                energy += static_cast<double>(tile[p]) * tile[p];
+            }
+            const float norm = energy > 0 ? static_cast<float>(1.0 / std::sqrt(energy)) : 0.0f;
+            for (size_t p = 0; p < pixels; ++p) {
+                tile[p] *= norm;
+            }
+            contrast[node] = std::sqrt(energy / pixels);
+        }
+    }
+
+    const double best = *std::max_element(contrast.begin(), contrast.end());
+    for (int node = 0; node < grid_.nodes.area(); ++node) {
+        if (best > 0 && contrast[node] >= kContrastFraction * best) {
+            points_.push_back(node);
+            corners_.emplace_back(first.x + (node % cols) * tile_, first.y + (node / cols) * tile_);
+            tiles_.insert(tiles_.end(), tiles.begin() + node * pixels, tiles.begin() + (node + 1) * pixels);
+        }
+    }
+
+    pool_ = std::make_unique<WorkStealingPool>();
+    const size_t side = static_cast<size_t>(tile_ + 2 * radius_);
+    const size_t offsets = static_cast<size_t>(2 * radius_ + 1);
+    scratch_.resize(static_cast<size_t>(pool_->size()));
+    for (Scratch& scratch : scratch_) {
+        scratch.patch.resize(side * side);
+        scratch.sum.resize((side + 1) * (side + 1));
+        scratch.sum_sq.resize((side + 1) * (side + 1));
+        scratch.scores.resize(offsets * offsets);
+    }
+}
+
+LocalAligner::~LocalAligner() = default;
+
+WarpGrid LocalAligner::align(const cv::Mat& frame, const GlobalAligner::Shift& global) const {
+    if (frame.size() != size_) {
+        throw std::invalid_argument("Frame size differs from the reference");
+    }
+    if (frame.channels() != 1 && frame.channels() < 3) {
+        throw std::invalid_argument("Frame must be gray or BGR");
+    }
+
+    WarpGrid grid = grid_;
+    const cv::Point2f fallback(static_cast<float>(global.dx), static_cast<float>(global.dy));
+    grid.shifts.assign(static_cast<size_t>(grid.nodes.area()), fallback);
+    if (grid.empty()) {
+        return grid;
+    }
+
+    // Each point is looked for where the global shift puts it
+    const cv::Point rounded(cvRound(global.dx), cvRound(global.dy));
+    std::vector<Match> matches(points_.size());
+    if (!points_.empty()) {
+        pool_->parallelFor(static_cast<int64_t>(points_.size()), [&](int64_t point, int worker) {
+            matches[point] = search(frame, static_cast<size_t>(point), corners_[point] - rounded, rounded,
+                                    scratch_[worker]);
+        });
+    }
+
+    std::vector<uint8_t> known(grid.shifts.size(), 0);
+    for (size_t point = 0; point < points_.size(); ++point) {
+        if (matches[point].valid) {
+            grid.shifts[points_[point]] = matches[point].shift;
+            known[points_[point]] = 1;
+        }
+    }
+    rejectOutliers(grid.nodes, grid.shifts, known);
+    fillUnknown(grid.nodes, grid.shifts, known, fallback);
+    return grid;
+}
+
+LocalAligner::Match LocalAligner::search(const cv::Mat& frame, size_t point, const cv::Point& corner,
+                                         const cv::Point& rounded, Scratch& scratch) const {
+    Match match;
+    const int side = tile_ + 2 * radius_;
+    const cv::Rect window(corner.x - radius_, corner.y - radius_, side, side);
+    if ((window & cv::Rect(cv::Point(), size_)) != window) {
+        return match;   // Pushed off the frame by the global shift
+    }
+
+    float* patch = scratch.patch.data();
+    toFloatLuma(frame, window, patch, static_cast<size_t>(side));
+
+    // Integral images give each offset's mean and energy in O(1)
+    const size_t stride = static_cast<size_t>(side) + 1;
+    double* sum = scratch.sum.data();
+    double* sum_sq = scratch.sum_sq.data();
+    std::fill(sum, sum + stride, 0.0);
+    std::fill(sum_sq, sum_sq + stride, 0.0);
+    for (int y = 0; y < side; ++y) {
+        const float* row = patch + static_cast<size_t>(y) * side;
+        double run = 0, run_sq = 0;
+        double* s = sum + (y + 1) * stride;
+        double* q = sum_sq + (y + 1) * stride;
+        s[0] = q[0] = 0;
+        for (int x = 0; x < side; ++x) {
+            run += row[x];
+            run_sq += static_cast<double>(row[x]) * row[x];
+            s[x + 1] = s[x + 1 - stride] + run;
+            q[x + 1] = q[x + 1 - stride] + run_sq;
+        }
+    }
+
+    // NCC at every offset: the reference tile is zero-mean and unit norm,
+    // so only the frame side needs normalising
+    const float* tile = tiles_.data() + point * static_cast<size_t>(tile_) * tile_;
+    const int offsets = 2 * radius_ + 1;
+    const double pixels = static_cast<double>(tile_) * tile_;
+    float* scores = scratch.scores.data();
+    int best = 0;
+    for (int v = 0; v < offsets; ++v) {
+        for (int u = 0; u < offsets; ++u) {
+            const auto box = [&](const double* table) {
+                return table[(v + tile_) * stride + u + tile_] - table[v * stride + u + tile_] -
+                       table[(v + tile_) * stride + u] + table[v * stride + u];
+            };
+            const double s = box(sum);
+            const double energy = box(sum_sq) - s * s / pixels;
+            float score = 0;
+            if (energy > 0) {
+                const float dot = correlateTile(tile, patch + static_cast<size_t>(v) * side + u, tile_,
+                                                static_cast<size_t>(side));
+                score = static_cast<float>(dot / std::sqrt(energy));
+            }
+            scores[v * offsets + u] = score;
+            if (score > scores[best]) {
+                best = v * offsets + u;
+            }
+        }
+    }
+
+    // A peak on the window's edge may be the slope of one outside it
+    const int u = best % offsets, v = best / offsets;
+    if (scores[best] < kMinScore || u == 0 || v == 0 || u == offsets - 1 || v == offsets - 1) {
+        return match;
+    }
+    const float fx = vertex(scores[best - 1], scores[best], scores[best + 1]);
+    const float fy = vertex(scores[best - offsets], scores[best], scores[best + offsets]);
+
+    // The tile sits at corner + offset in the frame, so moving the frame
+    // onto the reference takes the predicted shift less the offset
+    match.shift = cv::Point2f(rounded.x - (u - radius_ + fx), rounded.y - (v - radius_ + fy));
+    match.valid = true;
+    return match;
+}
+
+void warpFrame(const cv::Mat& frame, const WarpGrid& grid, cv::Mat& warped) {
+    cv::Mat map_x, map_y;
+    grid.toMaps(frame.size(), map_x, map_y);
+    cv::remap(frame, warped, map_x, map_y, cv::INTER_LINEAR, cv::BORDER_REFLECT);
+}
+
+} // namespace planetary
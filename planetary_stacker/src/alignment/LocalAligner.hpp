@@ -0,0 +1,98 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "GlobalAligner.hpp"
+
+namespace planetary {
+
+class WorkStealingPool;
+
+/// Shifts on a regular grid of nodes, interpolated bilinearly between
+/// them; beyond the outer nodes the nearest node's shift holds.
+struct WarpGrid {
+    cv::Point2f origin;                 // Pixel position of node (0, 0)
+    int spacing = 0;                    // Pixels between neighbouring nodes
+    cv::Size nodes;                     // Columns x rows (empty = no grid)
+    std::vector<cv::Point2f> shifts;    // Row-major, each moving the frame onto the reference
+
+    bool empty() const { return nodes.area() == 0; }
+
+    /// Shift at pixel ([x], [y])
+    cv::Point2f at(float x, float y) const;
+
+    /// Source coordinates for cv::remap: each pixel of the aligned image
+    /// reads the frame at its own position minus the shift there
+    void toMaps(const cv::Size& size, cv::Mat& map_x, cv::Mat& map_y) const;
+};
+
+/// Local (multi-point) alignment: seeing bends different parts of the
+/// disk by different amounts, which one whole-frame shift can't undo.
+///
+/// The square GlobalAligner correlates is tiled into alignment points of
+/// [tile size] pixels; tiles without enough contrast (sky, featureless
+/// limb) are left out. Each point's reference tile is stored zero-mean and
+/// normalised, so aligning a frame is one normalised cross-correlation
+/// (NCC) search per point over a window of +-tile/4 pixels around where
+/// the global shift puts it, refined to sub-pixel by a parabola through
+/// the peak and its neighbours. Points whose peak is weak, on the edge of
+/// the window or out of line with their neighbours are rejected and
+/// filled in from the points around them, so the grid always holds a
+/// smooth field. The NCC inner loop is SSE2/NEON and the points are
+/// spread over a WorkStealingPool.
+class LocalAligner {
+public:
+    /// Alignment points on [region] of [reference] (same formats as
+    /// GlobalAligner), [tile_size] pixels apart (at least 8)
+    LocalAligner(const cv::Mat& reference, const cv::Rect& region, int tile_size);
+    ~LocalAligner();
+
+    /// Node shifts of [frame] given its [global] shift. May be called from
+    /// several threads; their searches take turns on the pool.
+    WarpGrid align(const cv::Mat& frame, const GlobalAligner::Shift& global) const;
+
+    /// Grid geometry (shifts left empty)
+    const WarpGrid& grid() const { return grid_; }
+
+    /// Number of nodes that are alignment points
+    int pointCount() const { return static_cast<int>(points_.size()); }
+
+private:
+    struct Match {
+        cv::Point2f shift;
+        bool valid = false;
+    };
+
+    // Per-worker buffers, sized once for the tile and search window
+    struct Scratch {
+        std::vector<float> patch;       // Frame luma around the point
+        std::vector<double> sum;        // Integral image of [patch]
+        std::vector<double> sum_sq;     // ... and of its squares
+        std::vector<float> scores;      // NCC per offset
+    };
+
+    // NCC search for alignment point [point] around [corner] in [frame];
+    // [rounded] is the global shift the corner was predicted with
+    Match search(const cv::Mat& frame, size_t point, const cv::Point& corner,
+                 const cv::Point& rounded, Scratch& scratch) const;
+
+    cv::Size size_;
+    int tile_ = 0;
+    int radius_ = 0;                        // Search window half-width
+    WarpGrid grid_;
+    std::vector<cv::Point> corners_;        // Reference tile top-left of each alignment point
+    std::vector<int> points_;               // Node index of each alignment point
+    std::vector<float> tiles_;              // Normalised reference tiles, tile² each
+    std::unique_ptr<WorkStealingPool> pool_;
+    mutable std::vector<Scratch> scratch_;  // One per pool worker
+};
+
+/// [frame] resampled through [grid] into [warped] (bilinear, reflected
+/// borders); a [warped] that already has the frame's size and type is
+/// written in place
+void warpFrame(const cv::Mat& frame, const WarpGrid& grid, cv::Mat& warped);
+
+} // namespace planetary
@@ -0,0 +1,47 @@
+#include "Luma.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+
+namespace planetary {
+
+namespace {
+
+// Luma of [count] pixels of [channels] interleaved BGR(A) or gray samples
+template <typename T>
+void lumaRow(const T* src, int channels, int count, float* dst) {
+    if (channels == 1) {
+        for (int x = 0; x < count; ++x) {
+            dst[x] = static_cast<float>(src[x]);
+        }
+        return;
+    }
+    for (int x = 0; x < count; ++x, src += channels) {
+        dst[x] = 0.114f * static_cast<float>(src[0]) + 0.587f * static_cast<float>(src[1]) +
+                 0.299f * static_cast<float>(src[2]);
+    }
+}
+
+} // namespace
+
+void toFloatLuma(const cv::Mat& frame, const cv::Rect& rect, float* dst, size_t stride) {
+    const int channels = frame.channels();
+    for (int y = 0; y < rect.height; ++y, dst += stride) {
+        const int row = rect.y + y;
+        switch (frame.depth()) {
+        case CV_8U:
+            lumaRow(frame.ptr<uint8_t>(row) + rect.x * channels, channels, rect.width, dst);
+            break;
+        case CV_16U:
+            lumaRow(frame.ptr<uint16_t>(row) + rect.x * channels, channels, rect.width, dst);
+            break;
+        case CV_32F:
+            lumaRow(frame.ptr<float>(row) + rect.x * channels, channels, rect.width, dst);
+            break;
+        default:
+            throw std::invalid_argument("Unsupported frame depth for alignment");
+        }
+    }
+}
+
+} // namespace planetary
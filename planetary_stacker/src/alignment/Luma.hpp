@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+#include <opencv2/core.hpp>
+
+namespace planetary {
+
+/// Float luma of [rect] of [frame] (8-bit, 16-bit or float; gray or
+/// BGR(A)) into rows [stride] floats apart at [dst], in the frame's own
+/// value range. Reads only the pixels inside [rect], so aligners can
+/// convert the part of a large frame they use without an intermediate
+/// cv::Mat. Throws std::invalid_argument for other depths.
+void toFloatLuma(const cv::Mat& frame, const cv::Rect& rect, float* dst, size_t stride);
+
+} // namespace planetary
@@ -0,0 +1,188 @@
+#include "RealFft.hpp"
+
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace planetary {
+
+namespace {
+
+constexpr double kTwoPi = 6.283185307179586476925286766559;
+
+bool isPowerOfTwo(int n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+int checkedSize(int size) {
+    if (!isPowerOfTwo(size) || size < 4) {
+        throw std::invalid_argument("FFT size must be a power of two of at least 4: " + std::to_string(size));
+    }
+    return size;
+}
+
+// exp(-2 pi i k / n) for k in [0, count), computed in double precision
+std::vector<Complex> roots(int n, int count) {
+    std::vector<Complex> out(static_cast<size_t>(count));
+    for (int k = 0; k < count; ++k) {
+        const double angle = -kTwoPi * k / n;
+        out[k] = {static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle))};
+    }
+    return out;
+}
+
+inline Complex operator+(Complex a, Complex b) { return {a.re + b.re, a.im + b.im}; }
+inline Complex operator-(Complex a, Complex b) { return {a.re - b.re, a.im - b.im}; }
+inline Complex operator*(Complex a, Complex b) {
+    return {a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re};
+}
+inline Complex conj(Complex a) { return {a.re, -a.im}; }
+
+} // namespace
+
+FftWorkspace& FftWorkspace::local() {
+    thread_local FftWorkspace workspace;
+    return workspace;
+}
+
+std::shared_ptr<const RealFft2d> RealFft2d::plan(int size) {
+    static std::mutex mutex;
+    static std::map<int, std::shared_ptr<const RealFft2d>> plans;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& entry = plans[size];
+    if (!entry) {
+        entry = std::make_shared<const RealFft2d>(size);
+    }
+    return entry;
+}
+
+RealFft2d::RealFft2d(int size)
+    : size_(checkedSize(size)),
+      rows_(size / 2),
+      columns_(size),
+      untangle_(roots(size, size / 2 + 1)) {}
+
+RealFft2d::ComplexFft::ComplexFft(int size) : size_(size) {
+    int bits = 0;
+    while ((1 << bits) < size) {
+        ++bits;
+    }
+    reversed_.resize(static_cast<size_t>(size));
+    for (int i = 0; i < size; ++i) {
+        int r = 0;
+        for (int b = 0; b < bits; ++b) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        reversed_[i] = r;
+    }
+    twiddles_ = roots(size, size / 2);
+}
+
+void RealFft2d::ComplexFft::transform(Complex* data, bool inverse) const {
+    for (int i = 0; i < size_; ++i) {
+        const int j = reversed_[i];
+        if (i < j) {
+            std::swap(data[i], data[j]);
+        }
+    }
+
+    for (int length = 2; length <= size_; length <<= 1) {
+        const int half = length / 2;
+        const int stride = size_ / length;
+        for (int start = 0; start < size_; start += length) {
+            Complex* a = data + start;
+            Complex* b = a + half;
+            for (int k = 0; k < half; ++k) {
+                const Complex w = inverse ? conj(twiddles_[k * stride]) : twiddles_[k * stride];
+                const Complex t = b[k] * w;
+                b[k] = a[k] - t;
+                a[k] = a[k] + t;
+            }
+        }
+    }
+}
+
+void RealFft2d::forward(const float* input, Complex* spectrum, FftWorkspace& workspace) const {
+    const int half = size_ / 2;
+    const int bins = this->bins();
+    Complex* line = workspace.line.reserve(static_cast<size_t>(size_));
+
+    // Rows: the even and odd samples as one complex signal of half the
+    // length, untangled into the first half (plus Nyquist) of the row's
+    // spectrum
+    for (int y = 0; y < size_; ++y) {
+        const float* row = input + static_cast<size_t>(y) * size_;
+        for (int k = 0; k < half; ++k) {
+            line[k] = {row[2 * k], row[2 * k + 1]};
+        }
+        rows_.transform(line, false);
+
+        Complex* out = spectrum + static_cast<size_t>(y) * bins;
+        for (int k = 0; k <= half; ++k) {
+            const Complex z = line[k % half];
+            const Complex mirror = conj(line[(half - k) % half]);
+            const Complex even = {0.5f * (z.re + mirror.re), 0.5f * (z.im + mirror.im)};
+            // (z - mirror) / 2i
+            const Complex odd = {0.5f * (z.im - mirror.im), -0.5f * (z.re - mirror.re)};
+            out[k] = even + untangle_[k] * odd;
+        }
+    }
+
+    // Columns of the half spectrum, one at a time through the line buffer
+    for (int x = 0; x < bins; ++x) {
+        for (int y = 0; y < size_; ++y) {
+            line[y] = spectrum[static_cast<size_t>(y) * bins + x];
+        }
+        columns_.transform(line, false);
+        for (int y = 0; y < size_; ++y) {
+            spectrum[static_cast<size_t>(y) * bins + x] = line[y];
+        }
+    }
+}
+
+void RealFft2d::inverse(Complex* spectrum, float* output, FftWorkspace& workspace) const {
+    const int half = size_ / 2;
+    const int bins = this->bins();
+    Complex* line = workspace.line.reserve(static_cast<size_t>(size_));
+
+    for (int x = 0; x < bins; ++x) {
+        for (int y = 0; y < size_; ++y) {
+            line[y] = spectrum[static_cast<size_t>(y) * bins + x];
+        }
+        columns_.transform(line, true);
+        for (int y = 0; y < size_; ++y) {
+            spectrum[static_cast<size_t>(y) * bins + x] = line[y];
+        }
+    }
+
+    // Rows: re-tangle the even and odd sample spectra into one complex
+    // signal, whose inverse holds the even samples in its real part and
+    // the odd ones in its imaginary part. The two unscaled passes scale
+    // by half * size_.
+    const float scale = 1.0f / (static_cast<float>(half) * static_cast<float>(size_));
+    for (int y = 0; y < size_; ++y) {
+        const Complex* in = spectrum + static_cast<size_t>(y) * bins;
+        for (int k = 0; k < half; ++k) {
+            const Complex a = in[k];
+            const Complex mirror = conj(in[half - k]);
+            const Complex even = {0.5f * (a.re + mirror.re), 0.5f * (a.im + mirror.im)};
+            const Complex odd = Complex{0.5f * (a.re - mirror.re), 0.5f * (a.im - mirror.im)} *
+                                conj(untangle_[k]);
+            // even + i * odd
+            line[k] = {even.re - odd.im, even.im + odd.re};
+        }
+        rows_.transform(line, true);
+
+        float* row = output + static_cast<size_t>(y) * size_;
+        for (int k = 0; k < half; ++k) {
+            row[2 * k] = line[k].re * scale;
+            row[2 * k + 1] = line[k].im * scale;
+        }
+    }
+}
+
+} // namespace planetary
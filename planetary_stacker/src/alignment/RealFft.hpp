@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace planetary {
+
+/// Single-precision complex value, laid out as (re, im) like
+/// std::complex<float> and CV_32FC2, without the library's NaN-checking
+/// multiply
+struct Complex {
+    float re;
+    float im;
+};
+
+/// Uninitialised, 64-byte aligned array that only ever grows, for scratch
+/// memory reused from one frame to the next. Holds trivial types only.
+template <typename T>
+class AlignedBuffer {
+public:
+    static constexpr size_t kAlignment = 64;
+
+    AlignedBuffer() = default;
+    ~AlignedBuffer() { release(); }
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    /// Room for at least [count] elements; contents are lost when it grows
+    T* reserve(size_t count) {
+        if (count > capacity_) {
+            release();
+            data_ = static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(kAlignment)));
+            capacity_ = count;
+        }
+        return data_;
+    }
+
+    T* data() const { return data_; }
+
+private:
+    void release() {
+        if (data_ != nullptr) {
+            ::operator delete(data_, std::align_val_t(kAlignment));
+            data_ = nullptr;
+            capacity_ = 0;
+        }
+    }
+
+    T* data_ = nullptr;
+    size_t capacity_ = 0;
+};
+
+/// Per-thread scratch for transforms and whatever the caller keeps next
+/// to them. Buffers grow to the largest size a thread has needed and are
+/// reused, so steady-state transforms make no heap allocations.
+struct FftWorkspace {
+    AlignedBuffer<float> real;          // Spatial-domain image
+    AlignedBuffer<Complex> spectrum;    // Half spectrum of [real]
+    AlignedBuffer<Complex> line;        // One row or column in flight
+
+    /// The calling thread's workspace
+    static FftWorkspace& local();
+};
+
+/// 2-D FFT of real [size] x [size] images, [size] a power of two.
+///
+/// Rows are transformed as half-length complex FFTs of their even/odd
+/// samples and untangled into [size]/2 + 1 bins (the other half of a real
+/// signal's spectrum is redundant), then the columns of that half
+/// spectrum are transformed in place. Iterative radix-2 throughout, with
+/// bit-reversal tables and twiddles computed once per size: plan() hands
+/// out one shared, immutable plan per size, which any number of threads
+/// may use at once, each with its own FftWorkspace.
+///
+/// Spectra are [size] rows of bins() values, row-major.
+class RealFft2d {
+public:
+    /// The shared plan for [size] (a power of two, at least 4), created on
+    /// first use. Throws std::invalid_argument for other sizes.
+    static std::shared_ptr<const RealFft2d> plan(int size);
+
+    explicit RealFft2d(int size);
+
+    int size() const { return size_; }
+
+    /// Complex values per spectrum row
+    int bins() const { return size_ / 2 + 1; }
+
+    /// Transform [input] (size² values, row-major) into [spectrum]
+    void forward(const float* input, Complex* spectrum, FftWorkspace& workspace) const;
+
+    /// Inverse of forward(), scaled by 1/size² so that inverse(forward(x))
+    /// is x. Overwrites [spectrum].
+    void inverse(Complex* spectrum, float* output, FftWorkspace& workspace) const;
+
+private:
+    // In-place complex FFT of one power-of-two length
+    class ComplexFft {
+    public:
+        explicit ComplexFft(int size);
+        void transform(Complex* data, bool inverse) const;
+
+    private:
+        int size_;
+        std::vector<int> reversed_;     // Bit-reversal permutation
+        std::vector<Complex> twiddles_; // exp(-2 pi i k / size_), k < size_ / 2
+    };
+
+    int size_;
+    ComplexFft rows_;               // size_ / 2 points, on packed row pairs
+    ComplexFft columns_;            // size_ points
+    std::vector<Complex> untangle_; // exp(-2 pi i k / size_), k <= size_ / 2
+};
+
+} // namespace planetary
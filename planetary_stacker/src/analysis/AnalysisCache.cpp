@@ -0,0 +1,243 @@
+#include "AnalysisCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+namespace planetary {
+
+namespace {
+
+constexpr char kMagic[4] = {'P', 'S', 'S', 'C'};
+// Bump when the layout or anything that changes the scores does
+constexpr uint32_t kVersion = 3;
+
+// Bytes hashed at each of the start, middle and end of the video
+constexpr uint64_t kSampleBytes = uint64_t(1) << 20;
+
+constexpr uint64_t kFnvOffset = 14695981039346656037ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+struct SidecarHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t config_key;
+    uint64_t content_hash;
+    uint64_t video_size;
+    int64_t total_frames;
+    double fps;
+    int32_t width;
+    int32_t height;
+    uint64_t count;
+    int32_t tile_size;
+    int32_t tile_cols;
+    int32_t tile_rows;
+    uint8_t reserved[20];
+};
+
+struct SidecarRecord {
+    int64_t index;
+    double timestamp;
+    double score;
+    double raw_score;
+    int32_t roi_x;
+    int32_t roi_y;
+    int32_t roi_width;
+    int32_t roi_height;
+    double gradient_energy;
+    double high_frequency_ratio;
+};
+
+static_assert(sizeof(SidecarHeader) == 96, "sidecar header must be 96 bytes");
+static_assert(sizeof(SidecarRecord) == 64, "sidecar record must be 64 bytes");
+
+// FNV-1a over 8-byte words (bytes for the tail); only has to tell
+// captures apart, not resist anyone
+uint64_t mix(uint64_t hash, const uint8_t* data, size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * kFnvPrime;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ data[i]) * kFnvPrime;
+    }
+    return hash;
+}
+
+template <typename T>
+uint64_t mixValue(uint64_t hash, const T& value) {
+    return mix(hash, reinterpret_cast<const uint8_t*>(&value), sizeof(value));
+}
+
+} // namespace
+
+uint64_t AnalysisCache::configKey(const FrameAnalyzer::Options& options, size_t segment_count) {
+    uint64_t key = kFnvOffset;
+    key = mixValue(key, static_cast<int32_t>(std::max(options.sample_step, 1)));
+    key = mixValue(key, static_cast<int32_t>(options.luma_only));
+    key = mixValue(key, static_cast<int32_t>(std::max(options.downscale, 1)));
+    key = mixValue(key, static_cast<int32_t>(options.fast_decode));
+    key = mixValue(key, static_cast<int32_t>(options.track_planet));
+    if (options.track_planet) {
+        key = mixValue(key, static_cast<int32_t>(options.redetect_interval));
+        key = mixValue(key, options.roi_margin);
+        // Each decoder segment starts its own tracker
+        key = mixValue(key, static_cast<uint64_t>(segment_count));
+    }
+    key = mixValue(key, static_cast<int32_t>(std::max(options.tile_size, 0)));
+    // Sets the order scores and tile rows are stored in
+    key = mixValue(key, static_cast<uint64_t>(options.rank_count));
+    if (options.rescore_count > 0) {
+        key = mixValue(key, static_cast<uint64_t>(options.rescore_count));
+        key = mixValue(key, options.rescore_margin);
+    }
+    return key;
+}
+
+uint64_t AnalysisCache::contentHash(const std::string& path) {
+    std::error_code ec;
+    const uint64_t size = std::filesystem::file_size(path, ec);
+    std::ifstream in(path, std::ios::binary);
+    if (ec || !in) {
+        return 0;
+    }
+
+    uint64_t hash = mixValue(kFnvOffset, size);
+    std::vector<uint8_t> buffer;
+    const uint64_t sample = std::min(size, kSampleBytes);
+    const uint64_t middle = size / 2 > sample / 2 ? size / 2 - sample / 2 : 0;
+    for (const uint64_t offset : {uint64_t(0), middle, size - sample}) {
+        buffer.resize(static_cast<size_t>(sample));
+        in.seekg(static_cast<std::streamoff>(offset));
+        if (!in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(sample))) {
+            return 0;
+        }
+        hash = mix(hash, buffer.data(), buffer.size());
+    }
+    return hash;
+}
+
+std::string AnalysisCache::sidecarPath(const std::string& video_path) {
+    return video_path + ".psscore";
+}
+
+bool AnalysisCache::save(const std::string& video_path, uint64_t config_key, const Contents& contents) {
+    SidecarHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.config_key = config_key;
+    header.content_hash = contentHash(video_path);
+    std::error_code ec;
+    header.video_size = std::filesystem::file_size(video_path, ec);
+    if (ec || header.content_hash == 0) {
+        return false;
+    }
+    header.total_frames = contents.summary.total_frames;
+    header.fps = contents.summary.fps;
+    header.width = contents.summary.width;
+    header.height = contents.summary.height;
+    header.count = contents.scores.size();
+    header.tile_size = contents.tiles.tile_size;
+    header.tile_cols = contents.tiles.grid.width;
+    header.tile_rows = contents.tiles.grid.height;
+
+    std::vector<SidecarRecord> records;
+    records.reserve(contents.scores.size());
+    for (const auto& s : contents.scores) {
+        records.push_back({s.index, s.timestamp, s.score, s.raw_score, s.roi.x, s.roi.y, s.roi.width, s.roi.height,
+                           s.gradient_energy, s.high_frequency_ratio});
+    }
+
+    // Write to a temp file and rename so a crash never leaves a torn sidecar
+    const std::string path = sidecarPath(video_path);
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(records.data()),
+                  static_cast<std::streamsize>(records.size() * sizeof(SidecarRecord)));
+        out.write(reinterpret_cast<const char*>(contents.tiles.sharpness.data()),
+                  static_cast<std::streamsize>(contents.tiles.sharpness.size() * sizeof(float)));
+        if (!out) {
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    return true;
+}
+
+bool AnalysisCache::load(const std::string& video_path, uint64_t config_key, Contents& out) {
+    const std::string path = sidecarPath(video_path);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    SidecarHeader header{};
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kVersion || header.config_key != config_key) {
+        return false;
+    }
+
+    // Size first: a cheap reject before hashing
+    std::error_code ec;
+    const uint64_t video_size = std::filesystem::file_size(video_path, ec);
+    if (ec || video_size != header.video_size || contentHash(video_path) != header.content_hash) {
+        return false;
+    }
+
+    // Guard against a truncated or corrupt sidecar before allocating
+    const uint64_t tiles_per_frame = header.tile_cols > 0 && header.tile_rows > 0
+        ? static_cast<uint64_t>(header.tile_cols) * static_cast<uint64_t>(header.tile_rows)
+        : 0;
+    const uint64_t sidecar_size = std::filesystem::file_size(path, ec);
+    if (ec || sidecar_size < sizeof(header) ||
+        (sidecar_size - sizeof(header)) / (sizeof(SidecarRecord) + tiles_per_frame * sizeof(float)) !=
+            header.count ||
+        (sidecar_size - sizeof(header)) % (sizeof(SidecarRecord) + tiles_per_frame * sizeof(float)) != 0) {
+        return false;
+    }
+
+    std::vector<SidecarRecord> records(static_cast<size_t>(header.count));
+    Contents contents;
+    contents.tiles.sharpness.resize(static_cast<size_t>(header.count * tiles_per_frame));
+    if (!in.read(reinterpret_cast<char*>(records.data()),
+                 static_cast<std::streamsize>(records.size() * sizeof(SidecarRecord))) ||
+        !in.read(reinterpret_cast<char*>(contents.tiles.sharpness.data()),
+                 static_cast<std::streamsize>(contents.tiles.sharpness.size() * sizeof(float)))) {
+        return false;
+    }
+
+    contents.summary.total_frames = header.total_frames;
+    contents.summary.width = header.width;
+    contents.summary.height = header.height;
+    contents.summary.fps = header.fps;
+    if (tiles_per_frame > 0) {
+        contents.tiles.tile_size = header.tile_size;
+        contents.tiles.grid = cv::Size(header.tile_cols, header.tile_rows);
+    }
+    contents.scores.reserve(records.size());
+    for (const auto& r : records) {
+        contents.scores.push_back({r.index, r.timestamp, r.score, r.raw_score,
+                                   cv::Rect(r.roi_x, r.roi_y, r.roi_width, r.roi_height),
+                                   r.gradient_energy, r.high_frequency_ratio});
+    }
+
+    out = std::move(contents);
+    return true;
+}
+
+} // namespace planetary
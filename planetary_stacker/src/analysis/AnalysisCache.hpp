@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FrameAnalyzer.hpp"
+
+namespace planetary {
+
+/// Results of an analysis pass, persisted as a binary sidecar next to the
+/// video (.psscore) so analysing the same capture again costs a file read
+/// instead of a decode.
+///
+/// The sidecar is keyed by a partial content hash of the video (its size
+/// and three 1 MiB samples from the start, middle and end, so a copy or a
+/// re-download still hits while a different capture can't) and by a key
+/// of every option that changes the scores; either differing is a miss.
+/// Options that only change speed or what is done with the scores
+/// (threads, frame cache, selection) are not part of the key.
+///
+/// Layout (little-endian): a fixed 96-byte header, [count] 64-byte score
+/// records in the order analyzeVideo() returned them, then [count] rows of
+/// tile_cols * tile_rows floats when tile maps were recorded.
+class AnalysisCache {
+public:
+    struct Contents {
+        FrameAnalyzer::VideoSummary summary;
+        std::vector<FrameAnalyzer::FrameScore> scores;
+        FrameAnalyzer::TileMaps tiles;
+    };
+
+    /// Key of the options in [options] that affect scores, ROIs or tiles,
+    /// for a video decoded in [segment_count] segments (as planned, not
+    /// as requested)
+    static uint64_t configKey(const FrameAnalyzer::Options& options, size_t segment_count);
+
+    /// Partial content hash of the file at [path] (0 if it can't be read)
+    static uint64_t contentHash(const std::string& path);
+
+    /// Sidecar location for [video_path]
+    static std::string sidecarPath(const std::string& video_path);
+
+    /// Write the sidecar for [video_path]. Returns false on I/O error
+    /// (e.g. read-only media); the cache is an optimisation only.
+    static bool save(const std::string& video_path, uint64_t config_key, const Contents& contents);
+
+    /// Load the sidecar for [video_path]. Returns false if it is missing,
+    /// corrupt, or was written for other content or options.
+    static bool load(const std::string& video_path, uint64_t config_key, Contents& out);
+};
+
+} // namespace planetary
@@ -0,0 +1,1000 @@
+#include "FrameAnalyzer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "AnalysisCache.hpp"
+#include "PlanetDetector.hpp"
+#include "QualityMetrics.hpp"
+#include "../pipeline/BoundedRing.hpp"
+#include "../pipeline/WorkStealingPool.hpp"
+#include "../video/DecodedFrame.hpp"
+#include "../video/FrameConverter.hpp"
+#include "../video/RawVideoReader.hpp"
+#include "../video/VideoReader.hpp"
+
+namespace planetary {
+
+namespace {
+
+constexpr int kProgressInterval = 30;
+
+// Segments shorter than this aren't worth a decoder of their own
+constexpr int64_t kMinSegmentFrames = 240;
+
+// Sampled frames per unit of work in the raw path; one tracker follows the
+// planet through the run
+constexpr int64_t kTrackingChunk = 32;
+
+// Smallest tile edge, in scored pixels, a thumbnail still gets
+constexpr int kMinTileCells = 4;
+
+// Frame range [start, end) decoded by one reader; starts on a keyframe
+struct Segment {
+    int64_t start;
+    int64_t end;
+};
+
+// A sampled frame and the region of it to score (decoded-frame
+// coordinates); an empty frame marks the end of the stream
+struct ScoringJob {
+    DecodedFrame frame;
+    cv::Rect roi;
+};
+
+// Per-thread buffers, reused for every frame a worker scores
+struct ScoringScratch {
+    cv::Mat image;
+    cv::Mat thumb;
+    cv::Mat bgr;
+    cv::Mat region;
+    QualityMetrics::TileMap tiles;
+};
+
+// Tile map of one scored frame, until the maps are merged
+struct FrameTiles {
+    int64_t index;
+    QualityMetrics::TileMap map;
+};
+
+// Tile edge in the pixels of an image reduced [scale] times (0 = off)
+int scoredTileSize(int tile_size, int scale) {
+    return tile_size > 0 ? std::max(tile_size / scale, kMinTileCells) : 0;
+}
+
+// [image] cropped to [roi] and box-filtered by [scale]
+const cv::Mat& prepareForScoring(const cv::Mat& image, const cv::Rect& roi, int scale, cv::Mat& thumb) {
+    const cv::Mat region = roi.area() > 0 ? image(roi & cv::Rect(0, 0, image.cols, image.rows)) : image;
+    if (scale <= 1) {
+        thumb = region;
+        return thumb;
+    }
+    // INTER_AREA with an integer factor is a vectorised box filter
+    cv::resize(region, thumb,
+               cv::Size(std::max(region.cols / scale, 1), std::max(region.rows / scale, 1)),
+               0, 0, cv::INTER_AREA);
+    return thumb;
+}
+
+// [roi] of a frame reduced by [scale] in full-resolution coordinates
+cv::Rect toFullFrame(const cv::Rect& roi, int scale, const cv::Rect& frame) {
+    return cv::Rect(roi.x * scale, roi.y * scale, roi.width * scale, roi.height * scale) & frame;
+}
+
+// The decoder already runs frame threads; leave it half the cores
+int resolveWorkerThreads(int requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    const int cores = static_cast<int>(std::thread::hardware_concurrency());
+    return std::clamp(cores / 2, 1, 4);
+}
+
+// One libavcodec instance can't keep all cores busy; split long videos
+// across up to half the cores (the scorers get the rest)
+int resolveDecodeSegments(int requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    const int cores = static_cast<int>(std::thread::hardware_concurrency());
+    return std::clamp(cores / 2, 1, 8);
+}
+
+// Split [index] into up to [count] segments of similar length, each
+// starting at the keyframe at or before its even share boundary
+std::vector<Segment> planSegments(const FrameIndex& index, int count) {
+    const int64_t frames = index.frameCount();
+    count = static_cast<int>(std::min<int64_t>(count, std::max<int64_t>(frames / kMinSegmentFrames, 1)));
+
+    const std::vector<FrameIndex::Keyframe> keyframes = index.keyframes();
+    std::vector<int64_t> starts{0};
+    for (int i = 1; i < count; ++i) {
+        const int64_t target = frames * i / count;
+        auto it = std::upper_bound(keyframes.begin(), keyframes.end(), target,
+            [](int64_t value, const FrameIndex::Keyframe& key) { return value < key.index; });
+        if (it == keyframes.begin()) {
+            continue;
+        }
+        const int64_t start = std::prev(it)->index;
+        if (start > starts.back()) {
+            starts.push_back(start);
+        }
+    }
+
+    std::vector<Segment> segments;
+    for (size_t i = 0; i < starts.size(); ++i) {
+        segments.push_back({starts[i], i + 1 < starts.size() ? starts[i + 1] : frames});
+    }
+    return segments;
+}
+
+// Decoder segments for [index]: one reading the whole video when it has
+// no packet index
+std::vector<Segment> decodeSegments(const FrameIndex& index, const FrameAnalyzer::Options& options) {
+    if (index.empty()) {
+        return {{0, std::numeric_limits<int64_t>::max()}};
+    }
+    return planSegments(index, resolveDecodeSegments(options.decode_segments));
+}
+
+// Packet index of [video_path]: the sidecar, or a demux-only scan, saved
+// as one if [save] (empty if the video can't be indexed)
+FrameIndex loadIndex(const std::string& video_path, bool save) {
+    FrameIndex index;
+    if (!FrameIndex::load(video_path, index)) {
+        index = VideoReader(video_path).buildIndex();
+        if (save && !index.empty()) {
+            index.save(video_path);
+        }
+    }
+    return index;
+}
+
+// Smallest and largest ranking key, kept while the scores are produced
+// so ranking needs no pass of its own to find them
+struct KeyRange {
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+
+    void add(double key) {
+        min = std::min(min, key);
+        max = std::max(max, key);
+    }
+
+    void merge(const KeyRange& other) {
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+};
+
+// Normalize the ranking keys in score (the raw score, or the merged key
+// of refineScores), which span [range], to 0-1 (same convention as the
+// Dart QualityAssessor) and order the best [rank_count] first (0 = all,
+// best first). The rest stay in frame order behind them: a pass over an
+// hour of video only pays for sorting the frames the caller wants.
+// [scores] must be in frame order so ties keep the earlier frame.
+void rankScores(std::vector<FrameAnalyzer::FrameScore>& scores, const KeyRange& range,
+                size_t rank_count) {
+    if (scores.empty()) {
+        return;
+    }
+
+    const double span = range.max - range.min;
+    for (auto& s : scores) {
+        s.score = span > 0 ? (s.score - range.min) / span : 1.0;
+    }
+
+    // Frame order breaks ties, as a stable sort of the frame-ordered list
+    // would
+    const auto better = [](const FrameAnalyzer::FrameScore& a, const FrameAnalyzer::FrameScore& b) {
+        return a.score != b.score ? a.score > b.score : a.index < b.index;
+    };
+    if (rank_count == 0 || rank_count >= scores.size()) {
+        std::sort(scores.begin(), scores.end(), better);
+        return;
+    }
+    const auto ranked = scores.begin() + static_cast<std::ptrdiff_t>(rank_count);
+    std::nth_element(scores.begin(), ranked, scores.end(), better);
+    std::sort(scores.begin(), ranked, better);
+    std::sort(ranked, scores.end(),
+        [](const FrameAnalyzer::FrameScore& a, const FrameAnalyzer::FrameScore& b) {
+            return a.index < b.index;
+        });
+}
+
+// Lay the workers' maps out as one frames x tiles array, in the order of
+// [scores]
+FrameAnalyzer::TileMaps mergeTiles(const std::vector<FrameAnalyzer::FrameScore>& scores,
+                                   std::vector<std::vector<FrameTiles>>& worker_tiles, int tile_size) {
+    std::vector<FrameTiles> tiles;
+    for (auto& partial : worker_tiles) {
+        std::move(partial.begin(), partial.end(), std::back_inserter(tiles));
+    }
+
+    FrameAnalyzer::TileMaps maps;
+    if (tiles.empty()) {
+        return maps;
+    }
+    maps.tile_size = tile_size;
+    for (const auto& t : tiles) {
+        maps.grid.width = std::max(maps.grid.width, t.map.grid.width);
+        maps.grid.height = std::max(maps.grid.height, t.map.grid.height);
+    }
+    std::sort(tiles.begin(), tiles.end(),
+        [](const FrameTiles& a, const FrameTiles& b) { return a.index < b.index; });
+
+    const size_t count = maps.tileCount();
+    maps.sharpness.assign(scores.size() * count, std::numeric_limits<float>::quiet_NaN());
+    for (size_t i = 0; i < scores.size(); ++i) {
+        auto it = std::lower_bound(tiles.begin(), tiles.end(), scores[i].index,
+            [](const FrameTiles& t, int64_t index) { return t.index < index; });
+        if (it == tiles.end() || it->index != scores[i].index) {
+            continue;
+        }
+        const QualityMetrics::TileMap& map = it->map;
+        for (int y = 0; y < map.grid.height; ++y) {
+            std::copy_n(map.sharpness.begin() + static_cast<size_t>(y) * map.grid.width, map.grid.width,
+                        maps.sharpness.begin() + i * count + static_cast<size_t>(y) * maps.grid.width);
+        }
+    }
+    return maps;
+}
+
+// Coarse-to-fine: a frame whose thumbnail score could still make the cut,
+// with what it takes to score it again at full resolution
+struct Candidate {
+    int64_t index = -1;
+    double coarse = 0.0;
+    cv::Rect roi;       // Scored region, in the coordinates of [region]'s frame
+    cv::Mat region;     // Pixels of [roi] (decoded path; raw frames are re-read)
+};
+
+// Bounded best-first store of candidates, ordered like FrameCache. Held
+// regions are capped at [memory_limit] bytes; past that the worst
+// candidates go, so the rescoring margin shrinks instead of memory growing.
+class CandidateSet {
+public:
+    CandidateSet(size_t capacity, size_t memory_limit)
+        : capacity_(capacity), memory_limit_(memory_limit) {
+        heap_.reserve(capacity);
+    }
+
+    bool accepts(int64_t index, double coarse) const {
+        if (capacity_ == 0) {
+            return false;
+        }
+        if (heap_.size() < capacity_) {
+            return true;
+        }
+        const Candidate& worst = heap_.front();
+        return coarse > worst.coarse || (coarse == worst.coarse && index < worst.index);
+    }
+
+    // Keep frame [index] with [region] (an owned copy, may be empty); the
+    // frames this pushes out are listed by dropped()
+    void insert(int64_t index, double coarse, const cv::Rect& roi, cv::Mat region) {
+        dropped_.clear();
+        if (!accepts(index, coarse)) {
+            return;
+        }
+        Candidate entry;
+        if (heap_.size() >= capacity_) {
+            entry = popWorst();
+        }
+        entry.index = index;
+        entry.coarse = coarse;
+        entry.roi = roi;
+        entry.region = std::move(region);
+        memory_ += bytes(entry);
+        heap_.push_back(std::move(entry));
+        std::push_heap(heap_.begin(), heap_.end(), better);
+
+        while (memory_ > memory_limit_ && heap_.size() > 1) {
+            popWorst();
+            capacity_ = heap_.size();
+        }
+    }
+
+    // Frames the last insert() pushed out
+    const std::vector<int64_t>& dropped() const { return dropped_; }
+
+    bool contains(int64_t index) const {
+        return std::any_of(heap_.begin(), heap_.end(),
+            [index](const Candidate& c) { return c.index == index; });
+    }
+
+    std::vector<Candidate>& entries() { return heap_; }
+
+private:
+    static bool better(const Candidate& a, const Candidate& b) {
+        if (a.coarse != b.coarse) {
+            return a.coarse > b.coarse;
+        }
+        return a.index < b.index;
+    }
+
+    static size_t bytes(const Candidate& c) { return c.region.total() * c.region.elemSize(); }
+
+    Candidate popWorst() {
+        std::pop_heap(heap_.begin(), heap_.end(), better);
+        Candidate worst = std::move(heap_.back());
+        heap_.pop_back();
+        memory_ -= bytes(worst);
+        dropped_.push_back(worst.index);
+        return worst;
+    }
+
+    size_t capacity_;
+    size_t memory_limit_;
+    size_t memory_ = 0;
+    std::vector<Candidate> heap_;   // Worst candidate at the front
+    std::vector<int64_t> dropped_;
+};
+
+// Offer a scored frame to the [selector] and the rescore [candidates]
+// (with [region], an owned copy that may be empty) and say whether to
+// cache it. The
+// cache keeps what the final selection can take: the selector's current
+// picks, including quota picks from weak windows, and the candidates,
+// whose ranking rescoring may change. Frames that drop out of both give
+// up their slots. With no selection it keeps the best frames. Callers
+// hold the cache lock.
+bool admitFrame(FrameCache& cache, TemporalSelector& selector, CandidateSet& candidates,
+                int64_t index, double variance, const cv::Rect& roi, cv::Mat region) {
+    int64_t displaced = -1;
+    const bool picked = selector.add(index, variance, &displaced);
+    bool candidate = false;
+    if (candidates.accepts(index, variance)) {
+        candidates.insert(index, variance, roi, std::move(region));
+        for (const int64_t dropped : candidates.dropped()) {
+            if (dropped != index && !selector.picked(dropped)) {
+                cache.erase(dropped);
+            }
+        }
+        const auto& dropped = candidates.dropped();
+        candidate = std::find(dropped.begin(), dropped.end(), index) == dropped.end();
+    }
+    if (displaced >= 0 && !candidates.contains(displaced)) {
+        cache.erase(displaced);
+    }
+    const bool wanted = picked || candidate || selector.count() == 0;
+    return wanted && cache.accepts(index, variance);
+}
+
+// Frames the cache must hold at once: every pick the selector can make
+// plus the rescore candidates (the best [cache_frames] with no selection)
+size_t cacheCapacity(size_t cache_frames, const TemporalSelector& selector, int64_t total_frames,
+                     size_t rescore) {
+    if (cache_frames == 0) {
+        return 0;
+    }
+    if (selector.count() == 0) {
+        return std::max(cache_frames, rescore);
+    }
+    return std::max(cache_frames, selector.maxPicks(total_frames) + rescore);
+}
+
+// Candidates kept for Options::rescore_count (0 = single pass)
+size_t candidateCount(const FrameAnalyzer::Options& options) {
+    if (options.rescore_count == 0 || options.downscale <= 1) {
+        return 0;
+    }
+    return static_cast<size_t>(std::ceil(options.rescore_count * (1.0 + std::max(options.rescore_margin, 0.0))));
+}
+
+// Full-resolution metrics of a candidate, using a worker's buffers
+using FullScorer = std::function<QualityMetrics::Metrics(const Candidate&, ScoringScratch&)>;
+
+// Give the [candidates] in [scores] (frame order) their full-resolution
+// metrics, scored in parallel, and set every ranking key (score),
+// returning their range: the
+// contenders rank by their full-resolution variance, as a full-resolution
+// pass would, and the rest keep their coarse order strictly below the
+// worst of them. raw_score stays a measured variance either way; metrics
+// of frames not rescored are at thumbnail scale.
+KeyRange refineScores(std::vector<FrameAnalyzer::FrameScore>& scores, std::vector<Candidate>& candidates,
+                      int worker_threads, const FullScorer& score_full) {
+    KeyRange range;
+    if (candidates.empty()) {
+        for (const auto& s : scores) {
+            range.add(s.score);
+        }
+        return range;
+    }
+    std::sort(candidates.begin(), candidates.end(),
+        [](const Candidate& a, const Candidate& b) { return a.index < b.index; });
+
+    WorkStealingPool pool(worker_threads);
+    std::vector<ScoringScratch> scratch(pool.size());
+    std::vector<QualityMetrics::Metrics> fine(candidates.size());
+    pool.parallelFor(static_cast<int64_t>(candidates.size()), [&](int64_t i, int worker) {
+        fine[i] = score_full(candidates[i], scratch[worker]);
+    });
+
+    double worst_fine = std::numeric_limits<double>::infinity();
+    double best_coarse = 0.0;
+    size_t next = 0;
+    for (auto& s : scores) {
+        if (next < candidates.size() && candidates[next].index == s.index) {
+            const QualityMetrics::Metrics& m = fine[next++];
+            s.raw_score = m.laplacian_variance;
+            s.score = s.raw_score;
+            s.gradient_energy = m.gradient_energy;
+            s.high_frequency_ratio = m.high_frequency_ratio;
+            worst_fine = std::min(worst_fine, s.raw_score);
+        } else {
+            best_coarse = std::max(best_coarse, s.raw_score);
+        }
+    }
+
+    // Strictly below: ranking and selection break ties by frame order,
+    // which would let a frame never rescored beat a rescored one. Scaled
+    // while the worst contender scores above zero, so keys stay in
+    // proportion; a blank contender (variance 0) would collapse them, so
+    // then the coarse order is laid out in [worst - 2, worst - 1] instead
+    const double ceiling = std::nextafter(worst_fine, -std::numeric_limits<double>::infinity());
+    const bool scaled = ceiling > 0 && best_coarse > 0;
+    const double scale = scaled ? ceiling / best_coarse : 0.0;
+    next = 0;
+    for (auto& s : scores) {
+        if (next < candidates.size() && candidates[next].index == s.index) {
+            ++next;
+        } else if (scaled) {
+            s.score = std::min(s.raw_score * scale, ceiling);
+        } else {
+            const double coarse = best_coarse > 0 ? s.raw_score / best_coarse : 0.0;
+            s.score = worst_fine - 2.0 + coarse;
+        }
+        range.add(s.score);
+    }
+    return range;
+}
+
+// Selector for Options::select_*; the default quota follows the capture length
+TemporalSelector makeSelector(const FrameAnalyzer::Options& options, int64_t total_frames) {
+    const size_t quota = options.select_quota > 0
+        ? static_cast<size_t>(options.select_quota)
+        : TemporalSelector::defaultQuota(options.select_count, options.select_window, total_frames);
+    return TemporalSelector(options.select_count, options.select_window, quota);
+}
+
+// Frame indices of the selection, best first
+std::vector<int64_t> selectedFrames(const TemporalSelector& selector) {
+    std::vector<int64_t> indices;
+    for (const auto& candidate : selector.select()) {
+        indices.push_back(candidate.index);
+    }
+    return indices;
+}
+
+} // namespace
+
+void FrameAnalyzer::setProgressCallback(std::function<void(int, int)> cb) {
+    progress_ = std::move(cb);
+}
+
+std::vector<FrameAnalyzer::FrameScore> FrameAnalyzer::analyzeVideo(
+    const std::string& video_path,
+    int sample_step
+) {
+    Options options;
+    options.sample_step = sample_step;
+    return analyzeVideo(video_path, options);
+}
+
+std::vector<FrameAnalyzer::FrameScore> FrameAnalyzer::analyzeVideo(
+    const std::string& video_path,
+    const Options& options
+) {
+    tile_maps_ = TileMaps();
+    selection_.clear();
+    scores_reused_ = false;
+
+    // Frame numbers come from the packet index, the same numbering
+    // extraction seeks by. Without a sidecar it is built first, even for a
+    // single segment: counting decoded frames instead drifts by one for
+    // every corrupt packet the decoder drops. The demux-only scan is cheap
+    // next to decoding, and segments need it for their keyframes anyway.
+    // It is only saved when sidecars are allowed (Options::score_cache).
+    // Raw captures are read by frame number and have one segment.
+    const bool raw = RawVideoReader::isRawVideo(video_path);
+    FrameIndex index;
+    size_t segment_count = 1;
+    if (!raw) {
+        index = loadIndex(video_path, options.score_cache);
+        segment_count = decodeSegments(index, options).size();
+    }
+
+    // Same capture, same scoring options: the earlier pass's scores stand
+    const uint64_t cache_key = AnalysisCache::configKey(options, segment_count);
+    AnalysisCache::Contents cached;
+    if (options.score_cache && AnalysisCache::load(video_path, cache_key, cached)) {
+        cache_.reset(0, false);  // Nothing was decoded to keep
+        scores_reused_ = true;
+        summary_ = cached.summary;
+        tile_maps_ = std::move(cached.tiles);
+        TemporalSelector selector = makeSelector(options, summary_.total_frames);
+        // score keeps the pass's ranking (rescored frames first)
+        for (const auto& s : cached.scores) {
+            selector.add(s.index, s.score);
+        }
+        selection_ = selectedFrames(selector);
+        if (progress_) {
+            const int total = static_cast<int>(summary_.total_frames);
+            progress_(total, total);
+        }
+        return std::move(cached.scores);
+    }
+
+    std::vector<FrameScore> scores = raw
+        ? analyzeRawVideo(video_path, options)
+        : analyzeDecodedVideo(video_path, options, index);
+    if (options.score_cache && !scores.empty()) {
+        AnalysisCache::save(video_path, cache_key, {summary_, scores, tile_maps_});
+    }
+    return scores;
+}
+
+std::vector<FrameAnalyzer::FrameScore> FrameAnalyzer::analyzeDecodedVideo(
+    const std::string& video_path,
+    const Options& options,
+    const FrameIndex& index
+) {
+    const int sample_step = std::max(options.sample_step, 1);
+
+    const bool indexed = !index.empty();
+    const std::vector<Segment> segments = decodeSegments(index, options);
+    const int segment_count = static_cast<int>(segments.size());
+
+    const int downscale = std::max(options.downscale, 1);
+    DecodeOptions decode;
+    if (options.fast_decode) {
+        for (int factor = downscale; factor > 1; factor >>= 1) {
+            ++decode.lowres;
+        }
+        decode.skip_loop_filter = true;
+    }
+    if (segment_count > 1) {
+        // Share the cores between the segment decoders
+        const int cores = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+        decode.threads = std::max(cores / segment_count, 1);
+    }
+
+    // Each segment gets its own demuxer and decoder context
+    std::vector<std::unique_ptr<VideoReader>> readers;
+    readers.reserve(segment_count);
+    for (int i = 0; i < segment_count; ++i) {
+        readers.push_back(std::make_unique<VideoReader>(video_path, indexed ? &index : nullptr, decode));
+    }
+    VideoReader& reader = *readers.front();
+
+    // Whatever the codec didn't reduce is box-filtered before scoring
+    const int thumb_scale = std::max(downscale >> reader.lowres(), 1);
+    const int scored_scale = thumb_scale << reader.lowres();
+    const int tile_cells = scoredTileSize(options.tile_size, scored_scale);
+    summary_.total_frames = reader.getFrameCount();
+    summary_.width = reader.getWidth();
+    summary_.height = reader.getHeight();
+    summary_.fps = reader.getFPS();
+
+    const int total = static_cast<int>(summary_.total_frames);
+    std::vector<FrameScore> scores;
+    scores.reserve(summary_.total_frames > 0 ? summary_.total_frames / sample_step + 1 : 256);
+
+    // Coarse-to-fine: the contenders' regions are kept at the decoded
+    // resolution and rescored after the pass, and the cache widens to hold
+    // all of them since the final ranking can reorder them
+    const size_t rescore = thumb_scale > 1 ? candidateCount(options) : 0;
+    CandidateSet candidates(rescore, options.cache_memory_limit);
+    // Fed as frames are scored, so the selection is final when the pass is
+    // (made again after it when rescoring, which changes the ranking)
+    TemporalSelector selector = makeSelector(options, summary_.total_frames);
+    const size_t cache_frames =
+        cacheCapacity(options.cache_frames, selector, summary_.total_frames, rescore);
+
+    const size_t frame_bytes = static_cast<size_t>(summary_.width) * summary_.height * 3;
+    cache_.reset(reader.isReducedQuality() ? 0 : cache_frames,
+                 cache_frames * frame_bytes > options.cache_memory_limit);
+    // Scores always refer to full-resolution frame coordinates
+    const cv::Rect frame_rect(0, 0, summary_.width, summary_.height);
+
+    // Every frame must be decoded (inter-frame codecs), but only sampled
+    // frames are queued for scoring, as references to the decoder's
+    // buffers (no pixel copy). In luma mode workers score the Y plane in
+    // place; frames that make the cache are converted to BGR once.
+    const int worker_count = resolveWorkerThreads(options.worker_threads);
+    BoundedRing<ScoringJob> queue(
+        static_cast<size_t>(std::max(options.queue_depth, 2 * segment_count)));
+    std::vector<std::vector<FrameScore>> worker_scores(worker_count);
+    std::vector<KeyRange> worker_ranges(worker_count);
+    std::vector<std::vector<FrameTiles>> worker_tiles(worker_count);
+    std::mutex cache_mutex;     // Guards the cache and the selector
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto fail = [&](std::exception_ptr e) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+            error = e;
+        }
+        failed.store(true, std::memory_order_relaxed);
+    };
+
+    auto score = [&](int worker) {
+        FrameConverter converter;
+        cv::Mat image;
+        cv::Mat thumb;
+        cv::Mat bgr;
+        QualityMetrics::TileMap tiles;
+        std::vector<FrameScore>& out = worker_scores[worker];
+
+        while (true) {
+            const ScoringJob job = queue.pop();
+            const DecodedFrame& frame = job.frame;
+            if (frame.empty()) {
+                break;  // End of stream marker
+            }
+            if (failed.load(std::memory_order_relaxed)) {
+                continue;  // Drain so the decoder never blocks
+            }
+
+            try {
+                if (options.luma_only) {
+                    converter.toLuma(frame.frame(), image);
+                } else {
+                    converter.toBgr(frame.frame(), image);
+                }
+                // Crop before the thumbnail so only the planet is filtered
+                const cv::Mat& scored = prepareForScoring(image, job.roi, thumb_scale, thumb);
+                // One fused pass yields all metrics; Laplacian variance ranks
+                const QualityMetrics::Metrics metrics =
+                    QualityMetrics::compute(scored, cv::Rect(), tile_cells, tiles);
+                if (tile_cells > 0) {
+                    worker_tiles[worker].push_back({frame.index(), std::move(tiles)});
+                }
+                const double variance = metrics.laplacian_variance;
+                const cv::Rect roi = job.roi.area() > 0
+                    ? toFullFrame(job.roi, 1 << reader.lowres(), frame_rect)
+                    : frame_rect;
+                out.push_back({frame.index(), frame.timestamp(), variance, variance, roi,
+                               metrics.gradient_energy, metrics.high_frequency_ratio});
+                worker_ranges[worker].add(variance);
+
+                const cv::Rect region = job.roi.area() > 0
+                    ? job.roi & cv::Rect(0, 0, image.cols, image.rows)
+                    : cv::Rect(0, 0, image.cols, image.rows);
+                // Copies and encodes happen outside the lock, which is only
+                // held to decide and to swap entries in; a frame that loses
+                // its place in between just wastes its copy
+                cv::Mat copy;
+                if (rescore > 0) {
+                    bool wanted = false;
+                    {
+                        std::lock_guard<std::mutex> lock(cache_mutex);
+                        wanted = candidates.accepts(frame.index(), variance);
+                    }
+                    if (wanted) {
+                        copy = image(region).clone();
+                    }
+                }
+                bool keep = false;
+                {
+                    std::lock_guard<std::mutex> lock(cache_mutex);
+                    keep = admitFrame(cache_, selector, candidates, frame.index(), variance,
+                                      region, std::move(copy));
+                }
+                if (keep) {
+                    if (options.luma_only) {
+                        converter.toBgr(frame.frame(), bgr);
+                    }
+                    FrameCache::Entry entry = FrameCache::encode(
+                        frame.index(), variance, options.luma_only ? bgr : image, cache_.compressed());
+                    std::lock_guard<std::mutex> lock(cache_mutex);
+                    cache_.insert(std::move(entry));
+                }
+            } catch (...) {
+                fail(std::current_exception());
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(worker_count);
+    for (int i = 0; i < worker_count; ++i) {
+        workers.emplace_back(score, i);
+    }
+
+    std::atomic<int64_t> decoded{0};
+    std::mutex progress_mutex;
+
+    auto decodeSegment = [&](VideoReader& segment_reader, const Segment& segment) {
+        // Tracking runs in decode order, one tracker per segment, so the
+        // regions don't depend on how the workers are scheduled
+        FrameConverter converter;
+        std::optional<PlanetTracker> tracker;
+        cv::Mat luma;
+        try {
+            if (segment.start > 0 && !segment_reader.seek(segment.start)) {
+                throw std::runtime_error("Cannot seek to frame " + std::to_string(segment.start));
+            }
+            while (!failed.load(std::memory_order_relaxed) && segment_reader.grab()) {
+                const int64_t frame_index = segment_reader.position();
+                if (frame_index < segment.start) {
+                    continue;  // Open-GOP leading frames belong to the previous segment
+                }
+                if (frame_index >= segment.end) {
+                    break;
+                }
+                const int64_t done = decoded.fetch_add(1, std::memory_order_relaxed) + 1;
+
+                if (frame_index % sample_step == 0) {
+                    ScoringJob job;
+                    segment_reader.retrieveFrame(job.frame);
+                    if (options.track_planet) {
+                        // Usually a view of the Y plane, so this costs
+                        // only the detector's own work
+                        converter.toLuma(job.frame.frame(), luma);
+                        if (!tracker) {
+                            tracker.emplace(luma.size(), options.redetect_interval, options.roi_margin);
+                        }
+                        job.roi = tracker->update(frame_index, [&luma](const cv::Rect& region) {
+                            return region.area() > 0 ? luma(region) : luma;
+                        });
+                    }
+                    // Blocks while the ring is full (backpressure)
+                    queue.push(std::move(job));
+                }
+
+                if (progress_ && done % kProgressInterval == 0) {
+                    std::lock_guard<std::mutex> lock(progress_mutex);
+                    progress_(static_cast<int>(done), std::max(total, static_cast<int>(done)));
+                }
+            }
+        } catch (...) {
+            fail(std::current_exception());
+        }
+    };
+
+    // The calling thread decodes the first segment, extra threads the rest
+    std::vector<std::thread> decoders;
+    decoders.reserve(segment_count - 1);
+    for (int i = 1; i < segment_count; ++i) {
+        decoders.emplace_back(decodeSegment, std::ref(*readers[i]), segments[i]);
+    }
+    decodeSegment(reader, segments.front());
+    for (auto& decoder : decoders) {
+        decoder.join();
+    }
+
+    for (int i = 0; i < worker_count; ++i) {
+        queue.push(ScoringJob());
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    KeyRange range;
+    for (int i = 0; i < worker_count; ++i) {
+        scores.insert(scores.end(), worker_scores[i].begin(), worker_scores[i].end());
+        range.merge(worker_ranges[i]);
+    }
+    // Workers and segments finish out of order; restore frame order so ties below
+    // resolve exactly as in a sequential pass
+    std::sort(scores.begin(), scores.end(),
+        [](const FrameScore& a, const FrameScore& b) { return a.index < b.index; });
+
+    // The container estimate can be off; report what was actually decoded
+    const int64_t decoded_total = decoded.load();
+    if (decoded_total > 0) {
+        summary_.total_frames = decoded_total;
+    }
+    if (progress_) {
+        progress_(static_cast<int>(decoded_total), static_cast<int>(decoded_total));
+    }
+
+    if (rescore > 0) {
+        range = refineScores(scores, candidates.entries(), options.worker_threads,
+            [](const Candidate& c, ScoringScratch&) { return QualityMetrics::compute(c.region); });
+        selector = makeSelector(options, summary_.total_frames);
+        for (const auto& score : scores) {
+            selector.add(score.index, score.score);
+        }
+    }
+
+    rankScores(scores, range, options.rank_count);
+    tile_maps_ = mergeTiles(scores, worker_tiles, tile_cells * scored_scale);
+    selection_ = selectedFrames(selector);
+    if (selector.count() > 0) {
+        // Only the selection goes on to be stacked
+        cache_.retain(selection_);
+    }
+    return scores;
+}
+
+std::vector<FrameAnalyzer::FrameScore> FrameAnalyzer::analyzeRawVideo(
+    const std::string& video_path,
+    const Options& options
+) {
+    const int sample_step = std::max(options.sample_step, 1);
+    const int downscale = std::max(options.downscale, 1);
+
+    const RawVideoReader reader(video_path);
+    summary_.total_frames = reader.getFrameCount();
+    summary_.width = reader.getWidth();
+    summary_.height = reader.getHeight();
+    summary_.fps = reader.getFPS();
+
+    const int64_t total = summary_.total_frames;
+    const int64_t sampled = (total + sample_step - 1) / sample_step;
+    // Bayer luma thumbnails average whole 2x2 cells
+    const int scored_scale = options.luma_only && reader.isBayer() && downscale > 1
+        ? (downscale + 1) / 2 * 2
+        : downscale;
+    const int tile_cells = scoredTileSize(options.tile_size, scored_scale);
+
+    // Coarse-to-fine: contenders are re-read from the mapping at full
+    // resolution after the pass, so only their regions are remembered
+    const size_t rescore = candidateCount(options);
+    CandidateSet candidates(rescore, options.cache_memory_limit);
+    TemporalSelector selector = makeSelector(options, total);
+    const size_t cache_frames = cacheCapacity(options.cache_frames, selector, total, rescore);
+
+    const size_t frame_bytes = static_cast<size_t>(summary_.width) * summary_.height * 3;
+    cache_.reset(cache_frames, cache_frames * frame_bytes > options.cache_memory_limit);
+    const cv::Rect frame_rect(0, 0, summary_.width, summary_.height);
+
+    // Nothing to decode: frames are pages of the mapping, so the pass runs
+    // at storage bandwidth on every core. Work is dealt out in runs of
+    // sampled frames that idle threads steal from busy ones; each run
+    // starts with a fresh tracker and keeps its own results, so regions
+    // and the merged order are the same however the runs are scheduled.
+    WorkStealingPool pool(options.worker_threads);
+    const int64_t runs = (sampled + kTrackingChunk - 1) / kTrackingChunk;
+    std::vector<std::vector<FrameScore>> run_scores(static_cast<size_t>(runs));
+    std::vector<KeyRange> run_ranges(static_cast<size_t>(runs));
+    std::vector<std::vector<FrameTiles>> run_tiles(static_cast<size_t>(runs));
+    std::vector<ScoringScratch> scratch(pool.size());
+    std::atomic<int64_t> scored_count{0};
+    std::mutex cache_mutex;     // Guards the cache and the selector
+    std::mutex progress_mutex;
+
+    pool.parallelFor(runs, [&](int64_t run, int worker) {
+        ScoringScratch& buffers = scratch[worker];
+        std::vector<FrameScore>& out = run_scores[run];
+        PlanetTracker tracker(frame_rect.size(), options.redetect_interval, options.roi_margin);
+
+        int64_t index = 0;
+        const PlanetTracker::LumaSource luma = [&](const cv::Rect& r) {
+            reader.toLuma(index, buffers.region, 1, r);
+            return buffers.region;
+        };
+
+        const int64_t last = std::min((run + 1) * kTrackingChunk, sampled);
+        for (int64_t i = run * kTrackingChunk; i < last; ++i) {
+            index = i * sample_step;
+            const cv::Rect roi = options.track_planet ? tracker.update(index, luma) : frame_rect;
+            const cv::Mat* scored = &buffers.image;
+            if (options.luma_only) {
+                // Only the region is converted; the rest of the frame is never read
+                reader.toLuma(index, buffers.image, downscale, roi);
+            } else {
+                reader.toBgr(index, buffers.bgr);
+                scored = &prepareForScoring(buffers.bgr, roi, downscale, buffers.thumb);
+            }
+            // One fused pass yields all metrics; Laplacian variance ranks
+            const QualityMetrics::Metrics metrics =
+                QualityMetrics::compute(*scored, cv::Rect(), tile_cells, buffers.tiles);
+            if (tile_cells > 0) {
+                run_tiles[run].push_back({index, std::move(buffers.tiles)});
+            }
+            const double variance = metrics.laplacian_variance;
+            out.push_back({index, reader.timestamp(index), variance, variance, roi,
+                           metrics.gradient_energy, metrics.high_frequency_ratio});
+            run_ranges[run].add(variance);
+
+            bool keep = false;
+            {
+                std::lock_guard<std::mutex> lock(cache_mutex);
+                keep = admitFrame(cache_, selector, candidates, index, variance, roi, cv::Mat());
+            }
+            if (keep) {
+                if (options.luma_only) {
+                    reader.toBgr(index, buffers.bgr);
+                }
+                // Encoded outside the lock; only the swap is serialised
+                FrameCache::Entry entry =
+                    FrameCache::encode(index, variance, buffers.bgr, cache_.compressed());
+                std::lock_guard<std::mutex> lock(cache_mutex);
+                cache_.insert(std::move(entry));
+            }
+
+            const int64_t count = scored_count.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (progress_ && count % kProgressInterval == 0) {
+                std::lock_guard<std::mutex> lock(progress_mutex);
+                progress_(static_cast<int>(std::min(count * sample_step, total)), static_cast<int>(total));
+            }
+        }
+    });
+
+    // Runs are consecutive, so concatenating them restores frame order
+    std::vector<FrameScore> scores;
+    scores.reserve(static_cast<size_t>(sampled));
+    KeyRange range;
+    for (size_t i = 0; i < run_scores.size(); ++i) {
+        scores.insert(scores.end(), run_scores[i].begin(), run_scores[i].end());
+        range.merge(run_ranges[i]);
+    }
+
+    if (progress_) {
+        progress_(static_cast<int>(total), static_cast<int>(total));
+    }
+
+    if (rescore > 0) {
+        range = refineScores(scores, candidates.entries(), options.worker_threads,
+            [&](const Candidate& c, ScoringScratch& buffers) {
+                if (options.luma_only) {
+                    reader.toLuma(c.index, buffers.image, 1, c.roi);
+                    return QualityMetrics::compute(buffers.image);
+                }
+                reader.toBgr(c.index, buffers.bgr);
+                return QualityMetrics::compute(buffers.bgr, c.roi);
+            });
+        selector = makeSelector(options, total);
+        for (const auto& score : scores) {
+            selector.add(score.index, score.score);
+        }
+    }
+
+    rankScores(scores, range, options.rank_count);
+    tile_maps_ = mergeTiles(scores, run_tiles, tile_cells * scored_scale);
+    selection_ = selectedFrames(selector);
+    if (selector.count() > 0) {
+        // Only the selection goes on to be stacked
+        cache_.retain(selection_);
+    }
+    return scores;
+}
+
+std::vector<double> FrameAnalyzer::scoreImages(const std::vector<std::string>& paths, int worker_threads) {
+    const int64_t total = static_cast<int64_t>(paths.size());
+    std::vector<double> variances(paths.size(), std::numeric_limits<double>::quiet_NaN());
+
+    // Each worker decodes into its own buffer; every result has its own
+    // slot, so the output order never depends on scheduling
+    WorkStealingPool pool(worker_threads);
+    std::vector<cv::Mat> images(pool.size());
+    int64_t done = 0;
+    std::mutex progress_mutex;
+
+    pool.parallelFor(total, [&](int64_t i, int worker) {
+        // Same 8-bit BGR -> gray path as the Dart QualityAssessor
+        images[worker] = cv::imread(paths[i], cv::IMREAD_COLOR);
+        if (!images[worker].empty()) {
+            variances[i] = QualityMetrics::compute(images[worker]).laplacian_variance;
+        }
+
+        if (progress_) {
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            progress_(static_cast<int>(++done), static_cast<int>(total));
+        }
+    });
+    return variances;
+}
+
+} // namespace planetary
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "FrameCache.hpp"
+#include "FrameSelector.hpp"
+
+namespace planetary {
+
+class FrameIndex;
+
+/// Pass 1 orchestration: streams a video through the decoder and scores
+/// sampled frames in memory.
+///
+/// Decoding and scoring overlap: decoder threads push references to
+/// sampled frames into a bounded ring, and a pool of worker threads scores
+/// them, so throughput is set by the slower of the two.
+///
+/// Long videos are split at keyframes (from the packet index) into
+/// segments that are decoded side by side, each with its own decoder
+/// context; scores are merged back in frame order.
+///
+/// With Options::track_planet each frame is scored only around the
+/// planetary disk, which is what sharpness means for a planet and skips
+/// the empty sky that makes up most of a typical capture.
+///
+/// SER and uncompressed AVI captures skip the decoder entirely: frames are
+/// read in place from a memory mapping (RawVideoReader) and scored by all
+/// cores at once, balanced by work stealing (WorkStealingPool).
+class FrameAnalyzer {
+public:
+    struct FrameScore {
+        int64_t index;      // Frame index in the video (decoder order, 0-based)
+        double timestamp;   // Presentation time in seconds from stream start
+        double score;       // Normalized quality (0.0 to 1.0); the ranking key
+        double raw_score;   // Laplacian variance, as measured
+        cv::Rect roi;       // Region that was scored
+        double gradient_energy;         // Mean squared Sobel magnitude
+        double high_frequency_ratio;    // High-frequency energy share
+    };
+
+    /// Per-tile sharpness of every scored frame (Options::tile_size).
+    ///
+    /// Each frame's scored region is cut into a grid of tiles anchored at
+    /// its top-left corner; when tracking, tile (x, y) therefore covers the
+    /// same part of the disk in every frame. Row i of [sharpness] belongs
+    /// to the i-th score returned by analyzeVideo(); tiles a frame's grid
+    /// doesn't have (its region was smaller) are NaN.
+    struct TileMaps {
+        int tile_size = 0;                // Tile edge in full-resolution pixels
+        cv::Size grid;                    // Tiles across and down
+        std::vector<float> sharpness;     // frames x tiles Laplacian variance
+
+        size_t tileCount() const { return static_cast<size_t>(grid.area()); }
+        const float* frame(size_t i) const { return sharpness.data() + i * tileCount(); }
+    };
+
+    struct VideoSummary {
+        int64_t total_frames = 0;
+        int width = 0;
+        int height = 0;
+        double fps = 0.0;
+    };
+
+    struct Options {
+        int sample_step = 3;        // Score every Nth frame
+        bool luma_only = true;      // Score the decoder's Y plane (no BGR conversion)
+
+        // Keep the best N sampled frames decoded in memory (0 = off) so
+        // selection doesn't need a second decode pass
+        size_t cache_frames = 0;
+        // Store cached frames compressed when N uncompressed BGR frames
+        // would exceed this many bytes
+        size_t cache_memory_limit = size_t(512) << 20;
+
+        // Score a 1/downscale thumbnail of the luma plane (1, 2, 4): much
+        // faster on 4K at the cost of slightly noisier rankings
+        int downscale = 1;
+        // Reach the downscale partly through codec low-res decoding and
+        // skip the deblocking filter. Decoded frames are then unfit for
+        // stacking, so the frame cache is disabled.
+        bool fast_decode = false;
+
+        // Score only the planet: PlanetDetector finds the disk, it is
+        // re-detected every redetect_interval frames and followed by its
+        // centroid in between, and only the box grown by roi_margin is
+        // scored. Falls back to the whole frame when no disk is found.
+        bool track_planet = true;
+        int redetect_interval = 30;
+        double roi_margin = 1.2;
+
+        // Also record the sharpness of each tile_size x tile_size tile of
+        // the scored region (full-resolution pixels, 0 = off); from the
+        // same pass as the global score
+        int tile_size = 0;
+
+        // Pick the best select_count frames as they are scored, at most
+        // select_quota from every select_window consecutive frames (window
+        // 0 = plain top-N; quota 0 = twice a window's even share). With the
+        // frame cache on, the windows' current picks and the rescore
+        // candidates are cached, and only the final selection is kept.
+        size_t select_count = 0;
+        int select_window = 0;
+        int select_quota = 0;
+
+        // Order only the best rank_count scores, best first; the rest
+        // follow in frame order (0 = all best first)
+        size_t rank_count = 0;
+
+        // Coarse-to-fine: with downscale > 1, keep the best rescore_count
+        // frames (plus a rescore_margin share) by their thumbnail score
+        // and score them again at full resolution once the pass is done.
+        // The contenders are then ranked exactly as a full-resolution pass
+        // would rank them, and every other frame keeps its coarse order
+        // below them. Kept regions count against cache_memory_limit.
+        // 0 = off.
+        size_t rescore_count = 0;
+        double rescore_margin = 0.5;
+
+        // Reuse the scores of an earlier pass over the same video with the
+        // same scoring options, and save this pass's (AnalysisCache sidecar).
+        // Also allows saving the packet index built for the pass (.psidx).
+        // Off by default: sidecars go next to the video, which may sit on
+        // read-only or shared storage.
+        bool score_cache = false;
+
+        // Keyframe-aligned segments decoded in parallel (0 = auto, 1 =
+        // one sequential decoder). Builds the packet index if missing.
+        int decode_segments = 0;
+        // Scoring threads fed by the decoders (0 = auto)
+        int worker_threads = 0;
+        // Sampled frames queued between decoder and scorers; caps memory
+        // at queue_depth + worker_threads decoded frames
+        int queue_depth = 8;
+    };
+
+    /// Analyze every [sample_step]th frame.
+    /// Returns scores sorted by quality, best first.
+    std::vector<FrameScore> analyzeVideo(
+        const std::string& video_path,
+        int sample_step = 3
+    );
+
+    std::vector<FrameScore> analyzeVideo(
+        const std::string& video_path,
+        const Options& options
+    );
+
+    /// Laplacian variance of each image file in [paths] (e.g. extracted
+    /// frames), scored on [worker_threads] threads (0 = all cores) with
+    /// work stealing. Values are in the order of [paths]; NaN for images
+    /// that can't be read. Reports progress like analyzeVideo().
+    std::vector<double> scoreImages(const std::vector<std::string>& paths, int worker_threads = 0);
+
+    /// Metadata of the most recently analyzed video
+    const VideoSummary& summary() const { return summary_; }
+
+    /// Tile maps of the last analysis (empty unless Options::tile_size)
+    const TileMaps& tileMaps() const { return tile_maps_; }
+
+    /// Frames picked during the last analysis (Options::select_count), best
+    /// first; spread over the capture by TemporalSelector
+    const std::vector<int64_t>& selection() const { return selection_; }
+
+    /// Best frames kept during the last analysis (Options::cache_frames)
+    FrameCache& cache() { return cache_; }
+
+    /// Whether the last analysis reused saved scores (Options::score_cache),
+    /// in which case nothing was decoded and the cache is empty
+    bool scoresReused() const { return scores_reused_; }
+
+    /// Progress callback: (frames decoded, estimated total frames)
+    void setProgressCallback(std::function<void(int, int)> cb);
+
+private:
+    std::vector<FrameScore> analyzeDecodedVideo(const std::string& video_path, const Options& options,
+                                                const FrameIndex& index);
+    std::vector<FrameScore> analyzeRawVideo(const std::string& video_path, const Options& options);
+
+    std::function<void(int, int)> progress_;
+    VideoSummary summary_;
+    TileMaps tile_maps_;
+    FrameCache cache_;
+    std::vector<int64_t> selection_;
+    bool scores_reused_ = false;
+};
+
+} // namespace planetary
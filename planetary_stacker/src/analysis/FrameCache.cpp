@@ -0,0 +1,145 @@
+#include "FrameCache.hpp"
+
+#include <algorithm>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "../video/FrameSpool.hpp"
+
+namespace planetary {
+
+namespace {
+
+// Heap order: true when [a] is better than [b], which puts the worst
+// entry at the front of a std::*_heap range
+bool better(const FrameCache::Entry& a, const FrameCache::Entry& b) {
+    if (a.raw_score != b.raw_score) {
+        return a.raw_score > b.raw_score;
+    }
+    return a.index < b.index;
+}
+
+size_t entryBytes(const FrameCache::Entry& entry) {
+    return entry.encoded.size() + entry.image.total() * entry.image.elemSize();
+}
+
+// Fast PNG compression for builds without LZ4
+const std::vector<int> kPngParams = {cv::IMWRITE_PNG_COMPRESSION, 1};
+
+} // namespace
+
+FrameCache::FrameCache(size_t capacity, bool compressed) {
+    reset(capacity, compressed);
+}
+
+void FrameCache::reset(size_t capacity, bool compressed) {
+    capacity_ = capacity;
+    compressed_ = compressed;
+    memory_ = 0;
+    heap_.clear();
+    heap_.reserve(capacity);
+}
+
+bool FrameCache::accepts(int64_t index, double raw_score) const {
+    if (capacity_ == 0) {
+        return false;
+    }
+    if (heap_.size() < capacity_) {
+        return true;
+    }
+    // Equal scores favour the earlier frame whatever order frames arrive
+    // in, so parallel decoding keeps the same set as a sequential pass
+    const Entry& worst = heap_.front();
+    return raw_score > worst.raw_score || (raw_score == worst.raw_score && index < worst.index);
+}
+
+FrameCache::Entry FrameCache::encode(int64_t index, double raw_score, const cv::Mat& bgr,
+                                     bool compressed) {
+    Entry entry;
+    entry.index = index;
+    entry.raw_score = raw_score;
+    entry.size = bgr.size();
+    entry.type = bgr.type();
+    if (!compressed) {
+        bgr.copyTo(entry.image);
+    } else if (FrameSpool::hasLz4()) {
+        FrameSpoolWriter::compressLz4(bgr.isContinuous() ? bgr : bgr.clone(), entry.encoded);
+    } else {
+        cv::imencode(".png", bgr, entry.encoded, kPngParams);
+    }
+    return entry;
+}
+
+void FrameCache::insert(Entry entry) {
+    if (!accepts(entry.index, entry.raw_score)) {
+        return;
+    }
+
+    if (heap_.size() >= capacity_) {
+        std::pop_heap(heap_.begin(), heap_.end(), better);
+        memory_ -= entryBytes(heap_.back());
+        heap_.pop_back();
+    }
+
+    memory_ += entryBytes(entry);
+    heap_.push_back(std::move(entry));
+    std::push_heap(heap_.begin(), heap_.end(), better);
+}
+
+void FrameCache::insert(int64_t index, double raw_score, const cv::Mat& bgr) {
+    if (accepts(index, raw_score)) {
+        insert(encode(index, raw_score, bgr, compressed_));
+    }
+}
+
+bool FrameCache::contains(int64_t index) const {
+    return std::any_of(heap_.begin(), heap_.end(),
+        [index](const Entry& e) { return e.index == index; });
+}
+
+void FrameCache::erase(int64_t index) {
+    const auto it = std::find_if(heap_.begin(), heap_.end(),
+        [index](const Entry& e) { return e.index == index; });
+    if (it == heap_.end()) {
+        return;
+    }
+    memory_ -= entryBytes(*it);
+    heap_.erase(it);
+    std::make_heap(heap_.begin(), heap_.end(), better);
+}
+
+void FrameCache::retain(const std::vector<int64_t>& indices) {
+    const auto end = std::remove_if(heap_.begin(), heap_.end(), [&](const Entry& e) {
+        return std::find(indices.begin(), indices.end(), e.index) == indices.end();
+    });
+    for (auto it = end; it != heap_.end(); ++it) {
+        memory_ -= entryBytes(*it);
+    }
+    heap_.erase(end, heap_.end());
+    std::make_heap(heap_.begin(), heap_.end(), better);
+}
+
+void FrameCache::writeTo(FrameSpoolWriter& spool) {
+    std::sort_heap(heap_.begin(), heap_.end(), better);
+    for (const auto& entry : heap_) {
+        if (!compressed_) {
+            spool.append(entry.index, entry.image);
+        } else if (FrameSpool::hasLz4()) {
+            spool.appendLz4(entry.index, entry.size.height, entry.size.width, entry.type,
+                            entry.encoded);
+        } else {
+            spool.append(entry.index, cv::imdecode(entry.encoded, cv::IMREAD_UNCHANGED));
+        }
+    }
+    std::make_heap(heap_.begin(), heap_.end(), better);
+}
+
+std::vector<FrameCache::Entry> FrameCache::take() {
+    std::sort_heap(heap_.begin(), heap_.end(), better);
+    std::vector<Entry> entries = std::move(heap_);
+    heap_.clear();
+    memory_ = 0;
+    return entries;
+}
+
+} // namespace planetary
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+namespace planetary {
+
+class FrameSpoolWriter;
+
+/// Bounded top-K store of decoded frames, filled during the analysis pass.
+///
+/// Keeps the [capacity] best-scoring frames seen so far in a min-heap, so
+/// the frames that selection will pick are already in memory when the
+/// pass ends and never have to be decoded a second time. A frame is only
+/// copied when it beats the current worst entry.
+///
+/// In compressed mode frames are held LZ4-compressed (in-memory PNG at
+/// the fast level when built without LZ4), typically an order of magnitude
+/// smaller for planetary footage (mostly black sky). LZ4 entries go into
+/// the frame spool without recompressing.
+///
+/// Entries are whole frames even when the pass tracks the planet: the
+/// spool records and everything that reads them (alignment, stacking)
+/// assume every frame has the video's geometry. Caching the tracked ROI
+/// crop would shrink a 4K capture's entries about tenfold, but needs a
+/// per-record offset in the spool and a common crop downstream; until
+/// then compression is what keeps large captures within
+/// cache_memory_limit.
+class FrameCache {
+public:
+    struct Entry {
+        int64_t index = -1;
+        double raw_score = 0.0;
+        cv::Mat image;                 // BGR (uncompressed mode)
+        std::vector<uint8_t> encoded;  // LZ4 or PNG bytes (compressed mode)
+        cv::Size size;                 // Geometry of the frame
+        int type = 0;
+    };
+
+    FrameCache() = default;
+    FrameCache(size_t capacity, bool compressed);
+
+    /// Drop all entries and change the capacity/storage mode
+    void reset(size_t capacity, bool compressed);
+
+    size_t capacity() const { return capacity_; }
+    size_t size() const { return heap_.size(); }
+    bool empty() const { return heap_.empty(); }
+    bool compressed() const { return compressed_; }
+
+    /// Approximate bytes held by cached frames
+    size_t memoryUsage() const { return memory_; }
+
+    /// True if frame [index] with [raw_score] would be kept. Checked
+    /// before converting a frame so rejected frames cost nothing.
+    bool accepts(int64_t index, double raw_score) const;
+
+    /// Entry holding a copy of [bgr] for frame [index], stored as a
+    /// cache in [compressed] mode stores it. Touches no cache state, so
+    /// concurrent callers can encode outside the cache's lock.
+    static Entry encode(int64_t index, double raw_score, const cv::Mat& bgr, bool compressed);
+
+    /// Store [entry] (from encode(), in this cache's mode), evicting the
+    /// worst entry when full. Does nothing if accepts() is false.
+    void insert(Entry entry);
+
+    /// Store a copy of [bgr] for frame [index]: encode() then insert()
+    void insert(int64_t index, double raw_score, const cv::Mat& bgr);
+
+    /// Whether frame [index] is cached
+    bool contains(int64_t index) const;
+
+    /// Drop frame [index] if it is cached
+    void erase(int64_t index);
+
+    /// Drop every frame not in [indices]
+    void retain(const std::vector<int64_t>& indices);
+
+    /// Append every entry to [spool], best first
+    void writeTo(FrameSpoolWriter& spool);
+
+    /// Remove and return all entries, best first
+    std::vector<Entry> take();
+
+private:
+    size_t capacity_ = 0;
+    bool compressed_ = false;
+    size_t memory_ = 0;
+
+    // Min-heap: the worst entry (lowest score, latest index on ties) is at
+    // the front, so ties keep the earlier frame like the stable sort does
+    std::vector<Entry> heap_;
+};
+
+} // namespace planetary
@@ -0,0 +1,121 @@
+#include "FrameSelector.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+namespace planetary {
+
+namespace {
+
+// Heap order: true when [a] is better than [b], which puts the worst
+// candidate at the front of a std::*_heap range
+bool better(const TemporalSelector::Candidate& a, const TemporalSelector::Candidate& b) {
+    if (a.score != b.score) {
+        return a.score > b.score;
+    }
+    return a.index < b.index;
+}
+
+// Offer [candidate] to a heap of at most [capacity] entries. Returns false
+// if it was rejected; an entry it displaced is moved to [evicted].
+bool offer(std::vector<TemporalSelector::Candidate>& heap, size_t capacity,
+           const TemporalSelector::Candidate& candidate,
+           std::optional<TemporalSelector::Candidate>& evicted) {
+    if (heap.size() < capacity) {
+        heap.push_back(candidate);
+        std::push_heap(heap.begin(), heap.end(), better);
+        return true;
+    }
+    if (capacity == 0 || !better(candidate, heap.front())) {
+        return false;
+    }
+    std::pop_heap(heap.begin(), heap.end(), better);
+    evicted = heap.back();
+    heap.back() = candidate;
+    std::push_heap(heap.begin(), heap.end(), better);
+    return true;
+}
+
+} // namespace
+
+TemporalSelector::TemporalSelector(size_t count, int64_t window, size_t quota)
+    : count_(count),
+      window_(std::max<int64_t>(window, 0)),
+      quota_(window > 0 ? std::clamp<size_t>(quota, 1, std::max<size_t>(count, 1)) : count) {}
+
+bool TemporalSelector::add(int64_t index, double score, int64_t* displaced) {
+    if (displaced != nullptr) {
+        *displaced = -1;
+    }
+    if (count_ == 0 || std::isnan(score)) {
+        return false;
+    }
+
+    const Candidate candidate{index, score};
+    std::vector<Candidate>& heap = windows_[window_ > 0 ? index / window_ : 0];
+    std::optional<Candidate> evicted;
+    if (!offer(heap, quota_, candidate, evicted)) {
+        reserve(candidate);
+        return false;
+    }
+    if (evicted) {
+        reserve(*evicted);
+        if (displaced != nullptr) {
+            *displaced = evicted->index;
+        }
+    }
+    return true;
+}
+
+bool TemporalSelector::picked(int64_t index) const {
+    const auto window = windows_.find(window_ > 0 ? index / window_ : 0);
+    return window != windows_.end() &&
+           std::any_of(window->second.begin(), window->second.end(),
+               [index](const Candidate& c) { return c.index == index; });
+}
+
+size_t TemporalSelector::maxPicks(int64_t total_frames) const {
+    if (window_ == 0 || total_frames <= 0) {
+        return count_;
+    }
+    const int64_t windows = (total_frames + window_ - 1) / window_;
+    return std::max(count_, quota_ * static_cast<size_t>(windows));
+}
+
+void TemporalSelector::reserve(const Candidate& candidate) {
+    // Frames leave the windows for good, so the reserve only ever needs
+    // the best [count_] of them
+    std::optional<Candidate> dropped;
+    offer(reserve_, count_, candidate, dropped);
+}
+
+std::vector<TemporalSelector::Candidate> TemporalSelector::select() const {
+    std::vector<Candidate> picks;
+    for (const auto& entry : windows_) {
+        picks.insert(picks.end(), entry.second.begin(), entry.second.end());
+    }
+
+    if (picks.size() > count_) {
+        std::nth_element(picks.begin(), picks.begin() + count_, picks.end(), better);
+        picks.resize(count_);
+    } else if (picks.size() < count_) {
+        std::vector<Candidate> extra = reserve_;
+        const size_t missing = std::min(count_ - picks.size(), extra.size());
+        std::partial_sort(extra.begin(), extra.begin() + missing, extra.end(), better);
+        picks.insert(picks.end(), extra.begin(), extra.begin() + missing);
+    }
+
+    std::sort(picks.begin(), picks.end(), better);
+    return picks;
+}
+
+size_t TemporalSelector::defaultQuota(size_t count, int64_t window, int64_t total_frames) {
+    if (window <= 0 || total_frames <= 0) {
+        return count;
+    }
+    const double windows = std::ceil(static_cast<double>(total_frames) / static_cast<double>(window));
+    return std::max<size_t>(static_cast<size_t>(std::ceil(2.0 * static_cast<double>(count) / windows)), 1);
+}
+
+} // namespace planetary
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace planetary {
+
+/// Picks the best frames of a capture while spreading them over time.
+///
+/// The capture is cut into windows of [window] consecutive frame numbers
+/// and each window contributes at most [quota] frames, so one brief spell
+/// of good seeing can't fill the whole stack. Every window keeps its best
+/// [quota] frames in a bounded heap as scores arrive (in any order), which
+/// makes add() O(log quota) and leaves the selection ready as soon as the
+/// last score is in. Frames pushed out of their window go to a reserve of
+/// the best [count] such frames, which tops the selection up when the
+/// windows alone can't fill it (short captures, tight quotas).
+///
+/// Ties favour the earlier frame, so the result doesn't depend on the
+/// order scores arrive in. Not thread-safe; callers serialise add().
+class TemporalSelector {
+public:
+    struct Candidate {
+        int64_t index;  // Frame index in the video
+        double score;   // Higher = better (Laplacian variance)
+    };
+
+    TemporalSelector() = default;
+
+    /// Select [count] frames, at most [quota] from every [window] frames
+    /// (window 0 = no spreading, plain top-[count])
+    TemporalSelector(size_t count, int64_t window, size_t quota);
+
+    /// Offer frame [index]. True if it is currently one of its window's
+    /// picks; false if it can at best fill in from the reserve. A frame it
+    /// pushes out of the window's picks is written to [displaced] (-1 if
+    /// none).
+    bool add(int64_t index, double score, int64_t* displaced = nullptr);
+
+    /// Whether frame [index] is currently one of its window's picks
+    bool picked(int64_t index) const;
+
+    /// Most frames the windows can pick at once over [total_frames]
+    /// frames ([count] when the length is unknown)
+    size_t maxPicks(int64_t total_frames) const;
+
+    /// The selection, best first
+    std::vector<Candidate> select() const;
+
+    size_t count() const { return count_; }
+
+    /// A quota letting each [window] hold twice its even share of [count]
+    /// frames out of [total_frames] (no cap when the length is unknown)
+    static size_t defaultQuota(size_t count, int64_t window, int64_t total_frames);
+
+private:
+    void reserve(const Candidate& candidate);
+
+    size_t count_ = 0;
+    int64_t window_ = 0;
+    size_t quota_ = 0;
+
+    // Worst candidate at the front of each heap
+    std::unordered_map<int64_t, std::vector<Candidate>> windows_;
+    std::vector<Candidate> reserve_;
+};
+
+} // namespace planetary
@@ -0,0 +1,150 @@
+#include "PlanetDetector.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <opencv2/imgproc.hpp>
+
+namespace planetary {
+
+namespace {
+
+// Detection runs on a copy no larger than this on its longest side
+constexpr int kDetectionSize = 480;
+
+// Smallest contour (in detection pixels) taken for a disk; below this
+// Otsu has most likely picked up noise
+constexpr double kMinDiskArea = 9.0;
+
+// A "disk" covering more of the frame than this is more likely haze or a
+// brightness gradient, so Hough gets a chance to do better
+constexpr double kMaxDiskFraction = 0.8;
+
+cv::Rect scaleRect(const cv::Rect& r, int scale) {
+    return cv::Rect(r.x * scale, r.y * scale, r.width * scale, r.height * scale);
+}
+
+} // namespace
+
+PlanetDetector::Detection PlanetDetector::detect(const cv::Mat& gray) {
+    Detection result;
+    if (gray.empty()) {
+        return result;
+    }
+
+    const int longest = std::max(gray.cols, gray.rows);
+    const int scale = std::max(1, (longest + kDetectionSize - 1) / kDetectionSize);
+    cv::Mat small;
+    if (scale > 1) {
+        cv::resize(gray, small, cv::Size(std::max(gray.cols / scale, 1), std::max(gray.rows / scale, 1)),
+                   0, 0, cv::INTER_AREA);
+    } else {
+        small = gray;
+    }
+
+    // Light blur so noise and hot pixels don't split the disk into specks
+    cv::Mat blurred;
+    cv::GaussianBlur(small, blurred, cv::Size(5, 5), 0);
+
+    cv::Mat binary;
+    result.threshold = cv::threshold(blurred, binary, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+
+    std::vector<std::vector<cv::Point>> contours;
+    cv::findContours(binary, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+    double largest_area = 0.0;
+    cv::Rect box;
+    for (const auto& contour : contours) {
+        const double area = cv::contourArea(contour);
+        if (area > largest_area) {
+            largest_area = area;
+            box = cv::boundingRect(contour);
+        }
+    }
+
+    const cv::Rect bounds(0, 0, small.cols, small.rows);
+    const bool plausible = largest_area >= kMinDiskArea &&
+                           box.area() < kMaxDiskFraction * bounds.area();
+    if (!plausible) {
+        std::vector<cv::Vec3f> circles;
+        cv::HoughCircles(blurred, circles, cv::HOUGH_GRADIENT, 1.0, small.rows,
+                         100, 30, std::max(small.rows / 40, 2), 0);
+        if (!circles.empty()) {
+            const cv::Vec3f& c = circles.front();
+            const int radius = static_cast<int>(std::ceil(c[2]));
+            box = cv::Rect(static_cast<int>(c[0]) - radius, static_cast<int>(c[1]) - radius,
+                           2 * radius, 2 * radius) & bounds;
+        } else if (largest_area < kMinDiskArea) {
+            box = cv::Rect();
+        }
+        // Otherwise keep the large contour: the Moon or Sun can fill the frame
+    }
+
+    if (box.area() > 0) {
+        result.box = scaleRect(box, scale) & cv::Rect(0, 0, gray.cols, gray.rows);
+    }
+    return result;
+}
+
+cv::Rect PlanetDetector::recentre(const cv::Mat& window, const cv::Point& origin,
+                                  const cv::Rect& box, double threshold) {
+    if (window.empty()) {
+        return box;
+    }
+
+    cv::Mat mask;
+    cv::threshold(window, mask, threshold, 255, cv::THRESH_BINARY);
+    const cv::Moments m = cv::moments(mask, true);
+    if (m.m00 <= 0) {
+        return box;
+    }
+
+    const double cx = origin.x + m.m10 / m.m00;
+    const double cy = origin.y + m.m01 / m.m00;
+    return cv::Rect(static_cast<int>(std::lround(cx - box.width / 2.0)),
+                    static_cast<int>(std::lround(cy - box.height / 2.0)),
+                    box.width, box.height);
+}
+
+cv::Rect PlanetDetector::expand(const cv::Rect& box, double margin, const cv::Size& frame) {
+    const double width = box.width * margin;
+    const double height = box.height * margin;
+    const double cx = box.x + box.width / 2.0;
+    const double cy = box.y + box.height / 2.0;
+    const cv::Rect grown(static_cast<int>(std::lround(cx - width / 2.0)),
+                         static_cast<int>(std::lround(cy - height / 2.0)),
+                         static_cast<int>(std::lround(width)),
+                         static_cast<int>(std::lround(height)));
+    return grown & cv::Rect(0, 0, frame.width, frame.height);
+}
+
+PlanetTracker::PlanetTracker(const cv::Size& frame_size, int redetect_interval, double margin)
+    : frame_size_(frame_size),
+      redetect_interval_(std::max(redetect_interval, 1)),
+      margin_(std::max(margin, 1.0)) {}
+
+cv::Rect PlanetTracker::update(int64_t index, const LumaSource& luma) {
+    const cv::Rect frame(0, 0, frame_size_.width, frame_size_.height);
+    const bool redetect = detected_at_ < 0 || index < last_index_ ||
+                          index - detected_at_ >= redetect_interval_;
+    last_index_ = index;
+
+    if (redetect) {
+        const PlanetDetector::Detection detection = PlanetDetector::detect(luma(cv::Rect()));
+        box_ = detection.box;
+        threshold_ = detection.threshold;
+        detected_at_ = index;
+    } else if (box_.area() > 0) {
+        // Follow the disk within the region scored last time
+        const cv::Rect window = PlanetDetector::expand(box_, margin_, frame_size_);
+        if (window.area() > 0) {
+            box_ = PlanetDetector::recentre(luma(window), window.tl(), box_, threshold_);
+        }
+    }
+
+    const cv::Rect roi = box_.area() > 0 ? PlanetDetector::expand(box_, margin_, frame_size_) : cv::Rect();
+    return roi.area() > 0 ? roi : frame;
+}
+
+} // namespace planetary
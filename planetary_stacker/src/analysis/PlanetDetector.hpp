@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include <opencv2/core.hpp>
+
+namespace planetary {
+
+/// Finds the planetary disk in a frame.
+///
+/// Otsu thresholding separates the disk from the sky and the largest
+/// outer contour is taken as the planet; when that is implausible
+/// (nothing found, or "bright" covers most of the frame as with haze or a
+/// gradient) a Hough circle search is tried instead. Works on a reduced
+/// copy of the frame, so detection costs a fraction of a scoring pass.
+class PlanetDetector {
+public:
+    struct Detection {
+        cv::Rect box;           // Disk bounding box (empty when not found)
+        double threshold = 0;   // Otsu level separating disk from sky
+    };
+
+    /// Detect the disk in 8-bit grayscale [gray]
+    static Detection detect(const cv::Mat& gray);
+
+    /// Shift [box] so it is centred on the centroid of the pixels above
+    /// [threshold] in [window] (a grayscale crop whose top-left corner is
+    /// at [origin] in frame coordinates). Returns [box] unchanged when the
+    /// window holds no disk pixels.
+    static cv::Rect recentre(const cv::Mat& window, const cv::Point& origin,
+                             const cv::Rect& box, double threshold);
+
+    /// [box] grown by [margin] about its centre, clipped to [frame]
+    static cv::Rect expand(const cv::Rect& box, double margin, const cv::Size& frame);
+};
+
+/// Keeps the region to score on the planet through a capture.
+///
+/// Runs full detection on the first frame and again every
+/// [redetect_interval] frames; in between the box just follows the
+/// centroid of the disk pixels inside the previous (expanded) region,
+/// which only touches that region. Frames must arrive in increasing
+/// order; a jump backwards or past the interval triggers detection.
+class PlanetTracker {
+public:
+    /// Returns the 8-bit luma of a frame region (frame coordinates); an
+    /// empty rect asks for the whole frame
+    using LumaSource = std::function<cv::Mat(const cv::Rect&)>;
+
+    PlanetTracker(const cv::Size& frame_size, int redetect_interval, double margin);
+
+    /// Region of frame [index] to score: the planet box grown by the
+    /// margin, or the whole frame when no planet is found
+    cv::Rect update(int64_t index, const LumaSource& luma);
+
+private:
+    cv::Size frame_size_;
+    int redetect_interval_;
+    double margin_;
+
+    cv::Rect box_;
+    double threshold_ = 0;
+    int64_t detected_at_ = -1;
+    int64_t last_index_ = -1;
+};
+
+} // namespace planetary
@@ -0,0 +1,503 @@
+#include "QualityKernels.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PS_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PS_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace planetary {
+
+namespace {
+
+using Sums = QualityKernels::Sums;
+using Plane = QualityKernels::Plane;
+
+// Vector iterations between flushes of the 32-bit lanes. Each lane gains
+// at most 2 * 2 * 1020² (gx² + gy² over two pixels) per iteration, so 256
+// iterations stay below 2^31.
+constexpr int kFlushInterval = 256;
+
+// BORDER_REFLECT_101 for rows: -1 -> 1, n -> n - 2
+inline int reflect101(int i, int n) {
+    if (n == 1) {
+        return 0;
+    }
+    if (i < 0) {
+        return -i;
+    }
+    if (i >= n) {
+        return 2 * n - 2 - i;
+    }
+    return i;
+}
+
+// Row y of a plane with its (reflected) neighbours
+struct Rows {
+    const uint8_t* up;
+    const uint8_t* row;
+    const uint8_t* down;
+};
+
+inline Rows rowsAt(const Plane& plane, int y) {
+    return {plane.data + reflect101(y - 1, plane.rows) * plane.step,
+            plane.data + y * plane.step,
+            plane.data + reflect101(y + 1, plane.rows) * plane.step};
+}
+
+// Columns of a block: the plane's edge columns (reflected neighbours) are
+// scalar, the interior [begin, end) goes to the vector kernels
+struct Span {
+    int y0;
+    int y1;
+    bool left;
+    bool right;
+    int begin;
+    int end;
+};
+
+// --- Scalar reference -------------------------------------------------------
+
+inline void accumulatePixel(const Rows& r3, int l, int x, int r, Sums& sums) {
+    const uint8_t* up = r3.up;
+    const uint8_t* row = r3.row;
+    const uint8_t* down = r3.down;
+    const int c = row[x];
+    const int laplacian = up[x] + down[x] + row[l] + row[r] - 4 * c;
+    const int gx = (up[r] + 2 * row[r] + down[r]) - (up[l] + 2 * row[l] + down[l]);
+    const int gy = (down[l] + 2 * down[x] + down[r]) - (up[l] + 2 * up[x] + up[r]);
+
+    sums.laplacian += laplacian;
+    sums.laplacian_sq += static_cast<uint32_t>(laplacian * laplacian);
+    sums.gradient_sq += static_cast<uint32_t>(gx * gx + gy * gy);
+    sums.pixel += static_cast<uint32_t>(c);
+    sums.pixel_sq += static_cast<uint32_t>(c * c);
+}
+
+inline void edgePixels(const Rows& rows, const Plane& plane, const Span& span, Sums& sums) {
+    if (plane.cols == 1) {
+        accumulatePixel(rows, 0, 0, 0, sums);
+        return;
+    }
+    if (span.left) {
+        accumulatePixel(rows, 1, 0, 1, sums);
+    }
+    if (span.right) {
+        accumulatePixel(rows, plane.cols - 2, plane.cols - 1, plane.cols - 2, sums);
+    }
+}
+
+// Interior columns [begin, end): both neighbours are in the row
+inline void interiorScalar(const Rows& rows, int begin, int end, Sums& sums) {
+    for (int x = begin; x < end; ++x) {
+        accumulatePixel(rows, x - 1, x, x + 1, sums);
+    }
+}
+
+void blockScalar(const Plane& plane, const Span& span, Sums& sums) {
+    for (int y = span.y0; y < span.y1; ++y) {
+        const Rows rows = rowsAt(plane, y);
+        edgePixels(rows, plane, span, sums);
+        interiorScalar(rows, span.begin, span.end, sums);
+    }
+}
+
+// Add the 32-bit lanes of [lanes] to the 64-bit totals
+template <int N>
+void addLanes(const int32_t (&laplacian)[N], const int32_t (&laplacian_sq)[N],
+              const int32_t (&gradient_sq)[N], const int32_t (&pixel)[N],
+              const int32_t (&pixel_sq)[N], Sums& sums) {
+    for (int i = 0; i < N; ++i) {
+        sums.laplacian += laplacian[i];
+        sums.laplacian_sq += static_cast<uint32_t>(laplacian_sq[i]);
+        sums.gradient_sq += static_cast<uint32_t>(gradient_sq[i]);
+        sums.pixel += static_cast<uint32_t>(pixel[i]);
+        sums.pixel_sq += static_cast<uint32_t>(pixel_sq[i]);
+    }
+}
+
+#ifdef PS_SIMD_X86
+
+// --- SSE4.1: 8 pixels per iteration -----------------------------------------
+
+// Running 32-bit sums, kept across the rows of a block
+struct Sse41Lanes {
+    __m128i laplacian;
+    __m128i laplacian_sq;
+    __m128i gradient_sq;
+    __m128i pixel;
+    __m128i pixel_sq;
+    int iterations;
+};
+
+__attribute__((target("sse4.1")))
+inline void clearLanes(Sse41Lanes& lanes) {
+    lanes.laplacian = lanes.laplacian_sq = lanes.gradient_sq = _mm_setzero_si128();
+    lanes.pixel = lanes.pixel_sq = _mm_setzero_si128();
+    lanes.iterations = 0;
+}
+
+__attribute__((target("sse4.1")))
+void flushLanes(Sse41Lanes& lanes, Sums& sums) {
+    int32_t l[4], lsq[4], gsq[4], p[4], psq[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(l), lanes.laplacian);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lsq), lanes.laplacian_sq);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(gsq), lanes.gradient_sq);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), lanes.pixel);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(psq), lanes.pixel_sq);
+    addLanes(l, lsq, gsq, p, psq, sums);
+    clearLanes(lanes);
+}
+
+__attribute__((target("sse4.1")))
+inline __m128i load8(const uint8_t* p) {
+    return _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+}
+
+// Vector part of [begin, end); returns the first column left over
+__attribute__((target("sse4.1")))
+inline int interiorSse41(const Rows& rows, int begin, int end, Sse41Lanes& lanes, Sums& sums) {
+    const uint8_t* up = rows.up;
+    const uint8_t* row = rows.row;
+    const uint8_t* down = rows.down;
+    const __m128i ones = _mm_set1_epi16(1);
+
+    int x = begin;
+    for (; x + 8 <= end; x += 8) {
+        const __m128i ul = load8(up + x - 1), u = load8(up + x), ur = load8(up + x + 1);
+        const __m128i l = load8(row + x - 1), c = load8(row + x), r = load8(row + x + 1);
+        const __m128i dl = load8(down + x - 1), d = load8(down + x), dr = load8(down + x + 1);
+
+        const __m128i laplacian = _mm_sub_epi16(
+            _mm_add_epi16(_mm_add_epi16(u, d), _mm_add_epi16(l, r)), _mm_slli_epi16(c, 2));
+        const __m128i gx = _mm_sub_epi16(
+            _mm_add_epi16(_mm_add_epi16(ur, dr), _mm_slli_epi16(r, 1)),
+            _mm_add_epi16(_mm_add_epi16(ul, dl), _mm_slli_epi16(l, 1)));
+        const __m128i gy = _mm_sub_epi16(
+            _mm_add_epi16(_mm_add_epi16(dl, dr), _mm_slli_epi16(d, 1)),
+            _mm_add_epi16(_mm_add_epi16(ul, ur), _mm_slli_epi16(u, 1)));
+
+        lanes.laplacian = _mm_add_epi32(lanes.laplacian, _mm_madd_epi16(laplacian, ones));
+        lanes.laplacian_sq = _mm_add_epi32(lanes.laplacian_sq, _mm_madd_epi16(laplacian, laplacian));
+        lanes.gradient_sq = _mm_add_epi32(lanes.gradient_sq,
+            _mm_add_epi32(_mm_madd_epi16(gx, gx), _mm_madd_epi16(gy, gy)));
+        lanes.pixel = _mm_add_epi32(lanes.pixel, _mm_madd_epi16(c, ones));
+        lanes.pixel_sq = _mm_add_epi32(lanes.pixel_sq, _mm_madd_epi16(c, c));
+
+        if (++lanes.iterations == kFlushInterval) {
+            flushLanes(lanes, sums);
+        }
+    }
+    return x;
+}
+
+__attribute__((target("sse4.1")))
+void blockSse41(const Plane& plane, const Span& span, Sums& sums) {
+    Sse41Lanes lanes;
+    clearLanes(lanes);
+    for (int y = span.y0; y < span.y1; ++y) {
+        const Rows rows = rowsAt(plane, y);
+        edgePixels(rows, plane, span, sums);
+        const int x = interiorSse41(rows, span.begin, span.end, lanes, sums);
+        interiorScalar(rows, x, span.end, sums);
+    }
+    flushLanes(lanes, sums);
+}
+
+// --- AVX2: 16 pixels per iteration ------------------------------------------
+
+struct Avx2Lanes {
+    __m256i laplacian;
+    __m256i laplacian_sq;
+    __m256i gradient_sq;
+    __m256i pixel;
+    __m256i pixel_sq;
+    int iterations;
+};
+
+__attribute__((target("avx2")))
+inline void clearLanes(Avx2Lanes& lanes) {
+    lanes.laplacian = lanes.laplacian_sq = lanes.gradient_sq = _mm256_setzero_si256();
+    lanes.pixel = lanes.pixel_sq = _mm256_setzero_si256();
+    lanes.iterations = 0;
+}
+
+__attribute__((target("avx2")))
+void flushLanes(Avx2Lanes& lanes, Sums& sums) {
+    int32_t l[8], lsq[8], gsq[8], p[8], psq[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(l), lanes.laplacian);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lsq), lanes.laplacian_sq);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(gsq), lanes.gradient_sq);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), lanes.pixel);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(psq), lanes.pixel_sq);
+    addLanes(l, lsq, gsq, p, psq, sums);
+    clearLanes(lanes);
+}
+
+// 16 pixels, or 8 zero-extended to 16 lanes: zero lanes have zero
+// responses, so the half step adds nothing for them
+template <bool kHalf>
+__attribute__((target("avx2")))
+inline __m256i load16(const uint8_t* p) {
+    const __m128i bytes = kHalf ? _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))
+                                : _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    return _mm256_cvtepu8_epi16(bytes);
+}
+
+template <bool kHalf>
+__attribute__((target("avx2")))
+inline void stepAvx2(const Rows& rows, int x, Avx2Lanes& lanes, Sums& sums) {
+    const uint8_t* up = rows.up;
+    const uint8_t* row = rows.row;
+    const uint8_t* down = rows.down;
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    const __m256i ul = load16<kHalf>(up + x - 1), u = load16<kHalf>(up + x), ur = load16<kHalf>(up + x + 1);
+    const __m256i l = load16<kHalf>(row + x - 1), c = load16<kHalf>(row + x), r = load16<kHalf>(row + x + 1);
+    const __m256i dl = load16<kHalf>(down + x - 1), d = load16<kHalf>(down + x), dr = load16<kHalf>(down + x + 1);
+
+    const __m256i laplacian = _mm256_sub_epi16(
+        _mm256_add_epi16(_mm256_add_epi16(u, d), _mm256_add_epi16(l, r)), _mm256_slli_epi16(c, 2));
+    const __m256i gx = _mm256_sub_epi16(
+        _mm256_add_epi16(_mm256_add_epi16(ur, dr), _mm256_slli_epi16(r, 1)),
+        _mm256_add_epi16(_mm256_add_epi16(ul, dl), _mm256_slli_epi16(l, 1)));
+    const __m256i gy = _mm256_sub_epi16(
+        _mm256_add_epi16(_mm256_add_epi16(dl, dr), _mm256_slli_epi16(d, 1)),
+        _mm256_add_epi16(_mm256_add_epi16(ul, ur), _mm256_slli_epi16(u, 1)));
+
+    lanes.laplacian = _mm256_add_epi32(lanes.laplacian, _mm256_madd_epi16(laplacian, ones));
+    lanes.laplacian_sq = _mm256_add_epi32(lanes.laplacian_sq, _mm256_madd_epi16(laplacian, laplacian));
+    lanes.gradient_sq = _mm256_add_epi32(lanes.gradient_sq,
+        _mm256_add_epi32(_mm256_madd_epi16(gx, gx), _mm256_madd_epi16(gy, gy)));
+    lanes.pixel = _mm256_add_epi32(lanes.pixel, _mm256_madd_epi16(c, ones));
+    lanes.pixel_sq = _mm256_add_epi32(lanes.pixel_sq, _mm256_madd_epi16(c, c));
+
+    if (++lanes.iterations == kFlushInterval) {
+        flushLanes(lanes, sums);
+    }
+}
+
+__attribute__((target("avx2")))
+void blockAvx2(const Plane& plane, const Span& span, Sums& sums) {
+    Avx2Lanes lanes;
+    clearLanes(lanes);
+    for (int y = span.y0; y < span.y1; ++y) {
+        const Rows rows = rowsAt(plane, y);
+        edgePixels(rows, plane, span, sums);
+        int x = span.begin;
+        for (; x + 16 <= span.end; x += 16) {
+            stepAvx2<false>(rows, x, lanes, sums);
+        }
+        // A half step takes the next 8 columns before the scalar tail
+        if (x + 8 <= span.end) {
+            stepAvx2<true>(rows, x, lanes, sums);
+            x += 8;
+        }
+        interiorScalar(rows, x, span.end, sums);
+    }
+    flushLanes(lanes, sums);
+}
+
+#endif // PS_SIMD_X86
+
+#ifdef PS_SIMD_NEON
+
+// --- NEON: 8 pixels per iteration -------------------------------------------
+
+struct NeonLanes {
+    int32x4_t laplacian;
+    int32x4_t laplacian_sq;
+    int32x4_t gradient_sq;
+    int32x4_t pixel;
+    int32x4_t pixel_sq;
+    int iterations;
+};
+
+inline void clearLanes(NeonLanes& lanes) {
+    lanes.laplacian = lanes.laplacian_sq = lanes.gradient_sq = vdupq_n_s32(0);
+    lanes.pixel = lanes.pixel_sq = vdupq_n_s32(0);
+    lanes.iterations = 0;
+}
+
+void flushLanes(NeonLanes& lanes, Sums& sums) {
+    int32_t l[4], lsq[4], gsq[4], p[4], psq[4];
+    vst1q_s32(l, lanes.laplacian);
+    vst1q_s32(lsq, lanes.laplacian_sq);
+    vst1q_s32(gsq, lanes.gradient_sq);
+    vst1q_s32(p, lanes.pixel);
+    vst1q_s32(psq, lanes.pixel_sq);
+    addLanes(l, lsq, gsq, p, psq, sums);
+    clearLanes(lanes);
+}
+
+inline int16x8_t load8(const uint8_t* p) {
+    return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)));
+}
+
+inline int32x4_t squareAccumulate(int32x4_t acc, int16x8_t v) {
+    acc = vmlal_s16(acc, vget_low_s16(v), vget_low_s16(v));
+    return vmlal_s16(acc, vget_high_s16(v), vget_high_s16(v));
+}
+
+inline int interiorNeon(const Rows& rows, int begin, int end, NeonLanes& lanes, Sums& sums) {
+    const uint8_t* up = rows.up;
+    const uint8_t* row = rows.row;
+    const uint8_t* down = rows.down;
+
+    int x = begin;
+    for (; x + 8 <= end; x += 8) {
+        const int16x8_t ul = load8(up + x - 1), u = load8(up + x), ur = load8(up + x + 1);
+        const int16x8_t l = load8(row + x - 1), c = load8(row + x), r = load8(row + x + 1);
+        const int16x8_t dl = load8(down + x - 1), d = load8(down + x), dr = load8(down + x + 1);
+
+        const int16x8_t laplacian = vsubq_s16(
+            vaddq_s16(vaddq_s16(u, d), vaddq_s16(l, r)), vshlq_n_s16(c, 2));
+        const int16x8_t gx = vsubq_s16(
+            vaddq_s16(vaddq_s16(ur, dr), vshlq_n_s16(r, 1)),
+            vaddq_s16(vaddq_s16(ul, dl), vshlq_n_s16(l, 1)));
+        const int16x8_t gy = vsubq_s16(
+            vaddq_s16(vaddq_s16(dl, dr), vshlq_n_s16(d, 1)),
+            vaddq_s16(vaddq_s16(ul, ur), vshlq_n_s16(u, 1)));
+
+        lanes.laplacian = vpadalq_s16(lanes.laplacian, laplacian);
+        lanes.laplacian_sq = squareAccumulate(lanes.laplacian_sq, laplacian);
+        lanes.gradient_sq = squareAccumulate(squareAccumulate(lanes.gradient_sq, gx), gy);
+        lanes.pixel = vpadalq_s16(lanes.pixel, c);
+        lanes.pixel_sq = squareAccumulate(lanes.pixel_sq, c);
+
+        if (++lanes.iterations == kFlushInterval) {
+            flushLanes(lanes, sums);
+        }
+    }
+    return x;
+}
+
+void blockNeon(const Plane& plane, const Span& span, Sums& sums) {
+    NeonLanes lanes;
+    clearLanes(lanes);
+    for (int y = span.y0; y < span.y1; ++y) {
+        const Rows rows = rowsAt(plane, y);
+        edgePixels(rows, plane, span, sums);
+        const int x = interiorNeon(rows, span.begin, span.end, lanes, sums);
+        interiorScalar(rows, x, span.end, sums);
+    }
+    flushLanes(lanes, sums);
+}
+
+#endif // PS_SIMD_NEON
+
+QualityKernels::Isa detectIsa() {
+#ifdef PS_SIMD_NEON
+    return QualityKernels::Isa::kNeon;
+#elif defined(PS_SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return QualityKernels::Isa::kAvx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return QualityKernels::Isa::kSse41;
+    }
+    return QualityKernels::Isa::kScalar;
+#else
+    return QualityKernels::Isa::kScalar;
+#endif
+}
+
+std::atomic<QualityKernels::Isa> g_active_isa{QualityKernels::bestIsa()};
+
+void accumulateWith(QualityKernels::Isa isa, const Plane& plane, int x0, int y0, int x1, int y1,
+                    Sums& sums) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, plane.cols);
+    y1 = std::min(y1, plane.rows);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    // Reflected edge columns: -1 -> 1, cols -> cols - 2
+    const Span span{y0, y1, x0 == 0, x1 == plane.cols && plane.cols > 1,
+                    std::max(x0, 1), std::max(std::min(x1, plane.cols - 1), 1)};
+
+    switch (isa) {
+#ifdef PS_SIMD_X86
+        case QualityKernels::Isa::kAvx2:
+            blockAvx2(plane, span, sums);
+            break;
+        case QualityKernels::Isa::kSse41:
+            blockSse41(plane, span, sums);
+            break;
+#endif
+#ifdef PS_SIMD_NEON
+        case QualityKernels::Isa::kNeon:
+            blockNeon(plane, span, sums);
+            break;
+#endif
+        default:
+            blockScalar(plane, span, sums);
+            break;
+    }
+}
+
+} // namespace
+
+QualityKernels::Isa QualityKernels::bestIsa() {
+    static const Isa best = detectIsa();
+    return best;
+}
+
+QualityKernels::Isa QualityKernels::activeIsa() {
+    return g_active_isa.load(std::memory_order_relaxed);
+}
+
+bool QualityKernels::isSupported(Isa isa) {
+    const Isa best = bestIsa();
+    switch (isa) {
+        case Isa::kScalar: return true;
+        case Isa::kSse41:  return best == Isa::kSse41 || best == Isa::kAvx2;
+        case Isa::kAvx2:   return best == Isa::kAvx2;
+        case Isa::kNeon:   return best == Isa::kNeon;
+    }
+    return false;
+}
+
+void QualityKernels::setActiveIsa(Isa isa) {
+    if (!isSupported(isa)) {
+        // Running it would fault on the first illegal instruction
+        throw std::invalid_argument(std::string("Kernels not supported here: ") + isaName(isa));
+    }
+    g_active_isa.store(isa, std::memory_order_relaxed);
+}
+
+const char* QualityKernels::isaName(Isa isa) {
+    switch (isa) {
+        case Isa::kSse41: return "sse4.1";
+        case Isa::kAvx2:  return "avx2";
+        case Isa::kNeon:  return "neon";
+        default:          return "scalar";
+    }
+}
+
+void QualityKernels::accumulate(const Plane& plane, int x0, int y0, int x1, int y1, Sums& sums) {
+    // The active Isa was checked when it was set
+    accumulateWith(activeIsa(), plane, x0, y0, x1, y1, sums);
+}
+
+void QualityKernels::accumulate(Isa isa, const Plane& plane, int x0, int y0, int x1, int y1,
+                                Sums& sums) {
+    if (!isSupported(isa)) {
+        throw std::invalid_argument(std::string("Kernels not supported here: ") + isaName(isa));
+    }
+    accumulateWith(isa, plane, x0, y0, x1, y1, sums);
+}
+
+} // namespace planetary
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace planetary {
+
+/// Vectorised inner loops of QualityMetrics::compute().
+///
+/// The 3x3 Laplacian and Sobel responses of 8-bit input fit in int16, so
+/// the kernels work on 16-bit lanes and fold squares into 32-bit lanes
+/// with multiply-add, flushing to 64-bit totals before they can overflow.
+/// All sums are exact integers, so every implementation is bit-exact with
+/// the scalar reference.
+///
+/// The implementation is picked at runtime from what the CPU supports
+/// (SSE4.1/AVX2 on x86, NEON on ARM), so one binary runs everywhere.
+class QualityKernels {
+public:
+    enum class Isa { kScalar, kSse41, kAvx2, kNeon };
+
+    /// Exact sums over the pixels of a frame
+    struct Sums {
+        int64_t laplacian = 0;
+        uint64_t laplacian_sq = 0;
+        uint64_t gradient_sq = 0;    // gx² + gy²
+        uint64_t pixel = 0;
+        uint64_t pixel_sq = 0;
+    };
+
+    /// Best instruction set supported by this CPU (detected once)
+    static Isa bestIsa();
+
+    /// Whether this build and CPU can run [isa]
+    static bool isSupported(Isa isa);
+
+    /// Isa used by accumulate() without an explicit choice
+    static Isa activeIsa();
+
+    /// Restrict the default to [isa], for comparing implementations
+    /// (stacker_analyze --check-kernels). Throws std::invalid_argument if
+    /// [isa] is not supported.
+    static void setActiveIsa(Isa isa);
+
+    static const char* isaName(Isa isa);
+
+    /// 8-bit grayscale pixels the kernels read
+    struct Plane {
+        const uint8_t* data = nullptr;
+        size_t step = 0;    // Bytes between rows
+        int rows = 0;
+        int cols = 0;
+    };
+
+    /// Add the responses of the pixels in rows [y0, y1) and columns
+    /// [x0, x1) of [plane] to [sums]. Neighbours come from the rest of the
+    /// plane; only its own edges reflect like BORDER_REFLECT_101, so a
+    /// plane split into blocks sums to exactly the same totals as one
+    /// call over the whole plane. Lanes are flushed once per block.
+    static void accumulate(const Plane& plane, int x0, int y0, int x1, int y1, Sums& sums);
+
+    /// Same with the implementation for [isa]; throws
+    /// std::invalid_argument if it is not supported
+    static void accumulate(Isa isa, const Plane& plane, int x0, int y0, int x1, int y1,
+                           Sums& sums);
+};
+
+} // namespace planetary
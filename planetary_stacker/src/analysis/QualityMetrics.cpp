@@ -0,0 +1,102 @@
+#include "QualityMetrics.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#include <opencv2/imgproc.hpp>
+
+#include "QualityKernels.hpp"
+
+namespace planetary {
+
+namespace {
+
+// White noise of variance s² gives a mean squared Laplacian of 20 s²
+// (kernel taps 1, 1, 1, 1, -4)
+constexpr double kLaplacianNoiseGain = 20.0;
+
+// Metrics of [n] pixels from their exact sums
+QualityMetrics::Metrics fromSums(const QualityKernels::Sums& sums, double n) {
+    QualityMetrics::Metrics metrics;
+    const double laplacian_mean = sums.laplacian / n;
+    const double laplacian_energy = sums.laplacian_sq / n;
+    metrics.laplacian_variance = laplacian_energy - laplacian_mean * laplacian_mean;
+    metrics.gradient_energy = sums.gradient_sq / n;
+
+    const double pixel_mean = sums.pixel / n;
+    const double pixel_variance = sums.pixel_sq / n - pixel_mean * pixel_mean;
+    metrics.high_frequency_ratio = pixel_variance > 0
+        ? laplacian_energy / (kLaplacianNoiseGain * pixel_variance)
+        : 0.0;
+    return metrics;
+}
+
+void add(QualityKernels::Sums& total, const QualityKernels::Sums& part) {
+    total.laplacian += part.laplacian;
+    total.laplacian_sq += part.laplacian_sq;
+    total.gradient_sq += part.gradient_sq;
+    total.pixel += part.pixel;
+    total.pixel_sq += part.pixel_sq;
+}
+
+} // namespace
+
+QualityMetrics::Metrics QualityMetrics::compute(const cv::Mat& img, const cv::Rect& roi) {
+    TileMap tiles;
+    return compute(img, roi, 0, tiles);
+}
+
+QualityMetrics::Metrics QualityMetrics::compute(const cv::Mat& img, const cv::Rect& roi,
+                                                int tile_size, TileMap& tiles) {
+    tiles.grid = cv::Size();
+    tiles.sharpness.clear();
+
+    cv::Mat gray;
+    if (img.channels() == 1) {
+        gray = img;
+    } else {
+        cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
+    }
+    if (roi.area() > 0) {
+        gray = gray(roi & cv::Rect(0, 0, gray.cols, gray.rows));
+    }
+    if (gray.empty()) {
+        return Metrics();
+    }
+
+    const QualityKernels::Plane plane{gray.data, gray.step, gray.rows, gray.cols};
+    const int tile = tile_size > 0 ? tile_size : std::max(gray.cols, gray.rows);
+    const int tiles_x = std::max(gray.cols / tile, 1);
+    const int tiles_y = std::max(gray.rows / tile, 1);
+    if (tile_size > 0) {
+        tiles.grid = cv::Size(tiles_x, tiles_y);
+        tiles.sharpness.reserve(static_cast<size_t>(tiles_x) * tiles_y);
+    }
+
+    // Exact integer sums: 8-bit input keeps every response small enough
+    // that 64-bit totals cannot overflow on any frame size. The tiles
+    // partition the region, so their sums add up to the global ones.
+    QualityKernels::Sums total;
+    for (int ty = 0; ty < tiles_y; ++ty) {
+        const int y0 = ty * tile;
+        const int y1 = ty + 1 < tiles_y ? y0 + tile : gray.rows;
+        for (int tx = 0; tx < tiles_x; ++tx) {
+            const int x0 = tx * tile;
+            const int x1 = tx + 1 < tiles_x ? x0 + tile : gray.cols;
+            QualityKernels::Sums sums;
+            QualityKernels::accumulate(plane, x0, y0, x1, y1, sums);
+            if (tile_size > 0) {
+                const double n = static_cast<double>(x1 - x0) * (y1 - y0);
+                tiles.sharpness.push_back(static_cast<float>(fromSums(sums, n).laplacian_variance));
+            }
+            add(total, sums);
+        }
+    }
+    return fromSums(total, static_cast<double>(gray.total()));
+}
+
+double QualityMetrics::computeLaplacianVariance(const cv::Mat& img) {
+    return compute(img).laplacian_variance;
+}
+
+} // namespace planetary
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+namespace planetary {
+
+/// Frame sharpness metrics
+class QualityMetrics {
+public:
+    struct Metrics {
+        /// Variance of the 3x3 Laplacian response (higher = sharper)
+        double laplacian_variance = 0.0;
+
+        /// Mean squared 3x3 Sobel gradient magnitude (gx² + gy²)
+        double gradient_energy = 0.0;
+
+        /// Share of the image's energy at high spatial frequencies: mean
+        /// squared Laplacian over 20x the pixel variance. By Parseval this
+        /// is the power spectrum weighted towards the Nyquist ring, without
+        /// an FFT; 0 for flat or smooth images, about 1 for pixel noise.
+        double high_frequency_ratio = 0.0;
+    };
+
+    /// Sharpness of each tile of the scored region
+    struct TileMap {
+        cv::Size grid;                  // Tiles across and down
+        std::vector<float> sharpness;   // Laplacian variance, row-major
+    };
+
+    /// All metrics in one pass over [img] (8-bit grayscale or BGR),
+    /// restricted to [roi] when it is non-empty.
+    ///
+    /// Laplacian and Sobel responses are formed per pixel in 16-bit SIMD
+    /// lanes and folded straight into integer sums (QualityKernels), so no
+    /// intermediate images are allocated. Borders are reflected like OpenCV's BORDER_REFLECT_101,
+    /// so laplacian_variance matches cv::Laplacian + cv::meanStdDev.
+    static Metrics compute(const cv::Mat& img, const cv::Rect& roi = cv::Rect());
+
+    /// compute() that also fills [tiles] from the same pass: the region is
+    /// split into [tile_size] pixel squares anchored at its top-left
+    /// corner (pixels left over at the right and bottom join the last
+    /// tile). Tiles are summed block by block, so the global metrics are
+    /// identical to compute()'s.
+    static Metrics compute(const cv::Mat& img, const cv::Rect& roi, int tile_size, TileMap& tiles);
+
+    /// Variance of the Laplacian response (higher = sharper).
+    /// Accepts 8-bit grayscale or BGR input.
+    static double computeLaplacianVariance(const cv::Mat& img);
+};
+
+} // namespace planetary
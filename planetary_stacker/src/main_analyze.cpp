@@ -0,0 +1,847 @@
+// stacker_analyze - desktop Pass 1 tool
+//
+// Usage: stacker_analyze <video> [--step N] [--top PERCENT]
+//        stacker_analyze --check-align | --check-kernels
+//        stacker_analyze --check-selector | --check-pool | --check-spool
+//        stacker_analyze --check-index | --check-cache
+//
+// Writes <video>_scores.csv (frame_index, score, roi) and prints the
+// selected frame indices. --check-align runs the aligner's known-shift
+// check instead, --check-kernels compares the SIMD quality kernels with
+// the scalar ones, --check-selector compares the temporal frame selector
+// with a brute-force reference, --check-pool exercises the work-stealing
+// pool, and --check-spool, --check-index and --check-cache round-trip the
+// frame spool, frame index and analysis cache formats; all exit non-zero
+// if they fail.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "alignment/GlobalAligner.hpp"
+#include "analysis/AnalysisCache.hpp"
+#include "analysis/FrameAnalyzer.hpp"
+#include "analysis/FrameSelector.hpp"
+#include "analysis/QualityKernels.hpp"
+#include "pipeline/WorkStealingPool.hpp"
+#include "video/FrameIndex.hpp"
+#include "video/FrameSpool.hpp"
+
+using namespace planetary;
+
+namespace {
+
+// Banded, limb-darkened disk of radius 60 centred at ([cx], [cy])
+cv::Mat renderDisk(const cv::Size& size, double cx, double cy) {
+    cv::Mat image(size.height, size.width, CV_8UC1);
+    for (int y = 0; y < size.height; ++y) {
+        auto* row = image.ptr<uint8_t>(y);
+        for (int x = 0; x < size.width; ++x) {
+            const double dx = x - cx, dy = y - cy;
+            const double edge = 1.0 / (1.0 + std::exp((std::sqrt(dx * dx + dy * dy) - 60.0) / 1.5));
+            const double detail = 0.7 + 0.2 * std::sin(dy * 0.3) + 0.1 * std::sin(dx * 0.2 + dy * 0.15);
+            row[x] = static_cast<uint8_t>(std::lround(20 + 200 * edge * detail));
+        }
+    }
+    return image;
+}
+
+// Known-shift check: a frame whose disk sits at a fixed offset from the
+// reference's must align by the opposite offset, the translation moving
+// it back onto the reference. A sign slip fails by twice the offset.
+int checkAlignment() {
+    const cv::Size size(320, 240);
+    const double offset_x = 6.5, offset_y = -3.25;
+    constexpr double kTolerance = 0.5;
+
+    const GlobalAligner aligner(renderDisk(size, 160, 120));
+    const auto shift = aligner.align(renderDisk(size, 160 + offset_x, 120 + offset_y));
+
+    const bool ok = std::abs(shift.dx + offset_x) <= kTolerance &&
+                    std::abs(shift.dy + offset_y) <= kTolerance;
+    std::cerr << "Global aligner: frame offset (" << offset_x << ", " << offset_y
+              << "), shift (" << shift.dx << ", " << shift.dy << ") "
+              << (ok ? "ok" : "FAILED") << "\n";
+    return ok ? 0 : 1;
+}
+
+bool sameSums(const QualityKernels::Sums& a, const QualityKernels::Sums& b) {
+    return a.laplacian == b.laplacian && a.laplacian_sq == b.laplacian_sq &&
+           a.gradient_sq == b.gradient_sq && a.pixel == b.pixel && a.pixel_sq == b.pixel_sq;
+}
+
+// Cross-ISA check: every kernel this CPU supports must give exactly the
+// scalar sums, over whole planes and over inner blocks (no reflected
+// edge), on widths around each vector length and on the pixel patterns
+// that stress the edge handling and the accumulator widths.
+int checkKernels() {
+    using Isa = QualityKernels::Isa;
+    const struct { int rows, cols; } sizes[] = {
+        {1, 1}, {1, 2}, {2, 3}, {3, 7}, {4, 15}, {5, 16}, {6, 17}, {7, 31},
+        {8, 33}, {9, 63}, {11, 65}, {64, 64}, {37, 129}, {3, 16385},
+    };
+    const char* patterns[] = {"random", "checker", "stripes", "extremes"};
+
+    std::vector<Isa> isas;
+    for (const Isa isa : {Isa::kSse41, Isa::kAvx2, Isa::kNeon}) {
+        if (QualityKernels::isSupported(isa)) {
+            isas.push_back(isa);
+        }
+    }
+
+    int failures = 0;
+    uint32_t seed = 12345;
+    for (const auto& size : sizes) {
+        // Padded rows so the kernels must honour the step
+        const size_t step = static_cast<size_t>(size.cols) + 3;
+        std::vector<uint8_t> pixels(step * size.rows);
+        const QualityKernels::Plane plane{pixels.data(), step, size.rows, size.cols};
+
+        for (int pattern = 0; pattern < 4; ++pattern) {
+            for (int y = 0; y < size.rows; ++y) {
+                for (int x = 0; x < size.cols; ++x) {
+                    seed = seed * 1664525u + 1013904223u;
+                    const uint8_t values[] = {
+                        static_cast<uint8_t>(seed >> 24),
+                        static_cast<uint8_t>((x + y) % 2 ? 255 : 0),
+                        static_cast<uint8_t>(x * 37 + y * 11),
+                        static_cast<uint8_t>((seed >> 31) ? 255 : 0),
+                    };
+                    pixels[y * step + x] = values[pattern];
+                }
+            }
+
+            const int blocks[][4] = {
+                {0, 0, size.cols, size.rows},
+                {1, 1, size.cols - 1, size.rows - 1},
+                {size.cols / 3, 0, size.cols, size.rows / 2 + 1},
+            };
+            for (const auto& block : blocks) {
+                QualityKernels::Sums scalar;
+                QualityKernels::accumulate(Isa::kScalar, plane, block[0], block[1], block[2],
+                                           block[3], scalar);
+                for (const Isa isa : isas) {
+                    QualityKernels::Sums sums;
+                    QualityKernels::accumulate(isa, plane, block[0], block[1], block[2],
+                                               block[3], sums);
+                    if (!sameSums(sums, scalar)) {
+                        std::cerr << "Quality kernels: " << QualityKernels::isaName(isa)
+                                  << " differs from scalar on " << patterns[pattern] << " "
+                                  << size.cols << "x" << size.rows << " block (" << block[0]
+                                  << ", " << block[1] << ")-(" << block[2] << ", " << block[3]
+                                  << ")\n";
+                        ++failures;
+                    }
+                }
+            }
+        }
+    }
+
+    // The default entry point follows the pinned Isa
+    const Isa best = QualityKernels::bestIsa();
+    QualityKernels::Sums pinned, scalar;
+    const uint8_t pixel = 128;
+    const QualityKernels::Plane one{&pixel, 1, 1, 1};
+    QualityKernels::setActiveIsa(Isa::kScalar);
+    QualityKernels::accumulate(one, 0, 0, 1, 1, scalar);
+    QualityKernels::setActiveIsa(best);
+    QualityKernels::accumulate(one, 0, 0, 1, 1, pinned);
+    if (QualityKernels::activeIsa() != best || !sameSums(pinned, scalar)) {
+        std::cerr << "Quality kernels: could not pin " << QualityKernels::isaName(best) << "\n";
+        ++failures;
+    }
+
+    std::cerr << "Quality kernels: ";
+    for (const Isa isa : isas) {
+        std::cerr << QualityKernels::isaName(isa) << " ";
+    }
+    std::cerr << (isas.empty() ? "scalar only, " : "vs scalar, ")
+              << (failures == 0 ? "ok" : "FAILED") << "\n";
+    return failures == 0 ? 0 : 1;
+}
+
+// Brute-force TemporalSelector reference: each window's best [quota]
+// frames, trimmed to the best [count] or topped up from the rest
+std::vector<TemporalSelector::Candidate> referenceSelection(
+    const std::vector<TemporalSelector::Candidate>& frames, size_t count, int64_t window,
+    size_t quota, std::vector<int64_t>& window_picks) {
+    using Candidate = TemporalSelector::Candidate;
+    const auto better = [](const Candidate& a, const Candidate& b) {
+        return a.score != b.score ? a.score > b.score : a.index < b.index;
+    };
+
+    std::vector<Candidate> sorted;
+    for (const auto& frame : frames) {
+        if (count > 0 && !std::isnan(frame.score)) {
+            sorted.push_back(frame);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(), better);
+
+    std::map<int64_t, size_t> taken;
+    std::vector<Candidate> picks, rest;
+    for (const auto& frame : sorted) {
+        size_t& n = taken[window > 0 ? frame.index / window : 0];
+        if (n < quota) {
+            ++n;
+            picks.push_back(frame);
+        } else {
+            rest.push_back(frame);
+        }
+    }
+
+    window_picks.clear();
+    for (const auto& pick : picks) {
+        window_picks.push_back(pick.index);
+    }
+    std::sort(window_picks.begin(), window_picks.end());
+
+    if (picks.size() > count) {
+        picks.resize(count);
+    }
+    for (size_t i = 0; picks.size() < count && i < rest.size(); ++i) {
+        picks.push_back(rest[i]);
+    }
+    std::sort(picks.begin(), picks.end(), better);
+    return picks;
+}
+
+// Selector check: over captures full of tied scores, the selection must
+// match the brute-force reference whatever order the scores arrive in,
+// and the picks reported through add()'s return value and [displaced]
+// must track the windows' final picks.
+int checkSelector() {
+    const struct { size_t count; int64_t window; size_t quota; } configs[] = {
+        {50, 0, 0}, {50, 100, 10}, {50, 100, 2}, {50, 7, 1}, {50, 1000, 50},
+        {1, 10, 1}, {600, 50, 3}, {20, 50, 0}, {0, 10, 2},
+    };
+    constexpr int64_t kFrames = 500;
+
+    int failures = 0;
+    std::mt19937 random(2024);
+    std::vector<TemporalSelector::Candidate> frames;
+    for (int64_t i = 0; i < kFrames; ++i) {
+        // Few distinct scores so ties are common, and the odd NaN
+        const double score = i % 97 == 13 ? std::nan("") : static_cast<double>(random() % 20);
+        frames.push_back({i, score});
+    }
+
+    for (const auto& config : configs) {
+        const size_t quota = config.window > 0
+            ? std::clamp<size_t>(config.quota, 1, std::max<size_t>(config.count, 1))
+            : config.count;
+        std::vector<int64_t> expected_picks;
+        const auto expected = referenceSelection(frames, config.count, config.window, quota,
+                                                 expected_picks);
+
+        for (int order = 0; order < 3; ++order) {
+            auto arrivals = frames;
+            if (order == 1) {
+                std::reverse(arrivals.begin(), arrivals.end());
+            } else if (order == 2) {
+                std::shuffle(arrivals.begin(), arrivals.end(), random);
+            }
+
+            TemporalSelector selector(config.count, config.window, config.quota);
+            std::set<int64_t> live;
+            for (const auto& frame : arrivals) {
+                int64_t displaced = -1;
+                if (selector.add(frame.index, frame.score, &displaced)) {
+                    live.insert(frame.index);
+                }
+                if (displaced >= 0 && live.erase(displaced) != 1) {
+                    ++failures;
+                }
+            }
+
+            const auto selection = selector.select();
+            bool same = selection.size() == expected.size();
+            for (size_t i = 0; same && i < selection.size(); ++i) {
+                same = selection[i].index == expected[i].index &&
+                       selection[i].score == expected[i].score;
+            }
+            same = same && std::equal(live.begin(), live.end(), expected_picks.begin(),
+                                      expected_picks.end());
+            for (int64_t i = 0; same && i < kFrames; ++i) {
+                same = selector.picked(i) == (live.count(i) != 0);
+            }
+            if (!same) {
+                std::cerr << "Temporal selector: count " << config.count << ", window "
+                          << config.window << ", quota " << config.quota << ", order "
+                          << order << " differs from the reference\n";
+                ++failures;
+            }
+        }
+    }
+
+    // Twice the even share per window, at least one, uncapped without a
+    // window or a length
+    const struct { size_t count; int64_t window, total; size_t quota; } quotas[] = {
+        {100, 50, 1000, 10}, {10, 100, 1000, 2}, {3, 100, 10000, 1}, {7, 30, 100, 4},
+        {40, 0, 1000, 40}, {40, 100, 0, 40},
+    };
+    for (const auto& q : quotas) {
+        const size_t quota = TemporalSelector::defaultQuota(q.count, q.window, q.total);
+        if (quota != q.quota) {
+            std::cerr << "Temporal selector: defaultQuota(" << q.count << ", " << q.window
+                      << ", " << q.total << ") = " << quota << ", expected " << q.quota << "\n";
+            ++failures;
+        }
+    }
+
+    std::cerr << "Temporal selector: " << std::size(configs) << " configurations, "
+              << (failures == 0 ? "ok" : "FAILED") << "\n";
+    return failures == 0 ? 0 : 1;
+}
+
+// Pool check: every item must run exactly once on a valid worker, a
+// worker stuck on slow items must have some stolen from it, the first
+// exception must stop the loop and reach the caller, and the pool must
+// run further loops afterwards.
+int checkPool() {
+    WorkStealingPool pool(4);
+    int failures = 0;
+
+    for (const int64_t count : {0, 1, 3, 1000, 100000}) {
+        std::vector<std::atomic<int>> runs(static_cast<size_t>(count));
+        std::atomic<int> bad_worker{0};
+        pool.parallelFor(count, [&](int64_t i, int worker) {
+            runs[i].fetch_add(1, std::memory_order_relaxed);
+            if (worker < 0 || worker >= pool.size()) {
+                bad_worker.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        const bool once = std::all_of(runs.begin(), runs.end(),
+            [](const std::atomic<int>& n) { return n.load() == 1; });
+        if (!once || bad_worker.load() != 0) {
+            std::cerr << "Work-stealing pool: " << count << " items not each run once\n";
+            ++failures;
+        }
+    }
+
+    // Worker 0 drew a quarter of the items but is slow on every one, so
+    // the others must relieve it once their own ranges run dry
+    constexpr int64_t kItems = 400;
+    std::vector<int> owner(kItems, -1);
+    pool.parallelFor(kItems, [&](int64_t i, int worker) {
+        if (worker == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        owner[i] = worker;
+    });
+    const auto slow_items = std::count(owner.begin(), owner.end(), 0);
+    if (std::count(owner.begin(), owner.end(), -1) != 0 || slow_items >= kItems / pool.size()) {
+        std::cerr << "Work-stealing pool: slow worker ran " << slow_items << " of "
+                  << kItems / pool.size() << " items, nothing stolen\n";
+        ++failures;
+    }
+
+    // Every item throws: each worker stops after its first, and exactly
+    // one exception comes back
+    std::atomic<int> started{0};
+    try {
+        pool.parallelFor(kItems, [&](int64_t i, int) {
+            started.fetch_add(1, std::memory_order_relaxed);
+            throw std::runtime_error("item " + std::to_string(i));
+        });
+        std::cerr << "Work-stealing pool: exception not rethrown\n";
+        ++failures;
+    } catch (const std::runtime_error& e) {
+        if (std::strncmp(e.what(), "item ", 5) != 0 || started.load() > pool.size()) {
+            std::cerr << "Work-stealing pool: " << started.load()
+                      << " items started after the first exception\n";
+            ++failures;
+        }
+    }
+
+    std::atomic<int64_t> sum{0};
+    pool.parallelFor(kItems, [&](int64_t i, int) {
+        sum.fetch_add(i, std::memory_order_relaxed);
+    });
+    if (sum.load() != kItems * (kItems - 1) / 2) {
+        std::cerr << "Work-stealing pool: unusable after an exception\n";
+        ++failures;
+    }
+
+    std::cerr << "Work-stealing pool: " << pool.size() << " workers, "
+              << (failures == 0 ? "ok" : "FAILED") << "\n";
+    return failures == 0 ? 0 : 1;
+}
+
+// Scratch file [name] for the file-format checks
+std::string scratchPath(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / ("stacker_analyze_" + name)).string();
+}
+
+std::vector<uint8_t> readBytes(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeBytes(const std::string& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+// Same size, type and pixels (compared row by row, so views may be strided)
+bool samePixels(const cv::Mat& a, const cv::Mat& b) {
+    if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type()) {
+        return false;
+    }
+    const size_t row_bytes = static_cast<size_t>(a.cols) * a.elemSize();
+    for (int y = 0; y < a.rows; ++y) {
+        if (std::memcmp(a.ptr(y), b.ptr(y), row_bytes) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether FrameSpool::open() accepts [path]
+bool spoolOpens(const std::string& path) {
+    try {
+        FrameSpool spool;
+        spool.open(path);
+        return true;
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+// Spool check: frames of several types, a strided view among them, must
+// read back with their frame numbers and pixels intact from raw and (when
+// built in) LZ4 spools, and open() must refuse unfinished, truncated and
+// corrupt files instead of handing out frames past the mapping.
+int checkSpool() {
+    const std::string path = scratchPath("check.psspool");
+    int failures = 0;
+
+    cv::Mat color(30, 40, CV_8UC3), mono16(9, 17, CV_16UC1), wide(12, 50, CV_8UC1);
+    uint32_t seed = 777;
+    for (cv::Mat* image : {&color, &mono16, &wide}) {
+        for (int y = 0; y < image->rows; ++y) {
+            uint8_t* row = image->ptr(y);
+            for (size_t x = 0; x < image->cols * image->elemSize(); ++x) {
+                seed = seed * 1664525u + 1013904223u;
+                row[x] = static_cast<uint8_t>(seed >> 24);
+            }
+        }
+    }
+    const cv::Mat view = wide(cv::Rect(5, 2, 33, 7));
+
+    std::vector<FrameSpool::Compression> compressions = {FrameSpool::Compression::kRaw};
+    if (FrameSpool::hasLz4()) {
+        compressions.push_back(FrameSpool::Compression::kLz4);
+    }
+    for (const auto compression : compressions) {
+        struct Expected { int64_t frame_index; cv::Mat image; };
+        std::vector<Expected> expected = {{10, color}, {3, mono16}, {250, view}};
+        {
+            FrameSpoolWriter writer(path, compression);
+            for (const auto& e : expected) {
+                writer.append(e.frame_index, e.image);
+            }
+            writer.append(11, cv::Mat());   // Empty frames are skipped
+            if (compression == FrameSpool::Compression::kLz4) {
+                std::vector<uint8_t> compressed;
+                FrameSpoolWriter::compressLz4(color, compressed);
+                writer.appendLz4(12, color.rows, color.cols, color.type(), compressed);
+                expected.push_back({12, color});
+            }
+            writer.finish();
+        }
+
+        FrameSpool spool;
+        spool.open(path);
+        bool same = spool.size() == expected.size() && spool.find(11) == -1;
+        for (size_t i = 0; same && i < expected.size(); ++i) {
+            same = spool.record(i).frame_index == expected[i].frame_index &&
+                   spool.record(i).offset % FrameSpool::kAlignment == 0 &&
+                   spool.find(expected[i].frame_index) == static_cast<int64_t>(i) &&
+                   samePixels(spool.frame(i), expected[i].image);
+        }
+        if (!same) {
+            std::cerr << "Frame spool: "
+                      << (compression == FrameSpool::Compression::kRaw ? "raw" : "LZ4")
+                      << " round trip differs\n";
+            ++failures;
+        }
+    }
+
+    // A finished spool, then the same bytes damaged in turn
+    const std::vector<uint8_t> good = readBytes(path);
+    const size_t table = good.size() - 3 * sizeof(FrameSpool::Record) -
+                         (FrameSpool::hasLz4() ? sizeof(FrameSpool::Record) : 0);
+    std::vector<std::pair<const char*, std::vector<uint8_t>>> damaged;
+    damaged.push_back({"truncated table", {good.begin(), good.end() - 1}});
+    damaged.push_back({"truncated header", {good.begin(), good.begin() + 32}});
+    damaged.push_back({"bad magic", good});
+    damaged.back().second[0] ^= 0xFF;
+    damaged.push_back({"zero-row record", good});
+    std::memset(&damaged.back().second[table + offsetof(FrameSpool::Record, rows)], 0, sizeof(int32_t));
+    damaged.push_back({"record past the table", good});
+    std::memset(&damaged.back().second[table + offsetof(FrameSpool::Record, offset)], 0x7F,
+                sizeof(uint64_t));
+    for (const auto& d : damaged) {
+        writeBytes(path, d.second);
+        if (spoolOpens(path)) {
+            std::cerr << "Frame spool: " << d.first << " accepted\n";
+            ++failures;
+        }
+    }
+
+    // A writer destroyed before finish() leaves no file behind
+    {
+        FrameSpoolWriter writer(path);
+        writer.append(0, color);
+    }
+    if (std::filesystem::exists(path)) {
+        std::cerr << "Frame spool: unfinished spool left behind\n";
+        ++failures;
+    }
+    std::filesystem::remove(path);
+
+    std::cerr << "Frame spool: raw" << (FrameSpool::hasLz4() ? " and LZ4" : "") << ", "
+              << (failures == 0 ? "ok" : "FAILED") << "\n";
+    return failures == 0 ? 0 : 1;
+}
+
+bool sameIndex(const FrameIndex& a, const FrameIndex& b) {
+    return a.width == b.width && a.height == b.height && a.time_base_num == b.time_base_num &&
+           a.time_base_den == b.time_base_den && a.fps_num == b.fps_num &&
+           a.fps_den == b.fps_den && a.start_pts == b.start_pts &&
+           a.entries.size() == b.entries.size() &&
+           std::equal(a.entries.begin(), a.entries.end(), b.entries.begin(),
+               [](const FrameIndex::Entry& x, const FrameIndex::Entry& y) {
+                   return x.pts == y.pts && x.pos == y.pos && x.flags == y.flags;
+               });
+}
+
+// Index check: entries recorded in decode order must finalize into
+// presentation order, and the sidecar must round-trip exactly while
+// load() refuses it once the video changes or the sidecar is damaged.
+int checkIndex() {
+    const std::string video = scratchPath("check.video");
+    const std::string sidecar = FrameIndex::sidecarPath(video);
+    writeBytes(video, std::vector<uint8_t>(4096, 0x5A));
+    int failures = 0;
+
+    // 30 frames in GOPs of 10, B-frame style decode order, one duplicate
+    FrameIndex index;
+    index.width = 640;
+    index.height = 480;
+    index.time_base_num = 1;
+    index.time_base_den = 90000;
+    index.fps_num = 30000;
+    index.fps_den = 1001;
+    index.start_pts = 3003;
+    for (int64_t i = 0; i < 30; i += 2) {
+        const int64_t first = i % 10 == 0 ? i : i + 1;
+        const int64_t second = i % 10 == 0 ? i + 1 : i;
+        for (const int64_t frame : {first, second}) {
+            const uint32_t flags = frame % 10 == 0 ? FrameIndex::kKeyframe : 0;
+            index.entries.push_back({3003 + frame * 3003, 1000 + frame * 5000, flags, 0});
+        }
+    }
+    index.entries.push_back(index.entries[7]);
+    index.finalize();
+
+    bool ordered = index.frameCount() == 30 && index.keyframes().size() == 3 &&
+                   index.keyframeAtOrBefore(19) == 10 && index.indexFromPts(3003 * 5) == 4;
+    for (int64_t i = 0; ordered && i < index.frameCount(); ++i) {
+        ordered = index.entries[i].pts == 3003 + i * 3003;
+    }
+    if (!ordered) {
+        std::cerr << "Frame index: finalize() left frames out of presentation order\n";
+        ++failures;
+    }
+
+    FrameIndex loaded;
+    if (!index.save(video) || !FrameIndex::load(video, loaded) || !sameIndex(index, loaded)) {
+        std::cerr << "Frame index: sidecar round trip differs\n";
+        ++failures;
+    }
+
+    // The sidecar damaged in turn, then the video changed under it
+    const std::vector<uint8_t> good = readBytes(sidecar);
+    std::vector<std::pair<const char*, std::vector<uint8_t>>> damaged;
+    damaged.push_back({"truncated entry", {good.begin(), good.end() - 1}});
+    damaged.push_back({"missing entry", {good.begin(), good.end() - sizeof(FrameIndex::Entry)}});
+    damaged.push_back({"truncated header", {good.begin(), good.begin() + 40}});
+    damaged.push_back({"bad magic", good});
+    damaged.back().second[0] ^= 0xFF;
+    damaged.push_back({"other version", good});
+    damaged.back().second[4] ^= 0x01;
+    for (const auto& d : damaged) {
+        writeBytes(sidecar, d.second);
+        if (FrameIndex::load(video, loaded)) {
+            std::cerr << "Frame index: " << d.first << " accepted\n";
+            ++failures;
+        }
+    }
+
+    writeBytes(sidecar, good);
+    std::filesystem::last_write_time(
+        video, std::filesystem::last_write_time(video) + std::chrono::seconds(10));
+    if (FrameIndex::load(video, loaded)) {
+        std::cerr << "Frame index: sidecar of a modified video accepted\n";
+        ++failures;
+    }
+    index.save(video);
+    writeBytes(video, std::vector<uint8_t>(4097, 0x5A));
+    if (FrameIndex::load(video, loaded)) {
+        std::cerr << "Frame index: sidecar of a resized video accepted\n";
+        ++failures;
+    }
+
+    std::filesystem::remove(sidecar);
+    if (FrameIndex::load(video, loaded)) {
+        std::cerr << "Frame index: missing sidecar reported as loaded\n";
+        ++failures;
+    }
+    std::filesystem::remove(video);
+
+    std::cerr << "Frame index: " << index.frameCount() << " frames, "
+              << (failures == 0 ? "ok" : "FAILED") << "\n";
+    return failures == 0 ? 0 : 1;
+}
+
+bool sameContents(const AnalysisCache::Contents& a, const AnalysisCache::Contents& b) {
+    const auto sameScore = [](const FrameAnalyzer::FrameScore& x, const FrameAnalyzer::FrameScore& y) {
+        return x.index == y.index && x.timestamp == y.timestamp && x.score == y.score &&
+               x.raw_score == y.raw_score && x.roi == y.roi &&
+               x.gradient_energy == y.gradient_energy &&
+               x.high_frequency_ratio == y.high_frequency_ratio;
+    };
+    return a.summary.total_frames == b.summary.total_frames &&
+           a.summary.width == b.summary.width && a.summary.height == b.summary.height &&
+           a.summary.fps == b.summary.fps && a.tiles.tile_size == b.tiles.tile_size &&
+           a.tiles.grid == b.tiles.grid && a.tiles.sharpness == b.tiles.sharpness &&
+           a.scores.size() == b.scores.size() &&
+           std::equal(a.scores.begin(), a.scores.end(), b.scores.begin(), sameScore);
+}
+
+// Analysis cache check: the config key must change with every option that
+// changes the scores and with nothing else, the sidecar must round-trip
+// with and without tile maps, and load() must miss on another key, other
+// content, a damaged sidecar or another format version.
+int checkCache() {
+    using Options = FrameAnalyzer::Options;
+    int failures = 0;
+
+    const Options base;
+    const uint64_t base_key = AnalysisCache::configKey(base, 4);
+    const struct { const char* name; void (*change)(Options&); bool matters; } changes[] = {
+        {"sample_step", [](Options& o) { o.sample_step = 2; }, true},
+        {"luma_only", [](Options& o) { o.luma_only = false; }, true},
+        {"downscale", [](Options& o) { o.downscale = 2; }, true},
+        {"fast_decode", [](Options& o) { o.fast_decode = true; }, true},
+        {"track_planet", [](Options& o) { o.track_planet = false; }, true},
+        {"redetect_interval", [](Options& o) { o.redetect_interval = 10; }, true},
+        {"roi_margin", [](Options& o) { o.roi_margin = 1.5; }, true},
+        {"tile_size", [](Options& o) { o.tile_size = 64; }, true},
+        {"rank_count", [](Options& o) { o.rank_count = 50; }, true},
+        {"rescore_count", [](Options& o) { o.rescore_count = 50; }, true},
+        {"cache_frames", [](Options& o) { o.cache_frames = 100; }, false},
+        {"cache_memory_limit", [](Options& o) { o.cache_memory_limit = 1; }, false},
+        {"select_count", [](Options& o) { o.select_count = 100; o.select_window = 50; }, false},
+        {"score_cache", [](Options& o) { o.score_cache = true; }, false},
+        {"decode_segments", [](Options& o) { o.decode_segments = 1; }, false},
+        {"worker_threads", [](Options& o) { o.worker_threads = 3; }, false},
+        {"queue_depth", [](Options& o) { o.queue_depth = 2; }, false},
+        {"rescore_margin without rescoring", [](Options& o) { o.rescore_margin = 0.9; }, false},
+    };
+    for (const auto& c : changes) {
+        Options options = base;
+        c.change(options);
+        if ((AnalysisCache::configKey(options, 4) != base_key) != c.matters) {
+            std::cerr << "Analysis cache: " << c.name << (c.matters ? " doesn't change" : " changes")
+                      << " the config key\n";
+            ++failures;
+        }
+    }
+    // Segments only matter to the tracker, which restarts in each one
+    Options untracked = base;
+    untracked.track_planet = false;
+    if (AnalysisCache::configKey(base, 1) == base_key ||
+        AnalysisCache::configKey(untracked, 1) != AnalysisCache::configKey(untracked, 4)) {
+        std::cerr << "Analysis cache: segment count keyed wrongly\n";
+        ++failures;
+    }
+
+    // A 3 MiB "video", so the start, middle and end samples don't overlap
+    const std::string video = scratchPath("check.video");
+    const std::string sidecar = AnalysisCache::sidecarPath(video);
+    std::vector<uint8_t> bytes(3 << 20);
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        bytes[i] = static_cast<uint8_t>(i * 2654435761u >> 13);
+    }
+    writeBytes(video, bytes);
+
+    AnalysisCache::Contents contents;
+    contents.summary = {1200, 640, 480, 29.97};
+    for (int64_t i = 0; i < 5; ++i) {
+        contents.scores.push_back({i * 3, i * 0.1, 1.0 - i * 0.2, 500.0 - i, cv::Rect(10, 20, 300, 200),
+                                   40.0 + i, 0.25});
+    }
+    contents.tiles.tile_size = 64;
+    contents.tiles.grid = cv::Size(3, 2);
+    for (int i = 0; i < 5 * 6; ++i) {
+        contents.tiles.sharpness.push_back(static_cast<float>(i) * 1.5f);
+    }
+    AnalysisCache::Contents untiled = contents;
+    untiled.tiles = FrameAnalyzer::TileMaps();
+
+    AnalysisCache::Contents loaded;
+    for (const auto* expected : {&untiled, &contents}) {
+        if (!AnalysisCache::save(video, base_key, *expected) ||
+            !AnalysisCache::load(video, base_key, loaded) || !sameContents(*expected, loaded)) {
+            std::cerr << "Analysis cache: round trip "
+                      << (expected->tiles.tileCount() > 0 ? "with" : "without")
+                      << " tile maps differs\n";
+            ++failures;
+        }
+    }
+    if (AnalysisCache::load(video, base_key + 1, loaded)) {
+        std::cerr << "Analysis cache: sidecar for another config key accepted\n";
+        ++failures;
+    }
+
+    const std::vector<uint8_t> good = readBytes(sidecar);
+    std::vector<std::pair<const char*, std::vector<uint8_t>>> damaged;
+    damaged.push_back({"truncated tile maps", {good.begin(), good.end() - 1}});
+    damaged.push_back({"truncated header", {good.begin(), good.begin() + 48}});
+    damaged.push_back({"bad magic", good});
+    damaged.back().second[0] ^= 0xFF;
+    damaged.push_back({"other version", good});
+    damaged.back().second[4] ^= 0x01;
+    for (const auto& d : damaged) {
+        writeBytes(sidecar, d.second);
+        if (AnalysisCache::load(video, base_key, loaded)) {
+            std::cerr << "Analysis cache: " << d.first << " accepted\n";
+            ++failures;
+        }
+    }
+
+    // Same size, one byte different in the middle sample; then resized
+    writeBytes(sidecar, good);
+    bytes[bytes.size() / 2] ^= 0xFF;
+    writeBytes(video, bytes);
+    if (AnalysisCache::load(video, base_key, loaded)) {
+        std::cerr << "Analysis cache: sidecar of other content accepted\n";
+        ++failures;
+    }
+    AnalysisCache::save(video, base_key, contents);
+    bytes.push_back(0);
+    writeBytes(video, bytes);
+    if (AnalysisCache::load(video, base_key, loaded)) {
+        std::cerr << "Analysis cache: sidecar of a resized video accepted\n";
+        ++failures;
+    }
+
+    std::filesystem::remove(sidecar);
+    std::filesystem::remove(video);
+
+    std::cerr << "Analysis cache: " << std::size(changes) << " options keyed, "
+              << (failures == 0 ? "ok" : "FAILED") << "\n";
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <video> [--step N] [--top PERCENT]\n"
+                  << "       " << argv[0] << " --check-align | --check-kernels\n"
+                  << "       " << argv[0] << " --check-selector | --check-pool | --check-spool\n"
+                  << "       " << argv[0] << " --check-index | --check-cache\n";
+        return 1;
+    }
+    if (std::strcmp(argv[1], "--check-align") == 0) {
+        return checkAlignment();
+    }
+    if (std::strcmp(argv[1], "--check-kernels") == 0) {
+        return checkKernels();
+    }
+    if (std::strcmp(argv[1], "--check-selector") == 0) {
+        return checkSelector();
+    }
+    if (std::strcmp(argv[1], "--check-pool") == 0) {
+        return checkPool();
+    }
+    if (std::strcmp(argv[1], "--check-spool") == 0) {
+        return checkSpool();
+    }
+    if (std::strcmp(argv[1], "--check-index") == 0) {
+        return checkIndex();
+    }
+    if (std::strcmp(argv[1], "--check-cache") == 0) {
+        return checkCache();
+    }
+
+    const std::string video_path = argv[1];
+    int sample_step = 3;
+    double top_percent = 25.0;
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--step") == 0) {
+            sample_step = std::atoi(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--top") == 0) {
+            top_percent = std::atof(argv[i + 1]);
+        }
+    }
+
+    FrameAnalyzer analyzer;
+    analyzer.setProgressCallback([](int current, int total) {
+        std::fprintf(stderr, "\rScoring frames... %d/%d", current, total);
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<FrameAnalyzer::FrameScore> scores;
+    try {
+        scores = analyzer.analyzeVideo(video_path, sample_step);
+    } catch (const std::exception& e) {
+        std::cerr << "\nError: " << e.what() << "\n";
+        return 1;
+    }
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    const auto& summary = analyzer.summary();
+    std::cerr << "\nAnalyzed " << scores.size() << " of " << summary.total_frames
+              << " frames (" << summary.width << "x" << summary.height << ") in "
+              << seconds << " s (" << summary.total_frames / std::max(seconds, 1e-9)
+              << " fps decoded)\n";
+
+    const std::string csv_path = video_path + "_scores.csv";
+    std::ofstream csv(csv_path);
+    csv << "frame_index,score,raw_score,roi_x,roi_y,roi_w,roi_h\n";
+    for (const auto& s : scores) {
+        csv << s.index << ',' << s.score << ',' << s.raw_score << ','
+            << s.roi.x << ',' << s.roi.y << ',' << s.roi.width << ',' << s.roi.height << '\n';
+    }
+
+    const size_t keep = std::max<size_t>(1, static_cast<size_t>(scores.size() * top_percent / 100.0));
+    for (size_t i = 0; i < keep && i < scores.size(); ++i) {
+        std::cout << scores[i].index << '\n';
+    }
+
+    std::cerr << "Scores written to " << csv_path << "\n";
+    return 0;
+}
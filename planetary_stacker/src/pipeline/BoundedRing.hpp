@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace planetary {
+
+/// Bounded lock-free multi-producer/multi-consumer ring buffer.
+///
+/// Each slot carries a sequence number that tells producers and consumers
+/// whether it is free or filled for their lap (Vyukov's bounded MPMC
+/// queue), so push and pop are one CAS on the fast path and never take a
+/// lock. The fixed capacity is the pipeline's backpressure: when scoring
+/// falls behind, push() blocks the decoder instead of buffering frames.
+///
+/// Blocking calls spin briefly, then yield, then sleep in short steps, so
+/// a stalled side doesn't burn a core on battery-powered devices.
+template <typename T>
+class BoundedRing {
+public:
+    /// [capacity] is rounded up to a power of two (minimum 2)
+    explicit BoundedRing(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        slots_.reset(new Slot[size]);
+        for (size_t i = 0; i < size; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedRing(const BoundedRing&) = delete;
+    BoundedRing& operator=(const BoundedRing&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    /// Push without blocking. Returns false (leaving [value] untouched)
+    /// when the ring is full.
+    bool tryPush(T& value) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[pos & mask_];
+            const size_t seq = slot.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// Pop without blocking. Returns false when the ring is empty.
+    bool tryPop(T& out) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[pos & mask_];
+            const size_t seq = slot.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    out = std::move(slot.value);
+                    slot.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// Push, waiting while the ring is full
+    void push(T value) {
+        for (unsigned attempt = 0; !tryPush(value); ++attempt) {
+            backoff(attempt);
+        }
+    }
+
+    /// Pop, waiting while the ring is empty
+    T pop() {
+        T out;
+        for (unsigned attempt = 0; !tryPop(out); ++attempt) {
+            backoff(attempt);
+        }
+        return out;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    static void backoff(unsigned attempt) {
+        if (attempt < 64) {
+            return;
+        }
+        if (attempt < 128) {
+            std::this_thread::yield();
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    // Producer and consumer cursors on separate cache lines
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) std::atomic<size_t> head_{0};
+    size_t mask_ = 0;
+    std::unique_ptr<Slot[]> slots_;
+};
+
+} // namespace planetary
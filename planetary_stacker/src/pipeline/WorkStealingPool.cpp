@@ -0,0 +1,174 @@
+#include "WorkStealingPool.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace planetary {
+
+namespace {
+
+// Range [begin, end) packed as begin | end << 32
+uint64_t pack(uint32_t begin, uint32_t end) {
+    return static_cast<uint64_t>(end) << 32 | begin;
+}
+
+uint32_t beginOf(uint64_t bounds) {
+    return static_cast<uint32_t>(bounds);
+}
+
+uint32_t endOf(uint64_t bounds) {
+    return static_cast<uint32_t>(bounds >> 32);
+}
+
+uint32_t remaining(uint64_t bounds) {
+    return endOf(bounds) > beginOf(bounds) ? endOf(bounds) - beginOf(bounds) : 0;
+}
+
+} // namespace
+
+WorkStealingPool::WorkStealingPool(int threads) {
+    if (threads <= 0) {
+        threads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    }
+    ranges_.reset(new Range[threads]);
+    threads_.reserve(threads - 1);
+    for (int i = 1; i < threads; ++i) {
+        threads_.emplace_back(&WorkStealingPool::workerMain, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::parallelFor(int64_t count, const Body& body) {
+    if (count <= 0) {
+        return;
+    }
+    if (count > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("parallelFor: too many items");
+    }
+
+    std::lock_guard<std::mutex> run(run_mutex_);
+    const int workers = size();
+    for (int i = 0; i < workers; ++i) {
+        const auto begin = static_cast<uint32_t>(count * i / workers);
+        const auto end = static_cast<uint32_t>(count * (i + 1) / workers);
+        ranges_[i].bounds.store(pack(begin, end), std::memory_order_relaxed);
+    }
+    body_ = &body;
+    error_ = nullptr;
+    failed_.store(false, std::memory_order_relaxed);
+
+    // The mutex publishes the ranges and the body to the workers
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_ = workers - 1;
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    drain(0);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return active_ == 0; });
+    }
+    body_ = nullptr;
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+void WorkStealingPool::workerMain(int worker) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) {
+                return;
+            }
+            seen = generation_;
+        }
+
+        drain(worker);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0) {
+            done_.notify_all();
+        }
+    }
+}
+
+void WorkStealingPool::drain(int worker) {
+    std::atomic<uint64_t>& own = ranges_[worker].bounds;
+    while (!failed_.load(std::memory_order_relaxed)) {
+        // Take the front item of our own range
+        uint64_t bounds = own.load(std::memory_order_acquire);
+        bool taken = false;
+        while (remaining(bounds) > 0) {
+            if (own.compare_exchange_weak(bounds, pack(beginOf(bounds) + 1, endOf(bounds)),
+                                          std::memory_order_acq_rel)) {
+                taken = true;
+                break;
+            }
+        }
+
+        if (taken) {
+            try {
+                (*body_)(beginOf(bounds), worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex_);
+                if (!error_) {
+                    error_ = std::current_exception();
+                }
+                failed_.store(true, std::memory_order_relaxed);
+            }
+        } else if (!steal(worker)) {
+            return;  // Every range is empty; items in flight finish elsewhere
+        }
+    }
+}
+
+bool WorkStealingPool::steal(int worker) {
+    const int workers = size();
+    while (true) {
+        // The largest range has the most work to share
+        int victim = -1;
+        uint64_t victim_bounds = 0;
+        for (int i = 1; i < workers; ++i) {
+            const int candidate = (worker + i) % workers;
+            const uint64_t bounds = ranges_[candidate].bounds.load(std::memory_order_acquire);
+            if (remaining(bounds) > remaining(victim_bounds)) {
+                victim = candidate;
+                victim_bounds = bounds;
+            }
+        }
+        if (victim < 0) {
+            return false;
+        }
+
+        // The victim keeps the front half (it is working from there); a
+        // single item moves whole
+        const uint32_t begin = beginOf(victim_bounds);
+        const uint32_t end = endOf(victim_bounds);
+        const uint32_t middle = begin + (end - begin) / 2;
+        if (ranges_[victim].bounds.compare_exchange_strong(
+                victim_bounds, pack(begin, middle), std::memory_order_acq_rel)) {
+            // Only this thread refills its own (empty) range
+            ranges_[worker].bounds.store(pack(middle, end), std::memory_order_release);
+            return true;
+        }
+    }
+}
+
+} // namespace planetary
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace planetary {
+
+/// Fixed set of threads running index-parallel loops with work stealing.
+///
+/// parallelFor() deals [0, count) out as one contiguous range per thread.
+/// Each thread works through its own range from the front; once it runs
+/// dry it steals the back half of the largest remaining range, so a
+/// thread that drew slow items (large frames, a cold page cache) is
+/// relieved by the others instead of holding up the loop. A range is one
+/// atomic word (begin and end packed together), so taking an item and
+/// stealing half a range are each a single CAS, and the owner and thieves
+/// never take a lock.
+///
+/// Workers are numbered 0..size()-1 for per-thread scratch buffers; the
+/// calling thread takes part as worker 0.
+class WorkStealingPool {
+public:
+    /// Item callback: (item index, worker number)
+    using Body = std::function<void(int64_t, int)>;
+
+    /// [threads] including the caller (0 = one per core)
+    explicit WorkStealingPool(int threads = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /// Number of workers, including the calling thread
+    int size() const { return static_cast<int>(threads_.size()) + 1; }
+
+    /// Run [body] for every index in [0, count) (count < 2^32) and wait.
+    /// Each range a worker takes (its own, then any stolen half) runs in
+    /// increasing order; which worker runs an item depends on timing, so
+    /// results should be stored by index. The first exception stops the
+    /// loop and is rethrown here.
+    void parallelFor(int64_t count, const Body& body);
+
+private:
+    struct alignas(64) Range {
+        std::atomic<uint64_t> bounds{0};
+    };
+
+    void workerMain(int worker);
+    void drain(int worker);
+    bool steal(int worker);
+
+    std::vector<std::thread> threads_;
+    std::unique_ptr<Range[]> ranges_;
+
+    std::mutex run_mutex_;          // One loop at a time
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    uint64_t generation_ = 0;
+    int active_ = 0;
+    bool stop_ = false;
+
+    const Body* body_ = nullptr;
+    std::atomic<bool> failed_{false};
+    std::exception_ptr error_;
+    std::mutex error_mutex_;
+};
+
+} // namespace planetary
@@ -0,0 +1,657 @@
+#include "planetary_stacker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "alignment/GlobalAligner.hpp"
+#include "alignment/LocalAligner.hpp"
+#include "analysis/FrameAnalyzer.hpp"
+#include "video/ExtractionPlanner.hpp"
+#include "video/FrameIndex.hpp"
+#include "video/FrameSpool.hpp"
+#include "video/RawVideoReader.hpp"
+#include "video/VideoReader.hpp"
+
+using namespace planetary;
+
+namespace {
+
+thread_local std::string g_last_error;
+
+void setLastError(const char* message) {
+    g_last_error = message != nullptr ? message : "Unknown error";
+}
+
+// Frames a cache of [capacity] would hold after [analyzer]'s pass: the
+// selection, or the best frames when nothing was selected
+std::vector<int64_t> framesToSpool(const FrameAnalyzer& analyzer,
+                                   const std::vector<FrameAnalyzer::FrameScore>& scores,
+                                   size_t capacity) {
+    if (!analyzer.selection().empty()) {
+        return analyzer.selection();
+    }
+    std::vector<FrameAnalyzer::FrameScore> best(std::min(capacity, scores.size()));
+    std::partial_sort_copy(scores.begin(), scores.end(), best.begin(), best.end(),
+        [](const FrameAnalyzer::FrameScore& a, const FrameAnalyzer::FrameScore& b) {
+            return a.score != b.score ? a.score > b.score : a.index < b.index;
+        });
+    std::vector<int64_t> indices;
+    for (const auto& s : best) {
+        indices.push_back(s.index);
+    }
+    return indices;
+}
+
+// Hand the frames at [indices] to [sink] as BGR, in file order. Sets
+// [requested] to the number of frames that will arrive before the first
+// one does.
+void forEachSelectedFrame(
+    const char* video_path,
+    std::vector<int64_t> indices,
+    size_t& requested,
+    const ExtractionPlanner::FrameSink& sink) {
+    if (RawVideoReader::isRawVideo(video_path)) {
+        // Every frame stands alone: no GOPs to plan around
+        const RawVideoReader reader(video_path);
+        std::sort(indices.begin(), indices.end());
+        indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+        indices.erase(std::remove_if(indices.begin(), indices.end(), [&](int64_t index) {
+            return index < 0 || index >= reader.getFrameCount();
+        }), indices.end());
+
+        requested = indices.size();
+        cv::Mat bgr;
+        for (const int64_t index : indices) {
+            reader.toBgr(index, bgr);
+            sink(index, bgr);
+        }
+        return;
+    }
+
+    // The sidecar index makes frame numbers and GOP boundaries exact
+    const auto reader = VideoReader::openIndexed(video_path);
+    const auto plan = ExtractionPlanner::plan(indices, reader->keyframes());
+
+    requested = 0;
+    for (const auto& gop : plan) {
+        requested += gop.frames.size();
+    }
+    ExtractionPlanner::extract(*reader, plan, sink);
+}
+
+// View of [image]'s pixels (no copy)
+cv::Mat toMat(const PSImage& image) {
+    return cv::Mat(image.height, image.width, image.type,
+                   const_cast<uint8_t*>(image.data), static_cast<size_t>(image.step));
+}
+
+bool isValid(const PSImage* image) {
+    return image != nullptr && image->data != nullptr && image->width > 0 && image->height > 0;
+}
+
+} // namespace
+
+/// Aligner handle behind the opaque C type
+struct PSAligner {
+    PSAligner(const cv::Mat& reference, int tile_size) : aligner(reference) {
+        if (tile_size > 0) {
+            local = std::make_unique<LocalAligner>(reference, aligner.region(), tile_size);
+        }
+    }
+
+    GlobalAligner aligner;
+    std::unique_ptr<LocalAligner> local;    // Null for global alignment only
+};
+
+/// Frame spool handle behind the opaque C type
+struct PSSpool {
+    FrameSpool spool;
+    cv::Mat scratch;    // Decompressed LZ4 frame
+};
+
+extern "C" {
+
+FFI_PLUGIN_EXPORT PSAnalysisOptions ps_default_analysis_options(void) {
+    PSAnalysisOptions options;
+    options.sample_step = 3;
+    options.luma_only = 1;
+    options.cache_frames = 0;
+    options.cache_memory_mb = 512;
+    options.cache_spool_path = nullptr;
+    options.worker_threads = 0;
+    options.decode_segments = 0;
+    options.downscale = 1;
+    options.fast_decode = 0;
+    options.track_planet = 1;
+    options.redetect_interval = 30;
+    options.tile_size = 0;
+    options.select_count = 0;
+    options.select_window = 0;
+    options.select_quota = 0;
+    options.rescore_count = 0;
+    options.score_cache = 0;
+    options.rank_count = 0;
+    return options;
+}
+
+FFI_PLUGIN_EXPORT PSAnalysisResult* ps_analyze_video(
+    const char* video_path,
+    int32_t sample_step,
+    PSProgressCallback callback,
+    void* user_data) {
+    PSAnalysisOptions options = ps_default_analysis_options();
+    options.sample_step = sample_step;
+    return ps_analyze_video_with_options(video_path, &options, callback, user_data);
+}
+
+FFI_PLUGIN_EXPORT PSAnalysisResult* ps_analyze_video_with_options(
+    const char* video_path,
+    const PSAnalysisOptions* options,
+    PSProgressCallback callback,
+    void* user_data) {
+    g_last_error.clear();
+
+    if (video_path == nullptr) {
+        setLastError("video_path is NULL");
+        return nullptr;
+    }
+
+    const PSAnalysisOptions opts = options != nullptr ? *options : ps_default_analysis_options();
+
+    try {
+        FrameAnalyzer analyzer;
+        if (callback != nullptr) {
+            analyzer.setProgressCallback([callback, user_data](int current, int total) {
+                callback(current, total, user_data);
+            });
+        }
+
+        FrameAnalyzer::Options analyzer_options;
+        analyzer_options.sample_step = opts.sample_step;
+        analyzer_options.luma_only = opts.luma_only != 0;
+        analyzer_options.worker_threads = std::max(opts.worker_threads, 0);
+        analyzer_options.decode_segments = std::max(opts.decode_segments, 0);
+        analyzer_options.downscale = std::min(std::max(opts.downscale, 1), 4);
+        analyzer_options.fast_decode = opts.fast_decode != 0;
+        analyzer_options.track_planet = opts.track_planet != 0;
+        analyzer_options.redetect_interval = std::max(opts.redetect_interval, 1);
+        analyzer_options.tile_size = std::max(opts.tile_size, 0);
+        analyzer_options.select_count = static_cast<size_t>(std::max(opts.select_count, 0));
+        analyzer_options.select_window = std::max(opts.select_window, 0);
+        analyzer_options.select_quota = std::max(opts.select_quota, 0);
+        analyzer_options.rescore_count = static_cast<size_t>(std::max(opts.rescore_count, 0));
+        analyzer_options.score_cache = opts.score_cache != 0;
+        analyzer_options.rank_count = static_cast<size_t>(std::max(opts.rank_count, 0));
+        if (opts.cache_spool_path != nullptr && opts.cache_frames > 0) {
+            analyzer_options.cache_frames = static_cast<size_t>(opts.cache_frames);
+            analyzer_options.cache_memory_limit = static_cast<size_t>(std::max(opts.cache_memory_mb, 0)) << 20;
+        }
+
+        const auto scores = analyzer.analyzeVideo(video_path, analyzer_options);
+        const auto& summary = analyzer.summary();
+
+        if (analyzer_options.cache_frames > 0) {
+            FrameSpoolWriter spool(opts.cache_spool_path, FrameSpool::Compression::kRaw);
+            if (analyzer.scoresReused()) {
+                // Nothing was decoded: fetch the frames the cache would
+                // have held, a GOP at a time, so callers still find them
+                // in the spool
+                size_t requested = 0;
+                forEachSelectedFrame(video_path, framesToSpool(analyzer, scores, analyzer_options.cache_frames),
+                                     requested, [&](int64_t index, const cv::Mat& bgr) {
+                    spool.append(index, bgr);
+                });
+            } else {
+                analyzer.cache().writeTo(spool);
+            }
+            spool.finish();
+        }
+
+        auto* result = new PSAnalysisResult();
+        result->count = static_cast<int32_t>(scores.size());
+        result->scores = new PSFrameScore[std::max<size_t>(scores.size(), 1)];
+        result->total_frames = summary.total_frames;
+        result->width = summary.width;
+        result->height = summary.height;
+        result->frame_rate = summary.fps;
+
+        for (size_t i = 0; i < scores.size(); ++i) {
+            PSFrameScore& out = result->scores[i];
+            out.frame_index = scores[i].index;
+            out.timestamp = scores[i].timestamp;
+            out.quality_score = scores[i].score;
+            out.raw_score = scores[i].raw_score;
+            out.roi_x = scores[i].roi.x;
+            out.roi_y = scores[i].roi.y;
+            out.roi_width = scores[i].roi.width;
+            out.roi_height = scores[i].roi.height;
+            out.gradient_energy = scores[i].gradient_energy;
+            out.high_frequency_ratio = scores[i].high_frequency_ratio;
+        }
+
+        const FrameAnalyzer::TileMaps& tiles = analyzer.tileMaps();
+        if (!tiles.sharpness.empty()) {
+            result->tile_sharpness = new float[tiles.sharpness.size()];
+            std::copy(tiles.sharpness.begin(), tiles.sharpness.end(), result->tile_sharpness);
+            result->tile_cols = tiles.grid.width;
+            result->tile_rows = tiles.grid.height;
+            result->tile_size = tiles.tile_size;
+        }
+
+        const std::vector<int64_t>& selection = analyzer.selection();
+        if (analyzer_options.select_count > 0) {
+            result->selected_count = static_cast<int32_t>(selection.size());
+            result->selected_frames = new int64_t[std::max<size_t>(selection.size(), 1)];
+            std::copy(selection.begin(), selection.end(), result->selected_frames);
+        }
+
+        return result;
+    } catch (const std::exception& e) {
+        setLastError(e.what());
+        return nullptr;
+    } catch (...) {
+        setLastError("Unknown native error");
+        return nullptr;
+    }
+}
+
+FFI_PLUGIN_EXPORT int32_t ps_score_images(
+    const char* const* paths,
+    int32_t count,
+    int32_t worker_threads,
+    double* out_variances,
+    PSProgressCallback callback,
+    void* user_data) {
+    g_last_error.clear();
+
+    if (count < 0 || (count > 0 && (paths == nullptr || out_variances == nullptr))) {
+        setLastError("Invalid arguments");
+        return -1;
+    }
+
+    try {
+        std::vector<std::string> files;
+        files.reserve(count);
+        for (int32_t i = 0; i < count; ++i) {
+            files.emplace_back(paths[i] != nullptr ? paths[i] : "");
+        }
+
+        FrameAnalyzer analyzer;
+        if (callback != nullptr) {
+            analyzer.setProgressCallback([callback, user_data](int current, int total) {
+                callback(current, total, user_data);
+            });
+        }
+        const std::vector<double> variances = analyzer.scoreImages(files, std::max(worker_threads, 0));
+        std::copy(variances.begin(), variances.end(), out_variances);
+        return 0;
+    } catch (const std::exception& e) {
+        setLastError(e.what());
+        return -1;
+    } catch (...) {
+        setLastError("Unknown native error");
+        return -1;
+    }
+}
+
+FFI_PLUGIN_EXPORT int32_t ps_extract_frames(
+    const char* video_path,
+    const int64_t* frame_indices,
+    int32_t count,
+    const char* output_dir,
+    PSProgressCallback callback,
+    void* user_data) {
+    g_last_error.clear();
+
+    if (video_path == nullptr || output_dir == nullptr || (frame_indices == nullptr && count > 0)) {
+        setLastError("Invalid arguments");
+        return -1;
+    }
+
+    try {
+        // Fast PNG compression: these files are read back once and deleted
+        const std::vector<int> png_params = {cv::IMWRITE_PNG_COMPRESSION, 1};
+        const std::string dir = output_dir;
+        size_t requested = 0;
+        int32_t written = 0;
+
+        forEachSelectedFrame(video_path, std::vector<int64_t>(frame_indices, frame_indices + count),
+                             requested, [&](int64_t index, const cv::Mat& bgr) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "/frame_%06lld.png", static_cast<long long>(index));
+            if (cv::imwrite(dir + name, bgr, png_params)) {
+                ++written;
+            }
+            if (callback != nullptr) {
+                callback(written, static_cast<int32_t>(requested), user_data);
+            }
+        });
+
+        return written;
+    } catch (const std::exception& e) {
+        setLastError(e.what());
+        return -1;
+    } catch (...) {
+        setLastError("Unknown native error");
+        return -1;
+    }
+}
+
+FFI_PLUGIN_EXPORT int32_t ps_extract_frames_to_spool(
+    const char* video_path,
+    const int64_t* frame_indices,
+    int32_t count,
+    const char* spool_path,
+    int32_t compress,
+    PSProgressCallback callback,
+    void* user_data) {
+    g_last_error.clear();
+
+    if (video_path == nullptr || spool_path == nullptr || (frame_indices == nullptr && count > 0)) {
+        setLastError("Invalid arguments");
+        return -1;
+    }
+
+    try {
+        FrameSpoolWriter spool(spool_path,
+            compress ? FrameSpool::Compression::kLz4 : FrameSpool::Compression::kRaw);
+        size_t requested = 0;
+        int32_t written = 0;
+
+        forEachSelectedFrame(video_path, std::vector<int64_t>(frame_indices, frame_indices + count),
+                             requested, [&](int64_t index, const cv::Mat& bgr) {
+            spool.append(index, bgr);
+            ++written;
+            if (callback != nullptr) {
+                callback(written, static_cast<int32_t>(requested), user_data);
+            }
+        });
+
+        spool.finish();
+        return written;
+    } catch (const std::exception& e) {
+        setLastError(e.what());
+        return -1;
+    } catch (...) {
+        setLastError("Unknown native error");
+        return -1;
+    }
+}
+
+FFI_PLUGIN_EXPORT PSSpool* ps_spool_open(const char* spool_path) {
+    g_last_error.clear();
+
+    if (spool_path == nullptr) {
+        setLastError("spool_path is NULL");
+        return nullptr;
+    }
+
+    try {
+        auto handle = std::make_unique<PSSpool>();
+        handle->spool.open(spool_path);
+        return handle.release();
+    } catch (const std::exception& e) {
+        setLastError(e.what());
+        return nullptr;
+    } catch (...) {
+        setLastError("Unknown native error");
+        return nullptr;
+    }
+}
+
+FFI_PLUGIN_EXPORT int32_t ps_spool_count(const PSSpool* spool) {
+    if (spool == nullptr) {
+        return 0;
+    }
+    return static_cast<int32_t>(spool->spool.size());
+}
+
+FFI_PLUGIN_EXPORT int64_t ps_spool_frame_index(const PSSpool* spool, int32_t i) {
+    if (spool == nullptr || i < 0 || i >= ps_spool_count(spool)) {
+        return -1;
+    }
+    return spool->spool.record(static_cast<size_t>(i)).frame_index;
+}
+
+FFI_PLUGIN_EXPORT int32_t ps_spool_get_frame(PSSpool* spool, int32_t i, PSSpoolFrame* out_frame) {
+    g_last_error.clear();
+
+    if (spool == nullptr || out_frame == nullptr || i < 0 || i >= ps_spool_count(spool)) {
+        setLastError("Invalid arguments");
+        return -1;
+    }
+
+    try {
+        const cv::Mat frame = spool->spool.frame(static_cast<size_t>(i), spool->scratch);
+        out_frame->frame_index = spool->spool.record(static_cast<size_t>(i)).frame_index;
+        out_frame->width = frame.cols;
+        out_frame->height = frame.rows;
+        out_frame->type = frame.type();
+        out_frame->step = static_cast<int32_t>(frame.step);
+        out_frame->data = frame.data;
+        return 0;
+    } catch (const std::exception& e) {
+        setLastError(e.what());
+        return -1;
+    } catch (...) {
+        setLastError("Unknown native error");
+        return -1;
+    }
+}
+
+FFI_PLUGIN_EXPORT void ps_spool_close(PSSpool* spool) {
+    delete spool;
+}
+
+FFI_PLUGIN_EXPORT PSAligner* ps_aligner_create(const PSImage* reference, int32_t tile_size) {
+    g_last_error.clear();
+
+    if (!isValid(reference) || tile_size < 0) {
+        setLastError("Invalid arguments");
+        return nullptr;
+    }
+
+    try {
+        return new PSAligner(toMat(*reference), tile_size);
+    } catch (const std::exception& e) {
+        setLastError(e.what());
+        return nullptr;
+    } catch (...) {
+        setLastError("Unknown native error");
+        return nullptr;
+    }
+}
+
+FFI_PLUGIN_EXPORT int32_t ps_aligner_align(const PSAligner* aligner, const PSImage* frame, PSShift* out_shift) {
+    g_last_error.clear();
+
+    if (aligner == nullptr || !isValid(frame) || out_shift == nullptr) {
+        setLastError("Invalid arguments");
+        return -1;
+    }
+
+    try {
+        const GlobalAligner::Shift shift = aligner->aligner.align(toMat(*frame));
+        out_shift->dx = shift.dx;
+        out_shift->dy = shift.dy;
+        out_shift->response = shift.response;
+        return 0;
+    } catch (const std::exception& e) {
+        setLastError(e.what());
+        return -1;
+    } catch (...) {
+        setLastError("Unknown native error");
+        return -1;
+    }
+}
+
+FFI_PLUGIN_EXPORT int32_t ps_aligner_grid(const PSAligner* aligner, PSWarpGrid* out_grid) {
+    g_last_error.clear();
+
+    if (aligner == nullptr || out_grid == nullptr) {
+        setLastError("Invalid arguments");
+        return -1;
+    }
+
+    *out_grid = PSWarpGrid{};
+    if (aligner->local) {
+        const WarpGrid& grid = aligner->local->grid();
+        out_grid->origin_x = grid.origin.x;
+        out_grid->origin_y = grid.origin.y;
+        out_grid->spacing = grid.spacing;
+        out_grid->cols = grid.nodes.width;
+        out_grid->rows = grid.nodes.height;
+    }
+    return 0;
+}
+
+FFI_PLUGIN_EXPORT int32_t ps_aligner_align_local(const PSAligner* aligner, const PSImage* frame,
+                                                 const PSShift* shift, float* out_shifts) {
+    g_last_error.clear();
+
+    if (aligner == nullptr || !isValid(frame) || shift == nullptr || out_shifts == nullptr) {
+        setLastError("Invalid arguments");
+        return -1;
+    }
+    if (!aligner->local) {
+        setLastError("Aligner was created without a tile size");
+        return -1;
+    }
+
+    try {
+        GlobalAligner::Shift global;
+        global.dx = shift->dx;
+        global.dy = shift->dy;
+        global.response = shift->response;
+        const WarpGrid grid = aligner->local->align(toMat(*frame), global);
+        for (const cv::Point2f& node : grid.shifts) {
+            *out_shifts++ = node.x;
+            *out_shifts++ = node.y;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        setLastError(e.what());
+        return -1;
+    } catch (...) {
+        setLastError("Unknown native error");
+        return -1;
+    }
+}
+
+FFI_PLUGIN_EXPORT void ps_aligner_free(PSAligner* aligner) {
+    delete aligner;
+}
+
+FFI_PLUGIN_EXPORT int32_t ps_warp_frame(const PSImage* frame, const PSWarpGrid* grid, const float* shifts,
+                                        uint8_t* out_data) {
+    g_last_error.clear();
+
+    if (!isValid(frame) || grid == nullptr || grid->cols < 0 || grid->rows < 0 || grid->spacing <= 0 ||
+        (shifts == nullptr && grid->cols * grid->rows > 0) || out_data == nullptr) {
+        setLastError("Invalid arguments");
+        return -1;
+    }
+
+    try {
+        WarpGrid warp;
+        warp.origin = cv::Point2f(grid->origin_x, grid->origin_y);
+        warp.spacing = grid->spacing;
+        warp.nodes = cv::Size(grid->cols, grid->rows);
+        warp.shifts.resize(static_cast<size_t>(warp.nodes.area()));
+        for (cv::Point2f& node : warp.shifts) {
+            node = cv::Point2f(shifts[0], shifts[1]);
+            shifts += 2;
+        }
+
+        // Remapped straight into the caller's buffer
+        cv::Mat out(frame->height, frame->width, frame->type, out_data, static_cast<size_t>(frame->step));
+        warpFrame(toMat(*frame), warp, out);
+        return 0;
+    } catch (const std::exception& e) {
+        setLastError(e.what());
+        return -1;
+    } catch (...) {
+        setLastError("Unknown native error");
+        return -1;
+    }
+}
+
+FFI_PLUGIN_EXPORT int32_t ps_get_video_info(const char* video_path, PSVideoInfo* out_info) {
+    g_last_error.clear();
+
+    if (video_path == nullptr || out_info == nullptr) {
+        setLastError("Invalid arguments");
+        return -1;
+    }
+
+    try {
+        if (RawVideoReader::isRawVideo(video_path)) {
+            // The header has it all; every frame is a keyframe
+            const RawVideoReader reader(video_path);
+            const double fps = reader.getFPS();
+            out_info->width = reader.getWidth();
+            out_info->height = reader.getHeight();
+            out_info->frame_count = reader.getFrameCount();
+            out_info->duration_ms = fps > 0
+                ? static_cast<int64_t>(std::llround(reader.getFrameCount() * 1000.0 / fps))
+                : 0;
+            out_info->frame_rate = fps;
+            out_info->keyframe_count = static_cast<int32_t>(reader.getFrameCount());
+            return 0;
+        }
+
+        // A valid sidecar answers without opening the video at all
+        FrameIndex index;
+        if (!FrameIndex::load(video_path, index)) {
+            VideoReader reader(video_path);
+            index = reader.buildIndex();
+            index.save(video_path);
+        }
+
+        if (index.empty()) {
+            setLastError("No video frames found");
+            return -1;
+        }
+
+        out_info->width = index.width;
+        out_info->height = index.height;
+        out_info->frame_count = index.frameCount();
+        out_info->duration_ms = static_cast<int64_t>(std::llround(index.durationSeconds() * 1000.0));
+        out_info->frame_rate = index.fps();
+        out_info->keyframe_count = static_cast<int32_t>(index.keyframes().size());
+        return 0;
+    } catch (const std::exception& e) {
+        setLastError(e.what());
+        return -1;
+    } catch (...) {
+        setLastError("Unknown native error");
+        return -1;
+    }
+}
+
+FFI_PLUGIN_EXPORT void ps_free_analysis_result(PSAnalysisResult* result) {
+    if (result == nullptr) {
+        return;
+    }
+    delete[] result->scores;
+    delete[] result->tile_sharpness;
+    delete[] result->selected_frames;
+    delete result;
+}
+
+FFI_PLUGIN_EXPORT const char* ps_get_last_error(void) {
+    return g_last_error.c_str();
+}
+
+FFI_PLUGIN_EXPORT const char* ps_get_version(void) {
+    return "0.2.0";
+}
+
+} // extern "C"
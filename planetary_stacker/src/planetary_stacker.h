@@ -0,0 +1,456 @@
+/*
+ * Planetary Stacker - C API
+ *
+ * Plain C interface to the native processing engine so it can be called
+ * from Dart via FFI. All heavy lifting happens in C++ (see video/, analysis/);
+ * this header only exposes POD structs and free functions.
+ *
+ * Error handling: functions return NULL (or a negative status) on failure.
+ * The reason is available from ps_get_last_error() on the same thread.
+ */
+#ifndef PLANETARY_STACKER_H
+#define PLANETARY_STACKER_H
+
+#include <stdint.h>
+
+#if _WIN32
+#define FFI_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define FFI_PLUGIN_EXPORT __attribute__((visibility("default"))) __attribute__((used))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Progress callback.
+ *
+ * [current]: Units of work completed so far
+ * [total]: Total units of work (may be an estimate)
+ * [user_data]: Opaque pointer passed through from the caller
+ *
+ * May be invoked from a worker thread; the callback must not assume it
+ * runs on the thread that started the operation.
+ */
+typedef void (*PSProgressCallback)(int32_t current, int32_t total, void* user_data);
+
+/* Quality score for a single analyzed frame */
+typedef struct PSFrameScore {
+  /* Frame index in the video (presentation order, 0-based): the number
+   * ps_extract_frames() takes, whatever the sample step */
+  int64_t frame_index;
+
+  /* Presentation time in seconds from the start of the stream */
+  double timestamp;
+
+  /* Normalized quality score (0.0 to 1.0, higher = sharper) */
+  double quality_score;
+
+  /* Raw sharpness metric (Laplacian variance) */
+  double raw_score;
+
+  /* Region of interest (planet bounding box) */
+  int32_t roi_x;
+  int32_t roi_y;
+  int32_t roi_width;
+  int32_t roi_height;
+
+  /* Mean squared Sobel gradient magnitude */
+  double gradient_energy;
+
+  /* Share of the frame's energy at high spatial frequencies (0 = smooth,
+   * about 1 = pixel noise); computed in the same pass as raw_score */
+  double high_frequency_ratio;
+} PSFrameScore;
+
+/* Result of a video analysis pass */
+typedef struct PSAnalysisResult {
+  /* Frame scores sorted by quality, best first (with
+   * PSAnalysisOptions.rank_count, only that many; the rest follow in
+   * frame order) */
+  PSFrameScore* scores;
+  int32_t count;
+
+  /* Video metadata */
+  int64_t total_frames;
+  int32_t width;
+  int32_t height;
+  double frame_rate;
+
+  /* Per-tile sharpness (PSAnalysisOptions.tile_size): [count] rows of
+   * tile_cols * tile_rows Laplacian variances, row i for scores[i], tiles
+   * row-major over the scored region. NaN where a frame's region had
+   * fewer tiles. NULL when tile maps are off. */
+  float* tile_sharpness;
+  int32_t tile_cols;
+  int32_t tile_rows;
+  /* Tile edge in full-resolution pixels */
+  int32_t tile_size;
+
+  /* Frames picked with temporal spread (PSAnalysisOptions.select_count),
+   * best first. NULL when selection is off. */
+  int64_t* selected_frames;
+  int32_t selected_count;
+} PSAnalysisResult;
+
+/*
+ * Analyze video frame quality in a single streaming decode pass.
+ *
+ * Frames are decoded sequentially and scored in memory; no intermediate
+ * image files are written.
+ *
+ * [video_path]: Path to the input video (MP4/MOV, or SER / uncompressed AVI,
+ * which are memory-mapped and need no decoding)
+ * [sample_step]: Score every Nth frame (1 = all frames)
+ * [callback]: Optional progress callback (may be NULL)
+ * [user_data]: Passed through to the callback
+ *
+ * Returns a result to be released with ps_free_analysis_result(),
+ * or NULL on failure.
+ */
+FFI_PLUGIN_EXPORT PSAnalysisResult* ps_analyze_video(
+    const char* video_path,
+    int32_t sample_step,
+    PSProgressCallback callback,
+    void* user_data);
+
+/* Options for ps_analyze_video_with_options() */
+typedef struct PSAnalysisOptions {
+  /* Score every Nth frame (1 = all frames) */
+  int32_t sample_step;
+
+  /* Non-zero: score the decoder's luma (Y) plane directly instead of
+   * converting each frame to BGR and back to grayscale */
+  int32_t luma_only;
+
+  /* Single-decode mode: keep the best [cache_frames] sampled frames in
+   * memory during the pass and write them to the frame spool
+   * [cache_spool_path] when it completes, so selected frames don't need a
+   * second decode. 0 disables the cache. */
+  int32_t cache_frames;
+
+  /* Cached frames are held PNG-compressed when [cache_frames] raw frames
+   * would exceed this budget */
+  int32_t cache_memory_mb;
+
+  /* Frame spool file for the cached frames (cache off when NULL) */
+  const char* cache_spool_path;
+
+  /* Scoring threads running alongside the decoder (0 = auto) */
+  int32_t worker_threads;
+
+  /* Keyframe-aligned segments of the video decoded in parallel, each with
+   * its own decoder (0 = auto, 1 = a single sequential decoder) */
+  int32_t decode_segments;
+
+  /* Score a 1/downscale thumbnail of each frame (1, 2 or 4). Several
+   * times faster on 4K video; rankings get slightly noisier. */
+  int32_t downscale;
+
+  /* Non-zero: let the codec decode at reduced resolution where supported
+   * and skip its deblocking filter. Faster, but decoded frames are then
+   * unfit for stacking, so the frame cache is disabled. */
+  int32_t fast_decode;
+
+  /* Non-zero: score only the planetary disk (found by thresholding,
+   * tracked between detections) plus a margin instead of the whole frame.
+   * PSFrameScore.roi_* report the scored region. */
+  int32_t track_planet;
+
+  /* Frames between full disk detections while tracking */
+  int32_t redetect_interval;
+
+  /* Edge in pixels of the tiles of the per-tile sharpness map
+   * (PSAnalysisResult.tile_sharpness); 0 = no map */
+  int32_t tile_size;
+
+  /* Pick the best [select_count] frames during the pass (0 = off), at
+   * most [select_quota] from every [select_window] consecutive frames so
+   * the selection is spread over the capture. select_window = 0 picks the
+   * plain top N; select_quota = 0 allows twice a window's even share.
+   * The frame cache then holds each window's picks. */
+  int32_t select_count;
+  int32_t select_window;
+  int32_t select_quota;
+
+  /* Coarse-to-fine scoring (with downscale > 1): the best [rescore_count]
+   * frames by thumbnail score, plus half as many again as a margin, are
+   * scored a second time at full resolution after the pass, so the frames
+   * that can make the cut are ranked exactly. 0 = off. */
+  int32_t rescore_count;
+
+  /* Non-zero: reuse the scores of an earlier pass over the same video
+   * with the same scoring options from the sidecar [video_path].psscore,
+   * and write one after a fresh pass, along with the packet index
+   * ([video_path].psidx) if the pass had to build it. A reused pass
+   * decodes only what the frame spool needs: the selection (or the best
+   * cache_frames), extracted GOP by GOP. 0 writes nothing next to the
+   * video. */
+  int32_t score_cache;
+
+  /* Sort only the best [rank_count] scores, best first, and leave the
+   * rest in frame order behind them (0 = sort all) */
+  int32_t rank_count;
+} PSAnalysisOptions;
+
+/*
+ * Default analysis options (sample_step = 3, luma_only = 1, cache off,
+ * cache_memory_mb = 512, worker_threads = 0, decode_segments = 0,
+ * downscale = 1, fast_decode = 0, track_planet = 1,
+ * redetect_interval = 30, tile_size = 0, selection off, rescore_count = 0,
+ * score_cache = 0, rank_count = 0)
+ */
+FFI_PLUGIN_EXPORT PSAnalysisOptions ps_default_analysis_options(void);
+
+/*
+ * Same as ps_analyze_video() with explicit options.
+ * [options] may be NULL to use ps_default_analysis_options().
+ */
+FFI_PLUGIN_EXPORT PSAnalysisResult* ps_analyze_video_with_options(
+    const char* video_path,
+    const PSAnalysisOptions* options,
+    PSProgressCallback callback,
+    void* user_data);
+
+/*
+ * Sharpness (Laplacian variance) of image files such as extracted frames,
+ * scored on all cores with a work-stealing scheduler.
+ *
+ * [paths]: [count] image file paths
+ * [worker_threads]: Scoring threads (0 = one per core)
+ * [out_variances]: Receives [count] values in the order of [paths]; NaN
+ * for images that cannot be read
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+FFI_PLUGIN_EXPORT int32_t ps_score_images(
+    const char* const* paths,
+    int32_t count,
+    int32_t worker_threads,
+    double* out_variances,
+    PSProgressCallback callback,
+    void* user_data);
+
+/*
+ * Extract selected frames in a single process, decoding each GOP once.
+ *
+ * The indices are sorted and grouped by keyframe interval, then decoded in
+ * one forward sweep. Each frame is written to
+ * [output_dir]/frame_NNNNNN.png, named by its frame index.
+ *
+ * [frame_indices]: Frame indices to extract (any order)
+ * [count]: Number of entries in [frame_indices]
+ *
+ * Returns the number of frames written, or -1 on failure.
+ */
+FFI_PLUGIN_EXPORT int32_t ps_extract_frames(
+    const char* video_path,
+    const int64_t* frame_indices,
+    int32_t count,
+    const char* output_dir,
+    PSProgressCallback callback,
+    void* user_data);
+
+/*
+ * Same as ps_extract_frames(), but writes the frames (BGR, 8-bit) to a
+ * binary frame spool at [spool_path] instead of a PNG per frame. See
+ * ps_spool_open() for reading it back.
+ *
+ * [compress]: Non-zero to store LZ4-compressed records (ignored when the
+ * library was built without LZ4)
+ *
+ * Returns the number of frames written, or -1 on failure.
+ */
+FFI_PLUGIN_EXPORT int32_t ps_extract_frames_to_spool(
+    const char* video_path,
+    const int64_t* frame_indices,
+    int32_t count,
+    const char* spool_path,
+    int32_t compress,
+    PSProgressCallback callback,
+    void* user_data);
+
+/*
+ * Frame spool: decoded frames stored back to back in one file with an
+ * offset table, replacing a directory of PNGs between pipeline stages.
+ * Uncompressed records are memory-mapped and returned without copying.
+ */
+typedef struct PSSpool PSSpool;
+
+/* One frame of a spool */
+typedef struct PSSpoolFrame {
+  /* Frame index in the source video */
+  int64_t frame_index;
+
+  int32_t width;
+  int32_t height;
+
+  /* OpenCV type (16 = CV_8UC3) */
+  int32_t type;
+
+  /* Bytes per row (rows are contiguous) */
+  int32_t step;
+
+  /* Pixel data, valid until the next ps_spool_get_frame() on this spool
+   * or ps_spool_close(). Read-only. */
+  const uint8_t* data;
+} PSSpoolFrame;
+
+/* Open a spool for reading. Returns NULL on failure. */
+FFI_PLUGIN_EXPORT PSSpool* ps_spool_open(const char* spool_path);
+
+/* Number of frames in [spool] */
+FFI_PLUGIN_EXPORT int32_t ps_spool_count(const PSSpool* spool);
+
+/*
+ * Source video frame index of spool frame [i], read from its record
+ * without decoding the pixels. Returns -1 if [i] is out of range.
+ */
+FFI_PLUGIN_EXPORT int64_t ps_spool_frame_index(const PSSpool* spool, int32_t i);
+
+/*
+ * Get frame [i] (0 <= i < ps_spool_count()) in append order.
+ * Returns 0 on success, -1 on failure.
+ */
+FFI_PLUGIN_EXPORT int32_t ps_spool_get_frame(PSSpool* spool, int32_t i, PSSpoolFrame* out_frame);
+
+/* Unmap and release [spool] (NULL is ignored) */
+FFI_PLUGIN_EXPORT void ps_spool_close(PSSpool* spool);
+
+/* Pixel buffer handed to the engine (rows [step] bytes apart) */
+typedef struct PSImage {
+  int32_t width;
+  int32_t height;
+
+  /* OpenCV type (0 = CV_8UC1, 16 = CV_8UC3 BGR) */
+  int32_t type;
+
+  int32_t step;
+  const uint8_t* data;
+} PSImage;
+
+/* Translation of a frame onto the alignment reference */
+typedef struct PSShift {
+  /* Shift to apply to the frame, in pixels */
+  double dx;
+  double dy;
+
+  /* Correlation peak strength (0 to 1, higher = more reliable) */
+  double response;
+} PSShift;
+
+/*
+ * Regular grid of local shifts: node (i, j) sits at pixel
+ * (origin_x + i * spacing, origin_y + j * spacing). Shifts are
+ * interpolated bilinearly between nodes; beyond the outer nodes the
+ * nearest node's shift holds.
+ */
+typedef struct PSWarpGrid {
+  float origin_x;
+  float origin_y;
+  int32_t spacing;
+
+  /* Nodes per row and rows of nodes (0 = no grid) */
+  int32_t cols;
+  int32_t rows;
+} PSWarpGrid;
+
+/*
+ * Aligner: phase correlation against one reference frame whose spectrum
+ * is computed once, so each frame costs one forward and one inverse
+ * transform. Only a power-of-two square around the planet (sized from the
+ * disk in the reference) is transformed, whatever the frame size.
+ *
+ * With a tile size, that square is also tiled into alignment points for
+ * local alignment: each point is found in the frame by a normalised
+ * cross-correlation search around its globally aligned position, giving
+ * a grid of shifts that follows the seeing across the disk.
+ */
+typedef struct PSAligner PSAligner;
+
+/*
+ * Prepare an aligner for [reference], with alignment points of
+ * [tile_size] pixels (0 = global alignment only).
+ * Returns NULL on failure.
+ */
+FFI_PLUGIN_EXPORT PSAligner* ps_aligner_create(const PSImage* reference, int32_t tile_size);
+
+/*
+ * Shift of [frame] (same size as the reference) onto the reference. May
+ * be called from several threads at once.
+ * Returns 0 on success, -1 on failure.
+ */
+FFI_PLUGIN_EXPORT int32_t ps_aligner_align(const PSAligner* aligner, const PSImage* frame, PSShift* out_shift);
+
+/*
+ * Geometry of [aligner]'s local alignment grid (cols = rows = 0 when it
+ * was created without a tile size or the reference has no room for one).
+ * Returns 0 on success, -1 on failure.
+ */
+FFI_PLUGIN_EXPORT int32_t ps_aligner_grid(const PSAligner* aligner, PSWarpGrid* out_grid);
+
+/*
+ * Local shifts of [frame] given its global [shift] from ps_aligner_align():
+ * cols * rows (dx, dy) pairs, row-major, written to [out_shifts]. Nodes
+ * without a reliable match are filled in from their neighbours. May be
+ * called from several threads at once.
+ * Returns 0 on success, -1 on failure.
+ */
+FFI_PLUGIN_EXPORT int32_t ps_aligner_align_local(const PSAligner* aligner, const PSImage* frame,
+                                                 const PSShift* shift, float* out_shifts);
+
+/* Release [aligner] (NULL is ignored) */
+FFI_PLUGIN_EXPORT void ps_aligner_free(PSAligner* aligner);
+
+/*
+ * Resample [frame] through [grid] with [shifts] (as written by
+ * ps_aligner_align_local) into [out_data], which has the frame's size,
+ * type and step. Bilinear, with reflected borders.
+ * Returns 0 on success, -1 on failure.
+ */
+FFI_PLUGIN_EXPORT int32_t ps_warp_frame(const PSImage* frame, const PSWarpGrid* grid, const float* shifts,
+                                        uint8_t* out_data);
+
+/* Video metadata from the frame index */
+typedef struct PSVideoInfo {
+  int32_t width;
+  int32_t height;
+
+  /* Exact number of frames (counted from the packet index) */
+  int64_t frame_count;
+  int64_t duration_ms;
+  double frame_rate;
+
+  /* Number of keyframes (GOP starts) */
+  int32_t keyframe_count;
+} PSVideoInfo;
+
+/*
+ * Read video metadata from the frame index sidecar ([video_path].psidx).
+ *
+ * The sidecar is built by a demux-only pass and saved on first use, so
+ * later calls (and later seeks) don't need to re-probe the file. SER and
+ * uncompressed AVI files are described by their own header (no sidecar).
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+FFI_PLUGIN_EXPORT int32_t ps_get_video_info(const char* video_path, PSVideoInfo* out_info);
+
+/* Release a result returned by ps_analyze_video() */
+FFI_PLUGIN_EXPORT void ps_free_analysis_result(PSAnalysisResult* result);
+
+/*
+ * Get the last error message for the calling thread.
+ * The returned string is valid until the next API call on this thread.
+ */
+FFI_PLUGIN_EXPORT const char* ps_get_last_error(void);
+
+/* Native library version string */
+FFI_PLUGIN_EXPORT const char* ps_get_version(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLANETARY_STACKER_H */
@@ -0,0 +1,36 @@
+#include "DecodedFrame.hpp"
+
+#include <utility>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace planetary {
+
+DecodedFrame::~DecodedFrame() {
+    reset();
+}
+
+DecodedFrame::DecodedFrame(DecodedFrame&& other) noexcept
+    : frame_(std::exchange(other.frame_, nullptr)),
+      index_(std::exchange(other.index_, -1)),
+      timestamp_(std::exchange(other.timestamp_, 0.0)) {}
+
+DecodedFrame& DecodedFrame::operator=(DecodedFrame&& other) noexcept {
+    if (this != &other) {
+        reset();
+        frame_ = std::exchange(other.frame_, nullptr);
+        index_ = std::exchange(other.index_, -1);
+        timestamp_ = std::exchange(other.timestamp_, 0.0);
+    }
+    return *this;
+}
+
+void DecodedFrame::reset() {
+    av_frame_free(&frame_);
+    index_ = -1;
+    timestamp_ = 0.0;
+}
+
+} // namespace planetary
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+struct AVFrame;
+
+namespace planetary {
+
+/// Reference to a decoded frame that stays valid after the reader moves on.
+///
+/// Holds a libavcodec reference to the frame's buffers (no pixel copy), so
+/// frames can be handed to other threads for scoring while the decoder
+/// keeps running. Move-only; releasing the last reference returns the
+/// buffers to the decoder's pool.
+class DecodedFrame {
+public:
+    DecodedFrame() = default;
+    ~DecodedFrame();
+
+    DecodedFrame(DecodedFrame&& other) noexcept;
+    DecodedFrame& operator=(DecodedFrame&& other) noexcept;
+    DecodedFrame(const DecodedFrame&) = delete;
+    DecodedFrame& operator=(const DecodedFrame&) = delete;
+
+    bool empty() const { return frame_ == nullptr; }
+
+    /// Frame index in the video (presentation order)
+    int64_t index() const { return index_; }
+
+    /// Presentation time in seconds from the start of the stream
+    double timestamp() const { return timestamp_; }
+
+    /// Underlying frame, for FrameConverter
+    const AVFrame* frame() const { return frame_; }
+
+    /// Drop the reference
+    void reset();
+
+private:
+    friend class VideoReader;
+
+    AVFrame* frame_ = nullptr;
+    int64_t index_ = -1;
+    double timestamp_ = 0.0;
+};
+
+} // namespace planetary
@@ -0,0 +1,83 @@
+#include "ExtractionPlanner.hpp"
+
+#include <algorithm>
+
+namespace planetary {
+
+std::vector<ExtractionPlanner::Gop> ExtractionPlanner::plan(
+    std::vector<int64_t> indices,
+    const std::vector<VideoReader::Keyframe>& keyframes
+) {
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    indices.erase(indices.begin(), std::lower_bound(indices.begin(), indices.end(), 0));
+
+    std::vector<Gop> gops;
+    size_t k = 0;
+    for (const int64_t index : indices) {
+        // Advance to the last keyframe at or before this index
+        while (k + 1 < keyframes.size() && keyframes[k + 1].index <= index) {
+            ++k;
+        }
+        const int64_t keyframe = keyframes.empty() || keyframes[k].index > index
+            ? 0
+            : keyframes[k].index;
+
+        if (gops.empty() || gops.back().keyframe_index != keyframe) {
+            gops.push_back({keyframe, {}});
+        }
+        gops.back().frames.push_back(index);
+    }
+
+    return gops;
+}
+
+size_t ExtractionPlanner::extract(
+    VideoReader& reader,
+    const std::vector<Gop>& plan,
+    const FrameSink& sink
+) {
+    cv::Mat bgr;
+    size_t delivered = 0;
+
+    for (const Gop& gop : plan) {
+        // Keep decoding when already inside this GOP (or right before its
+        // keyframe); otherwise a seek lands directly on the keyframe and
+        // skips the rest of the previous GOP.
+        const int64_t position = reader.position();
+        const bool reachable = position >= gop.keyframe_index - 1 &&
+            position >= 0 &&
+            position <= gop.frames.front();
+
+        if (!reachable) {
+            if (!reader.seek(gop.keyframe_index)) {
+                continue;
+            }
+        }
+
+        for (const int64_t index : gop.frames) {
+            bool ok = true;
+            while (reader.position() < index) {
+                if (!reader.grab()) {
+                    ok = false;
+                    break;
+                }
+            }
+            if (!ok) {
+                return delivered;
+            }
+            // Frames missing from the stream are skipped, not substituted
+            if (reader.position() != index) {
+                continue;
+            }
+
+            reader.retrieve(bgr);
+            sink(index, bgr);
+            ++delivered;
+        }
+    }
+
+    return delivered;
+}
+
+} // namespace planetary
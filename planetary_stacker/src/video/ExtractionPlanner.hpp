@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "VideoReader.hpp"
+
+namespace planetary {
+
+/// Plans extraction of selected frames so that every GOP (keyframe
+/// interval) is decoded at most once, in file order.
+///
+/// Seeking per frame re-decodes from the previous keyframe each time, so
+/// extracting N frames costs N x GOP length decodes. Grouping by GOP and
+/// sweeping forward makes the cost scale with video length instead.
+class ExtractionPlanner {
+public:
+    /// Requested frames that share a keyframe
+    struct Gop {
+        int64_t keyframe_index;
+        std::vector<int64_t> frames;  // Sorted, unique
+    };
+
+    /// Group [indices] (any order, duplicates allowed) by the GOP that
+    /// contains them. [keyframes] must be sorted by index.
+    static std::vector<Gop> plan(
+        std::vector<int64_t> indices,
+        const std::vector<VideoReader::Keyframe>& keyframes
+    );
+
+    /// Frame sink: (frame index, BGR image). The image is only valid for
+    /// the duration of the call.
+    using FrameSink = std::function<void(int64_t, const cv::Mat&)>;
+
+    /// Decode the planned GOPs in one forward sweep, passing every
+    /// requested frame to [sink]. Seeks only when the next GOP is not
+    /// reachable by decoding forward from the current position.
+    /// Returns the number of frames delivered.
+    static size_t extract(
+        VideoReader& reader,
+        const std::vector<Gop>& plan,
+        const FrameSink& sink
+    );
+};
+
+} // namespace planetary
@@ -0,0 +1,84 @@
+#include "FrameConverter.hpp"
+
+#include <stdexcept>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+namespace planetary {
+
+namespace {
+
+// True when plane 0 of [format] is a tightly packed 8-bit luma plane
+// (planar/semi-planar YUV, GRAY8) that can be wrapped without conversion.
+bool hasDirectLuma(AVPixelFormat format) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+    if (desc == nullptr) {
+        return false;
+    }
+    if (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL)) {
+        return false;
+    }
+    return desc->comp[0].plane == 0 && desc->comp[0].step == 1 &&
+           desc->comp[0].offset == 0 && desc->comp[0].depth == 8;
+}
+
+} // namespace
+
+FrameConverter::~FrameConverter() {
+    sws_freeContext(bgr_ctx_);
+    sws_freeContext(luma_ctx_);
+}
+
+void FrameConverter::toBgr(const AVFrame* frame, cv::Mat& bgr) {
+    const int width = frame->width;
+    const int height = frame->height;
+    bgr.create(height, width, CV_8UC3);
+
+    bgr_ctx_ = sws_getCachedContext(
+        bgr_ctx_,
+        width, height, static_cast<AVPixelFormat>(frame->format),
+        width, height, AV_PIX_FMT_BGR24,
+        SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (bgr_ctx_ == nullptr) {
+        throw std::runtime_error("Cannot create colour converter");
+    }
+
+    uint8_t* dst[] = {bgr.data};
+    int dst_stride[] = {static_cast<int>(bgr.step)};
+    sws_scale(bgr_ctx_, frame->data, frame->linesize, 0, height, dst, dst_stride);
+}
+
+bool FrameConverter::toLuma(const AVFrame* frame, cv::Mat& gray) {
+    const int width = frame->width;
+    const int height = frame->height;
+    const auto format = static_cast<AVPixelFormat>(frame->format);
+
+    if (hasDirectLuma(format) && frame->linesize[0] > 0) {
+        gray = cv::Mat(height, width, CV_8UC1, frame->data[0],
+                       static_cast<size_t>(frame->linesize[0]));
+        return true;
+    }
+
+    // RGB, packed YUV or >8-bit output: convert (still cheaper than BGR)
+    luma_buffer_.create(height, width, CV_8UC1);
+    luma_ctx_ = sws_getCachedContext(
+        luma_ctx_,
+        width, height, format,
+        width, height, AV_PIX_FMT_GRAY8,
+        SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (luma_ctx_ == nullptr) {
+        throw std::runtime_error("Cannot create luma converter");
+    }
+
+    uint8_t* dst[] = {luma_buffer_.data};
+    int dst_stride[] = {static_cast<int>(luma_buffer_.step)};
+    sws_scale(luma_ctx_, frame->data, frame->linesize, 0, height, dst, dst_stride);
+    gray = luma_buffer_;
+    return false;
+}
+
+} // namespace planetary
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+struct AVFrame;
+struct SwsContext;
+
+namespace planetary {
+
+/// Converts decoded frames to OpenCV images.
+///
+/// Owns the cached swscale contexts and the luma scratch buffer, so each
+/// thread that converts frames needs its own instance.
+class FrameConverter {
+public:
+    FrameConverter() = default;
+    ~FrameConverter();
+
+    FrameConverter(const FrameConverter&) = delete;
+    FrameConverter& operator=(const FrameConverter&) = delete;
+
+    /// Convert [frame] to BGR. Reuses the storage of [bgr] when it already
+    /// has the right size.
+    void toBgr(const AVFrame* frame, cv::Mat& bgr);
+
+    /// Luma (Y) plane of [frame] as 8-bit grayscale.
+    ///
+    /// For 8-bit YUV and gray frames this is a zero-copy view into the
+    /// frame's buffer (valid while the frame is referenced). Other formats
+    /// are converted into an internal buffer.
+    /// Returns true when [gray] is a zero-copy view.
+    bool toLuma(const AVFrame* frame, cv::Mat& gray);
+
+private:
+    SwsContext* bgr_ctx_ = nullptr;
+    SwsContext* luma_ctx_ = nullptr;
+    cv::Mat luma_buffer_;
+};
+
+} // namespace planetary
@@ -0,0 +1,195 @@
+#include "FrameIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+namespace planetary {
+
+namespace {
+
+constexpr char kMagic[4] = {'P', 'S', 'F', 'I'};
+constexpr uint32_t kVersion = 1;
+
+struct SidecarHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t video_size;
+    int64_t video_mtime;
+    int32_t width;
+    int32_t height;
+    int32_t time_base_num;
+    int32_t time_base_den;
+    int32_t fps_num;
+    int32_t fps_den;
+    int64_t start_pts;
+    uint64_t frame_count;
+    uint8_t reserved[16];
+};
+
+static_assert(sizeof(SidecarHeader) == 80, "sidecar header must be 80 bytes");
+static_assert(sizeof(FrameIndex::Entry) == 24, "sidecar entry must be 24 bytes");
+
+// Size and modification time identify the exact video the index was built for
+bool statVideo(const std::string& video_path, uint64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    size = std::filesystem::file_size(video_path, ec);
+    if (ec) {
+        return false;
+    }
+    const auto time = std::filesystem::last_write_time(video_path, ec);
+    if (ec) {
+        return false;
+    }
+    mtime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+} // namespace
+
+double FrameIndex::fps() const {
+    return fps_num > 0 && fps_den > 0 ? static_cast<double>(fps_num) / fps_den : 0.0;
+}
+
+double FrameIndex::timeBase() const {
+    return time_base_den > 0 ? static_cast<double>(time_base_num) / time_base_den : 0.0;
+}
+
+double FrameIndex::durationSeconds() const {
+    if (entries.empty()) {
+        return 0.0;
+    }
+    const double frame_duration = fps() > 0 ? 1.0 / fps() : 0.0;
+    return (entries.back().pts - start_pts) * timeBase() + frame_duration;
+}
+
+int64_t FrameIndex::indexFromPts(int64_t pts) const {
+    if (entries.empty()) {
+        return 0;
+    }
+    const auto it = std::lower_bound(entries.begin(), entries.end(), pts,
+        [](const Entry& e, int64_t value) { return e.pts < value; });
+    return std::min<int64_t>(it - entries.begin(), frameCount() - 1);
+}
+
+int64_t FrameIndex::keyframeAtOrBefore(int64_t index) const {
+    for (int64_t i = std::min(index, frameCount() - 1); i >= 0; --i) {
+        if (entries[i].flags & kKeyframe) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+std::vector<FrameIndex::Keyframe> FrameIndex::keyframes() const {
+    std::vector<Keyframe> result;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].flags & kKeyframe) {
+            result.push_back({static_cast<int64_t>(i), entries[i].pts});
+        }
+    }
+    return result;
+}
+
+void FrameIndex::finalize() {
+    std::stable_sort(entries.begin(), entries.end(),
+        [](const Entry& a, const Entry& b) { return a.pts < b.pts; });
+    entries.erase(std::unique(entries.begin(), entries.end(),
+        [](const Entry& a, const Entry& b) { return a.pts == b.pts; }), entries.end());
+}
+
+std::string FrameIndex::sidecarPath(const std::string& video_path) {
+    return video_path + ".psidx";
+}
+
+bool FrameIndex::save(const std::string& video_path) const {
+    SidecarHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    if (!statVideo(video_path, header.video_size, header.video_mtime)) {
+        return false;
+    }
+    header.width = width;
+    header.height = height;
+    header.time_base_num = time_base_num;
+    header.time_base_den = time_base_den;
+    header.fps_num = fps_num;
+    header.fps_den = fps_den;
+    header.start_pts = start_pts;
+    header.frame_count = entries.size();
+
+    // Write to a temp file and rename so a crash never leaves a torn index
+    const std::string path = sidecarPath(video_path);
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(entries.data()),
+                  static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+        if (!out) {
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    return true;
+}
+
+bool FrameIndex::load(const std::string& video_path, FrameIndex& out) {
+    std::ifstream in(sidecarPath(video_path), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    SidecarHeader header{};
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kVersion) {
+        return false;
+    }
+
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (!statVideo(video_path, size, mtime) ||
+        size != header.video_size || mtime != header.video_mtime) {
+        return false;
+    }
+
+    // Guard against a truncated or corrupt sidecar before allocating
+    std::error_code ec;
+    const uint64_t sidecar_size = std::filesystem::file_size(sidecarPath(video_path), ec);
+    if (ec || header.frame_count != (sidecar_size - sizeof(header)) / sizeof(Entry) ||
+        (sidecar_size - sizeof(header)) % sizeof(Entry) != 0) {
+        return false;
+    }
+
+    FrameIndex index;
+    index.width = header.width;
+    index.height = header.height;
+    index.time_base_num = header.time_base_num;
+    index.time_base_den = header.time_base_den;
+    index.fps_num = header.fps_num;
+    index.fps_den = header.fps_den;
+    index.start_pts = header.start_pts;
+    index.entries.resize(header.frame_count);
+    if (!in.read(reinterpret_cast<char*>(index.entries.data()),
+                 static_cast<std::streamsize>(index.entries.size() * sizeof(Entry)))) {
+        return false;
+    }
+
+    out = std::move(index);
+    return true;
+}
+
+} // namespace planetary
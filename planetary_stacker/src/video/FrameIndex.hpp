@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace planetary {
+
+/// Frame-accurate packet index of a video stream.
+///
+/// Maps frame number (presentation order) to PTS, packet byte offset and
+/// keyframe flag. Built once by a demux-only pass (or recorded for free
+/// during a full sequential decode) and persisted as a binary sidecar next
+/// to the video, so later runs get exact frame counts and seeks without
+/// re-probing.
+///
+/// Sidecar layout (little-endian): a fixed 80-byte header followed by
+/// frame_count 24-byte entries. The header stores the video's size and
+/// modification time; a sidecar that doesn't match is ignored.
+class FrameIndex {
+public:
+    static constexpr uint32_t kKeyframe = 1u << 0;
+
+    struct Entry {
+        int64_t pts;        // Stream timestamp
+        int64_t pos;        // Byte offset of the packet in the file (-1 if unknown)
+        uint32_t flags;     // kKeyframe
+        uint32_t reserved;
+    };
+
+    /// A keyframe (GOP start) in presentation order
+    struct Keyframe {
+        int64_t index;  // Frame index of the keyframe
+        int64_t pts;    // Stream timestamp of the keyframe
+    };
+
+    int width = 0;
+    int height = 0;
+    int time_base_num = 0;
+    int time_base_den = 1;
+    int fps_num = 0;
+    int fps_den = 1;
+    int64_t start_pts = 0;
+
+    /// Entries in presentation order
+    std::vector<Entry> entries;
+
+    bool empty() const { return entries.empty(); }
+    int64_t frameCount() const { return static_cast<int64_t>(entries.size()); }
+    double fps() const;
+    double timeBase() const;
+    double durationSeconds() const;
+
+    /// Frame index whose PTS is closest at or after [pts] (clamped to range)
+    int64_t indexFromPts(int64_t pts) const;
+
+    /// Index of the last keyframe at or before [index] (0 if none)
+    int64_t keyframeAtOrBefore(int64_t index) const;
+
+    std::vector<Keyframe> keyframes() const;
+
+    /// Sort entries recorded in decode order into presentation order
+    void finalize();
+
+    /// Sidecar location for [video_path]
+    static std::string sidecarPath(const std::string& video_path);
+
+    /// Write the sidecar for [video_path]. Returns false on I/O error
+    /// (e.g. read-only media); the index is an optimisation only.
+    bool save(const std::string& video_path) const;
+
+    /// Load the sidecar for [video_path]. Returns false if it is missing,
+    /// corrupt or stale.
+    static bool load(const std::string& video_path, FrameIndex& out);
+};
+
+} // namespace planetary
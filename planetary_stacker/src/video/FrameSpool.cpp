@@ -0,0 +1,271 @@
+#include "FrameSpool.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef PS_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace planetary {
+
+namespace {
+
+constexpr char kMagic[4] = {'P', 'S', 'S', 'P'};
+constexpr uint32_t kVersion = 1;
+
+struct SpoolHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t alignment;
+    uint32_t reserved0;
+    uint64_t frame_count;
+    uint64_t table_offset;
+    uint8_t reserved[32];
+};
+
+static_assert(sizeof(SpoolHeader) == 64, "spool header must be 64 bytes");
+static_assert(sizeof(FrameSpool::Record) == 40, "spool record must be 40 bytes");
+static_assert(sizeof(SpoolHeader) % FrameSpool::kAlignment == 0,
+              "first record must start aligned");
+
+size_t imageBytes(int rows, int cols, int type) {
+    return static_cast<size_t>(rows) * cols * CV_ELEM_SIZE(type);
+}
+
+} // namespace
+
+bool FrameSpool::hasLz4() {
+#ifdef PS_HAVE_LZ4
+    return true;
+#else
+    return false;
+#endif
+}
+
+// --- FrameSpool -------------------------------------------------------------
+
+FrameSpool::~FrameSpool() {
+    close();
+}
+
+void FrameSpool::open(const std::string& path) {
+    close();
+
+    // Frames are consumed front to back by alignment and stacking
+    file_.open(path, MappedFile::Access::kSequential);
+    data_ = file_.data();
+    length_ = file_.size();
+
+    SpoolHeader header{};
+    if (length_ >= sizeof(header)) {
+        std::memcpy(&header, data_, sizeof(header));
+    }
+    const bool valid_header =
+        length_ >= sizeof(header) &&
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+        header.version == kVersion &&
+        header.table_offset >= sizeof(header) &&
+        header.table_offset <= length_ &&
+        header.frame_count <= (length_ - header.table_offset) / sizeof(Record);
+    if (!valid_header) {
+        close();
+        throw std::runtime_error("Invalid or unfinished frame spool: " + path);
+    }
+
+    records_.resize(header.frame_count);
+    std::memcpy(records_.data(), data_ + header.table_offset, records_.size() * sizeof(Record));
+
+    for (const auto& r : records_) {
+        const bool valid_record =
+            r.rows > 0 && r.cols > 0 &&
+            r.offset <= header.table_offset &&
+            r.stored_size <= header.table_offset - r.offset &&
+            (r.compression != static_cast<uint32_t>(Compression::kRaw) ||
+             r.stored_size == imageBytes(r.rows, r.cols, r.type));
+        if (!valid_record) {
+            close();
+            throw std::runtime_error("Corrupt frame spool record in: " + path);
+        }
+    }
+}
+
+void FrameSpool::close() {
+    file_.close();
+    data_ = nullptr;
+    length_ = 0;
+    records_.clear();
+}
+
+int64_t FrameSpool::find(int64_t frame_index) const {
+    for (size_t i = 0; i < records_.size(); ++i) {
+        if (records_[i].frame_index == frame_index) {
+            return static_cast<int64_t>(i);
+        }
+    }
+    return -1;
+}
+
+cv::Mat FrameSpool::frame(size_t i, cv::Mat& scratch) const {
+    const Record& r = records_.at(i);
+    const uint8_t* src = data_ + r.offset;
+
+    if (r.compression == static_cast<uint32_t>(Compression::kRaw)) {
+        // The mapping is read-only; callers that modify frames must clone
+        return cv::Mat(r.rows, r.cols, r.type, const_cast<uint8_t*>(src));
+    }
+
+    if (r.compression != static_cast<uint32_t>(Compression::kLz4)) {
+        throw std::runtime_error("Unknown frame spool compression");
+    }
+
+#ifdef PS_HAVE_LZ4
+    scratch.create(r.rows, r.cols, r.type);
+    const int expected = static_cast<int>(imageBytes(r.rows, r.cols, r.type));
+    const int decoded = LZ4_decompress_safe(
+        reinterpret_cast<const char*>(src), reinterpret_cast<char*>(scratch.data),
+        static_cast<int>(r.stored_size), expected);
+    if (decoded != expected) {
+        throw std::runtime_error("Corrupt LZ4 frame in spool");
+    }
+    return scratch;
+#else
+    (void)scratch;
+    throw std::runtime_error("Frame spool uses LZ4 but this build has no LZ4 support");
+#endif
+}
+
+cv::Mat FrameSpool::frame(size_t i) const {
+    cv::Mat scratch;
+    return frame(i, scratch);
+}
+
+// --- FrameSpoolWriter -------------------------------------------------------
+
+FrameSpoolWriter::FrameSpoolWriter(const std::string& path, FrameSpool::Compression compression)
+    : path_(path),
+      compression_(FrameSpool::hasLz4() ? compression : FrameSpool::Compression::kRaw) {
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr) {
+        throw std::runtime_error("Cannot create frame spool: " + path);
+    }
+
+    // Placeholder; finish() rewrites it with the table offset
+    const SpoolHeader header{};
+    write(&header, sizeof(header));
+}
+
+FrameSpoolWriter::~FrameSpoolWriter() {
+    if (file_ != nullptr) {
+        std::fclose(file_);
+        // An unfinished spool has no offset table and can't be read
+        if (!finished_) {
+            std::remove(path_.c_str());
+        }
+    }
+}
+
+void FrameSpoolWriter::append(int64_t frame_index, const cv::Mat& image) {
+    if (image.empty()) {
+        return;
+    }
+
+    // Strided views (e.g. decoder planes) are packed first
+    cv::Mat packed = image;
+    if (!image.isContinuous()) {
+        packed = image.clone();
+    }
+
+    if (compression_ == FrameSpool::Compression::kLz4) {
+        compressLz4(packed, scratch_);
+        writeRecord(frame_index, packed.rows, packed.cols, packed.type(),
+                    FrameSpool::Compression::kLz4, scratch_.data(), scratch_.size());
+    } else {
+        writeRecord(frame_index, packed.rows, packed.cols, packed.type(),
+                    FrameSpool::Compression::kRaw, packed.data,
+                    imageBytes(packed.rows, packed.cols, packed.type()));
+    }
+}
+
+void FrameSpoolWriter::appendLz4(int64_t frame_index, int rows, int cols, int type,
+                                 const std::vector<uint8_t>& compressed) {
+    writeRecord(frame_index, rows, cols, type, FrameSpool::Compression::kLz4,
+                compressed.data(), compressed.size());
+}
+
+void FrameSpoolWriter::compressLz4(const cv::Mat& image, std::vector<uint8_t>& out) {
+#ifdef PS_HAVE_LZ4
+    const int source_size = static_cast<int>(image.total() * image.elemSize());
+    out.resize(static_cast<size_t>(LZ4_compressBound(source_size)));
+    const int written = LZ4_compress_default(
+        reinterpret_cast<const char*>(image.data), reinterpret_cast<char*>(out.data()),
+        source_size, static_cast<int>(out.size()));
+    if (written <= 0) {
+        throw std::runtime_error("LZ4 compression failed");
+    }
+    out.resize(static_cast<size_t>(written));
+#else
+    (void)image;
+    (void)out;
+    throw std::runtime_error("LZ4 support not built");
+#endif
+}
+
+void FrameSpoolWriter::writeRecord(int64_t frame_index, int rows, int cols, int type,
+                                   FrameSpool::Compression compression,
+                                   const void* data, size_t size) {
+    if (finished_) {
+        throw std::logic_error("append() after finish()");
+    }
+
+    FrameSpool::Record record{};
+    record.frame_index = frame_index;
+    record.offset = offset_;
+    record.stored_size = size;
+    record.rows = rows;
+    record.cols = cols;
+    record.type = type;
+    record.compression = static_cast<uint32_t>(compression);
+
+    write(data, size);
+    pad();
+    records_.push_back(record);
+}
+
+void FrameSpoolWriter::finish() {
+    if (finished_) {
+        return;
+    }
+
+    SpoolHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.alignment = FrameSpool::kAlignment;
+    header.frame_count = records_.size();
+    header.table_offset = offset_;
+
+    write(records_.data(), records_.size() * sizeof(FrameSpool::Record));
+    if (std::fseek(file_, 0, SEEK_SET) != 0 ||
+        std::fwrite(&header, sizeof(header), 1, file_) != 1 ||
+        std::fflush(file_) != 0) {
+        throw std::runtime_error("Cannot finish frame spool: " + path_);
+    }
+    finished_ = true;
+}
+
+void FrameSpoolWriter::write(const void* data, size_t size) {
+    if (size > 0 && std::fwrite(data, 1, size, file_) != size) {
+        throw std::runtime_error("Cannot write frame spool: " + path_);
+    }
+    offset_ += size;
+}
+
+void FrameSpoolWriter::pad() {
+    static const uint8_t zeros[FrameSpool::kAlignment] = {};
+    const uint64_t remainder = offset_ % FrameSpool::kAlignment;
+    if (remainder != 0) {
+        write(zeros, FrameSpool::kAlignment - remainder);
+    }
+}
+
+} // namespace planetary
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "MappedFile.hpp"
+
+namespace planetary {
+
+/// Binary frame spool: decoded frames stored back to back in one file.
+///
+/// Replaces the directory of PNGs between extraction and alignment. Raw
+/// records are written with one memcpy and read back through mmap as
+/// zero-copy cv::Mat views, so spooling N frames costs memory bandwidth
+/// instead of PNG encode/decode time. LZ4 records (when built with LZ4)
+/// trade a fast decompress for a much smaller file, which suits planetary
+/// footage that is mostly black sky.
+///
+/// Layout (little-endian):
+///   Header        64 bytes, table_offset filled in by finish()
+///   Records       each starting on a kAlignment boundary
+///   Offset table  frame_count Record entries, in append order
+class FrameSpool {
+public:
+    static constexpr uint32_t kAlignment = 64;
+
+    enum class Compression : uint32_t {
+        kRaw = 0,
+        kLz4 = 1,
+    };
+
+    /// Offset table entry
+    struct Record {
+        int64_t frame_index;    // Frame index in the source video
+        uint64_t offset;        // Byte offset of the record in the file
+        uint64_t stored_size;   // Bytes on disk
+        int32_t rows;
+        int32_t cols;
+        int32_t type;           // OpenCV type (CV_8UC3, CV_16UC1, ...)
+        uint32_t compression;   // Compression
+    };
+
+    /// True when this build can write and read LZ4 records
+    static bool hasLz4();
+
+    FrameSpool() = default;
+    ~FrameSpool();
+
+    FrameSpool(const FrameSpool&) = delete;
+    FrameSpool& operator=(const FrameSpool&) = delete;
+
+    /// Map [path] read-only. Throws std::runtime_error if it is missing
+    /// or not a finished spool.
+    void open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return data_ != nullptr; }
+    size_t size() const { return records_.size(); }
+    const Record& record(size_t i) const { return records_[i]; }
+
+    /// Position of frame [frame_index] in the spool, or -1
+    int64_t find(int64_t frame_index) const;
+
+    /// Frame [i]. Raw records are zero-copy views into the mapping (valid
+    /// until close()); LZ4 records are decompressed into [scratch], which
+    /// the returned Mat shares.
+    cv::Mat frame(size_t i, cv::Mat& scratch) const;
+
+    /// Same, always returning a view or fresh buffer
+    cv::Mat frame(size_t i) const;
+
+private:
+    MappedFile file_;
+    const uint8_t* data_ = nullptr;
+    size_t length_ = 0;
+    std::vector<Record> records_;
+};
+
+/// Streams frames into a spool file. Records are appended as they arrive;
+/// the offset table and final header are written by finish().
+class FrameSpoolWriter {
+public:
+    /// Create (truncate) [path]. Throws std::runtime_error on failure.
+    /// [compression] falls back to raw when LZ4 is not available.
+    explicit FrameSpoolWriter(
+        const std::string& path,
+        FrameSpool::Compression compression = FrameSpool::Compression::kRaw
+    );
+    ~FrameSpoolWriter();
+
+    FrameSpoolWriter(const FrameSpoolWriter&) = delete;
+    FrameSpoolWriter& operator=(const FrameSpoolWriter&) = delete;
+
+    /// Append [image] (any continuous or strided Mat) as frame [frame_index]
+    void append(int64_t frame_index, const cv::Mat& image);
+
+    /// Append an already LZ4-compressed record of a rows x cols [type]
+    /// image (e.g. from the analysis cache) without recompressing
+    void appendLz4(int64_t frame_index, int rows, int cols, int type,
+                   const std::vector<uint8_t>& compressed);
+
+    /// Write the offset table and header. Further appends are invalid.
+    void finish();
+
+    size_t size() const { return records_.size(); }
+
+    /// LZ4-compress a continuous [image] into [out] (requires hasLz4())
+    static void compressLz4(const cv::Mat& image, std::vector<uint8_t>& out);
+
+private:
+    void writeRecord(int64_t frame_index, int rows, int cols, int type,
+                     FrameSpool::Compression compression,
+                     const void* data, size_t size);
+    void write(const void* data, size_t size);
+    void pad();
+
+    std::string path_;
+    std::FILE* file_ = nullptr;
+    FrameSpool::Compression compression_;
+    uint64_t offset_ = 0;
+    std::vector<FrameSpool::Record> records_;
+    std::vector<uint8_t> scratch_;
+    bool finished_ = false;
+};
+
+} // namespace planetary
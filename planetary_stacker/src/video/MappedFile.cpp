@@ -0,0 +1,72 @@
+#include "MappedFile.hpp"
+
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define PS_NO_MMAP 1
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace planetary {
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+void MappedFile::open(const std::string& path, Access access) {
+    close();
+
+#ifdef PS_NO_MMAP
+    (void)access;
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    fallback_.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(fallback_.data()),
+                 static_cast<std::streamsize>(fallback_.size()))) {
+        throw std::runtime_error("Cannot read file: " + path);
+    }
+    data_ = fallback_.data();
+    size_ = fallback_.size();
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot read file: " + path);
+    }
+    void* mapping = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Cannot map file: " + path);
+    }
+    ::madvise(mapping, static_cast<size_t>(st.st_size),
+              access == Access::kSequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+    data_ = static_cast<const uint8_t*>(mapping);
+    size_ = static_cast<size_t>(st.st_size);
+#endif
+}
+
+void MappedFile::close() {
+#ifndef PS_NO_MMAP
+    if (data_ != nullptr) {
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+    }
+#endif
+    fallback_.clear();
+    fallback_.shrink_to_fit();
+    data_ = nullptr;
+    size_ = 0;
+}
+
+} // namespace planetary
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace planetary {
+
+/// Read-only memory mapping of a whole file.
+///
+/// Pages are faulted in on first access, so a multi-gigabyte capture costs
+/// nothing to open and frames can be used in place. Platforms without mmap
+/// read the file into memory instead.
+class MappedFile {
+public:
+    /// Expected access pattern, passed to the kernel as a read-ahead hint
+    enum class Access { kSequential, kRandom };
+
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// Map [path]. Throws std::runtime_error if it can't be opened.
+    void open(const std::string& path, Access access = Access::kSequential);
+    void close();
+
+    bool isOpen() const { return data_ != nullptr; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<uint8_t> fallback_;   // Platforms without mmap
+};
+
+} // namespace planetary
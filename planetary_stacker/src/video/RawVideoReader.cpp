@@ -0,0 +1,436 @@
+#include "RawVideoReader.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+
+#include <opencv2/imgproc.hpp>
+
+namespace planetary {
+
+namespace {
+
+// --- SER ----------------------------------------------------------------------
+
+constexpr char kSerMagic[14] = {'L', 'U', 'C', 'A', 'M', '-', 'R', 'E', 'C', 'O', 'R', 'D', 'E', 'R'};
+constexpr size_t kSerHeaderSize = 178;
+
+// Field offsets in the (packed) SER header
+constexpr size_t kSerColorId = 18;
+constexpr size_t kSerLittleEndian = 22;
+constexpr size_t kSerWidth = 26;
+constexpr size_t kSerHeight = 30;
+constexpr size_t kSerDepth = 34;
+constexpr size_t kSerFrameCount = 38;
+
+// SER timestamps are 100 ns ticks
+constexpr double kSerTicksPerSecond = 1e7;
+
+// --- AVI ----------------------------------------------------------------------
+
+// Enough of the file to hold the AVI header lists for isRawVideo()
+constexpr size_t kProbeBytes = 64 * 1024;
+
+constexpr uint32_t kBiRgb = 0;
+
+struct AviFormat {
+    int width = 0;
+    int height = 0;
+    int bit_count = 0;
+    uint32_t compression = 0;
+    bool bottom_up = false;
+    int stream = -1;            // Number of the video stream ("00db" -> 0)
+    double fps = 0.0;
+};
+
+uint16_t readU16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t readU32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+int32_t readI32(const uint8_t* p) {
+    return static_cast<int32_t>(readU32(p));
+}
+
+int64_t readI64(const uint8_t* p) {
+    return static_cast<int64_t>(readU32(p)) | (static_cast<int64_t>(readU32(p + 4)) << 32);
+}
+
+bool isFourcc(const uint8_t* p, const char* code) {
+    return std::memcmp(p, code, 4) == 0;
+}
+
+uint32_t fourcc(const char* code) {
+    return readU32(reinterpret_cast<const uint8_t*>(code));
+}
+
+bool isGrayFourcc(uint32_t compression) {
+    return compression == fourcc("Y800") || compression == fourcc("Y8  ") ||
+           compression == fourcc("GREY");
+}
+
+bool isSupportedAvi(const AviFormat& format) {
+    if (format.width <= 0 || format.height <= 0 || format.stream < 0) {
+        return false;
+    }
+    if (format.compression == kBiRgb) {
+        return format.bit_count == 8 || format.bit_count == 24;
+    }
+    return isGrayFourcc(format.compression) && format.bit_count == 8;
+}
+
+// Walk the RIFF chunks in [begin, end), descending into LIST chunks.
+// [chunk] sees every non-list chunk as (id, body, size); [enterList] sees
+// each list type and returns whether to descend into it.
+void walkChunks(const uint8_t* data, size_t begin, size_t end,
+                const std::function<bool(const uint8_t*)>& enterList,
+                const std::function<void(const uint8_t*, size_t, size_t)>& chunk) {
+    size_t pos = begin;
+    while (pos + 8 <= end) {
+        const uint8_t* id = data + pos;
+        const size_t size = readU32(data + pos + 4);
+        const size_t body = pos + 8;
+        const size_t body_end = std::min(body + size, end);
+
+        if (isFourcc(id, "LIST") && body + 4 <= end) {
+            if (enterList(data + body)) {
+                walkChunks(data, body + 4, body_end, enterList, chunk);
+            }
+        } else {
+            chunk(id, body, body_end - body);
+        }
+        // Chunks are padded to an even size
+        pos = body + size + (size & 1);
+    }
+}
+
+// Parse the header lists of the first RIFF AVI chunk in [data, size)
+AviFormat parseAviHeader(const uint8_t* data, size_t size) {
+    AviFormat format;
+    if (size < 12 || !isFourcc(data, "RIFF") || !isFourcc(data + 8, "AVI ")) {
+        return format;
+    }
+
+    int stream_count = 0;
+    bool video_stream = false;
+    const size_t end = std::min<size_t>(size, 8 + static_cast<size_t>(readU32(data + 4)));
+    walkChunks(data, 12, end,
+        [](const uint8_t* type) { return isFourcc(type, "hdrl") || isFourcc(type, "strl"); },
+        [&](const uint8_t* id, size_t body, size_t length) {
+            const uint8_t* p = data + body;
+            if (isFourcc(id, "avih") && length >= 4) {
+                const uint32_t us_per_frame = readU32(p);
+                format.fps = us_per_frame > 0 ? 1e6 / us_per_frame : 0.0;
+            } else if (isFourcc(id, "strh") && length >= 4) {
+                video_stream = isFourcc(p, "vids") && format.stream < 0;
+                if (video_stream) {
+                    format.stream = stream_count;
+                }
+                ++stream_count;
+            } else if (isFourcc(id, "strf") && video_stream && length >= 20) {
+                // BITMAPINFOHEADER
+                const int32_t height = readI32(p + 8);
+                format.width = readI32(p + 4);
+                format.height = height < 0 ? -height : height;
+                format.bit_count = readU16(p + 14);
+                format.compression = readU32(p + 16);
+                // BI_RGB rows are stored bottom up unless the height is
+                // negative; FOURCC formats are top down
+                format.bottom_up = format.compression == kBiRgb && height > 0;
+                video_stream = false;
+            }
+        });
+    return format;
+}
+
+// OpenCV names Bayer patterns by the second row, one column in
+int bayerCode(RawVideoReader::ColorFormat color, bool to_gray) {
+    switch (color) {
+        case RawVideoReader::ColorFormat::kBayerRggb:
+            return to_gray ? cv::COLOR_BayerBG2GRAY : cv::COLOR_BayerBG2BGR;
+        case RawVideoReader::ColorFormat::kBayerGrbg:
+            return to_gray ? cv::COLOR_BayerGB2GRAY : cv::COLOR_BayerGB2BGR;
+        case RawVideoReader::ColorFormat::kBayerGbrg:
+            return to_gray ? cv::COLOR_BayerGR2GRAY : cv::COLOR_BayerGR2BGR;
+        default:
+            return to_gray ? cv::COLOR_BayerRG2GRAY : cv::COLOR_BayerRG2BGR;
+    }
+}
+
+} // namespace
+
+bool RawVideoReader::isRawVideo(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::vector<uint8_t> head(kProbeBytes);
+    in.read(reinterpret_cast<char*>(head.data()), static_cast<std::streamsize>(head.size()));
+    head.resize(static_cast<size_t>(in.gcount()));
+
+    if (head.size() >= kSerHeaderSize && std::memcmp(head.data(), kSerMagic, sizeof(kSerMagic)) == 0) {
+        return true;
+    }
+    return isSupportedAvi(parseAviHeader(head.data(), head.size()));
+}
+
+RawVideoReader::RawVideoReader(const std::string& path) {
+    // Analysis reads front to back; extraction jumps around, but every
+    // frame is a single contiguous read either way
+    file_.open(path, MappedFile::Access::kSequential);
+
+    if (file_.size() >= kSerHeaderSize &&
+        std::memcmp(file_.data(), kSerMagic, sizeof(kSerMagic)) == 0) {
+        parseSer(path);
+    } else {
+        parseAvi(path);
+    }
+
+    if (offsets_.empty()) {
+        throw std::runtime_error("No frames found in: " + path);
+    }
+}
+
+void RawVideoReader::parseSer(const std::string& path) {
+    const uint8_t* header = file_.data();
+    const int32_t color_id = readI32(header + kSerColorId);
+    width_ = readI32(header + kSerWidth);
+    height_ = readI32(header + kSerHeight);
+    bit_depth_ = readI32(header + kSerDepth);
+    const int32_t declared_frames = readI32(header + kSerFrameCount);
+
+    switch (color_id) {
+        case 0:   color_ = ColorFormat::kMono; break;
+        case 8:   color_ = ColorFormat::kBayerRggb; break;
+        case 9:   color_ = ColorFormat::kBayerGrbg; break;
+        case 10:  color_ = ColorFormat::kBayerGbrg; break;
+        case 11:  color_ = ColorFormat::kBayerBggr; break;
+        case 100: color_ = ColorFormat::kRgb; break;
+        case 101: color_ = ColorFormat::kBgr; break;
+        default:
+            throw std::runtime_error("Unsupported SER colour format " + std::to_string(color_id) +
+                                     " in: " + path);
+    }
+    if (width_ <= 0 || height_ <= 0 || bit_depth_ < 1 || bit_depth_ > 16 || declared_frames < 0) {
+        throw std::runtime_error("Invalid SER header in: " + path);
+    }
+
+    // The spec says 1 = little-endian, but capture software has always
+    // written 0 for its little-endian data, and readers follow the
+    // software. Only 16-bit samples are affected.
+    big_endian_ = readI32(header + kSerLittleEndian) != 0;
+
+    channels_ = (color_ == ColorFormat::kRgb || color_ == ColorFormat::kBgr) ? 3 : 1;
+    const size_t sample_bytes = bit_depth_ > 8 ? 2 : 1;
+    row_stride_ = static_cast<size_t>(width_) * channels_ * sample_bytes;
+    const size_t frame_bytes = row_stride_ * height_;
+
+    // A capture cut short still has its frames; trust the file size
+    const size_t available = (file_.size() - kSerHeaderSize) / frame_bytes;
+    const size_t frames = std::min(static_cast<size_t>(declared_frames), available);
+    offsets_.reserve(frames);
+    for (size_t i = 0; i < frames; ++i) {
+        offsets_.push_back(kSerHeaderSize + i * frame_bytes);
+    }
+
+    // Optional trailer: one timestamp per frame
+    const size_t trailer = kSerHeaderSize + frames * frame_bytes;
+    if (frames > 1 && file_.size() - trailer >= frames * sizeof(int64_t)) {
+        const int64_t first = readI64(file_.data() + trailer);
+        const int64_t last = readI64(file_.data() + trailer + (frames - 1) * sizeof(int64_t));
+        if (last > first) {
+            fps_ = (frames - 1) * kSerTicksPerSecond / static_cast<double>(last - first);
+            timestamps_ = trailer;
+        }
+    }
+}
+
+void RawVideoReader::parseAvi(const std::string& path) {
+    const uint8_t* data = file_.data();
+    const size_t size = file_.size();
+
+    const AviFormat format = parseAviHeader(data, size);
+    if (!isSupportedAvi(format)) {
+        throw std::runtime_error("Not a SER or uncompressed AVI file: " + path);
+    }
+
+    width_ = format.width;
+    height_ = format.height;
+    bit_depth_ = 8;
+    channels_ = format.bit_count == 24 ? 3 : 1;
+    color_ = channels_ == 3 ? ColorFormat::kBgr : ColorFormat::kMono;
+    bottom_up_ = format.bottom_up;
+    fps_ = format.fps;
+    // BI_RGB rows are padded to 4 bytes
+    row_stride_ = format.compression == kBiRgb
+        ? ((static_cast<size_t>(width_) * format.bit_count + 31) / 32) * 4
+        : static_cast<size_t>(width_);
+    const size_t frame_bytes = row_stride_ * height_;
+
+    // Frame chunks are "NNdb"/"NNdc" for video stream NN, inside "movi"
+    // lists. OpenDML files continue in further RIFF "AVIX" chunks, so scan
+    // every top-level RIFF instead of trusting the 1 GB-limited idx1.
+    char stream_id[3];
+    std::snprintf(stream_id, sizeof(stream_id), "%02d", format.stream);
+
+    size_t pos = 0;
+    while (pos + 12 <= size && isFourcc(data + pos, "RIFF")) {
+        const size_t riff_size = readU32(data + pos + 4);
+        // Writers that crashed leave a zero size; take the rest of the file
+        const size_t riff_end = riff_size == 0 ? size : std::min(size, pos + 8 + riff_size);
+        walkChunks(data, pos + 12, riff_end,
+            [](const uint8_t* type) {
+                return isFourcc(type, "movi") || isFourcc(type, "rec ");
+            },
+            [&](const uint8_t* id, size_t body, size_t length) {
+                // Dropped frames are written as empty chunks; skip them
+                if (std::memcmp(id, stream_id, 2) == 0 &&
+                    (std::memcmp(id + 2, "db", 2) == 0 || std::memcmp(id + 2, "dc", 2) == 0) &&
+                    length >= frame_bytes) {
+                    offsets_.push_back(body);
+                }
+            });
+        pos = riff_end + (riff_end & 1);
+    }
+}
+
+bool RawVideoReader::isBayer() const {
+    return color_ == ColorFormat::kBayerRggb || color_ == ColorFormat::kBayerGrbg ||
+           color_ == ColorFormat::kBayerGbrg || color_ == ColorFormat::kBayerBggr;
+}
+
+double RawVideoReader::timestamp(int64_t index) const {
+    if (index < 0 || index >= getFrameCount()) {
+        throw std::out_of_range("Frame index out of range: " + std::to_string(index));
+    }
+    if (timestamps_ > 0) {
+        const uint8_t* trailer = file_.data() + timestamps_;
+        const int64_t ticks = readI64(trailer + static_cast<size_t>(index) * sizeof(int64_t)) - readI64(trailer);
+        return ticks / kSerTicksPerSecond;
+    }
+    return fps_ > 0 ? index / fps_ : 0.0;
+}
+
+cv::Mat RawVideoReader::frame(int64_t index) const {
+    if (index < 0 || index >= getFrameCount()) {
+        throw std::out_of_range("Frame index out of range: " + std::to_string(index));
+    }
+    const int depth = bit_depth_ > 8 ? CV_16U : CV_8U;
+    // The mapping is read-only; callers that modify frames must clone
+    return cv::Mat(height_, width_, CV_MAKETYPE(depth, channels_),
+                   const_cast<uint8_t*>(file_.data() + offsets_[static_cast<size_t>(index)]),
+                   row_stride_);
+}
+
+// Frame [index] in host byte order, top row first (a view when possible)
+cv::Mat RawVideoReader::normalized(int64_t index, const cv::Rect& roi) const {
+    cv::Mat raw = frame(index);
+    if (roi.area() > 0) {
+        // Crop the stored rows before any copy; bottom-up rows are mirrored
+        const int y = bottom_up_ ? raw.rows - roi.y - roi.height : roi.y;
+        raw = raw(cv::Rect(roi.x, y, roi.width, roi.height));
+    }
+    if (bottom_up_) {
+        cv::Mat flipped;
+        cv::flip(raw, flipped, 0);
+        return flipped;
+    }
+    if (big_endian_ && raw.depth() == CV_16U) {
+        cv::Mat swapped(raw.rows, raw.cols, raw.type());
+        for (int y = 0; y < raw.rows; ++y) {
+            const uint16_t* src = raw.ptr<uint16_t>(y);
+            uint16_t* dst = swapped.ptr<uint16_t>(y);
+            const int count = raw.cols * raw.channels();
+            for (int x = 0; x < count; ++x) {
+                dst[x] = static_cast<uint16_t>((src[x] >> 8) | (src[x] << 8));
+            }
+        }
+        return swapped;
+    }
+    return raw;
+}
+
+bool RawVideoReader::toLuma(int64_t index, cv::Mat& gray, int downscale, const cv::Rect& roi) const {
+    const cv::Rect bounds(0, 0, width_, height_);
+    cv::Rect region = roi & bounds;
+    cv::Rect inner;     // [roi] within [region] when it had to be widened
+    if (region.area() > 0 && isBayer()) {
+        // Keep whole 2x2 cells so the crop has the frame's Bayer pattern
+        const int x0 = region.x & ~1;
+        const int y0 = region.y & ~1;
+        const int x1 = std::min((region.x + region.width + 1) & ~1, width_ & ~1);
+        const int y1 = std::min((region.y + region.height + 1) & ~1, height_ & ~1);
+        const cv::Rect aligned(x0, y0, x1 - x0, y1 - y0);
+        if (downscale <= 1 && aligned.area() > 0) {
+            inner = cv::Rect(region.x - x0, region.y - y0, region.width, region.height) &
+                    cv::Rect(0, 0, aligned.width, aligned.height);
+        }
+        region = aligned;
+    }
+
+    cv::Mat plane = normalized(index, region);
+    bool view = !bottom_up_ && !(big_endian_ && plane.depth() == CV_16U);
+
+    if (channels_ == 3) {
+        cv::Mat converted;
+        cv::cvtColor(plane, converted, color_ == ColorFormat::kRgb ? cv::COLOR_RGB2GRAY : cv::COLOR_BGR2GRAY);
+        plane = converted;
+        view = false;
+    } else if (isBayer() && downscale <= 1) {
+        cv::Mat converted;
+        cv::cvtColor(plane, converted, bayerCode(color_, true));
+        plane = inner.area() > 0 ? converted(inner) : converted;
+        view = false;
+    }
+
+    if (downscale > 1) {
+        // An even box factor averages whole 2x2 Bayer cells
+        const int factor = isBayer() ? (downscale + 1) / 2 * 2 : downscale;
+        cv::Mat thumb;
+        cv::resize(plane, thumb,
+                   cv::Size(std::max(plane.cols / factor, 1), std::max(plane.rows / factor, 1)),
+                   0, 0, cv::INTER_AREA);
+        plane = thumb;
+        view = false;
+    }
+
+    if (plane.depth() != CV_8U) {
+        cv::Mat scaled;
+        plane.convertTo(scaled, CV_8U, 255.0 / ((1 << bit_depth_) - 1));
+        plane = scaled;
+        view = false;
+    }
+
+    gray = plane;
+    return view;
+}
+
+void RawVideoReader::toBgr(int64_t index, cv::Mat& bgr) const {
+    cv::Mat plane = normalized(index);
+
+    // Scale to 8 bits first: cheaper on the single-channel mosaic
+    if (plane.depth() != CV_8U) {
+        cv::Mat scaled;
+        plane.convertTo(scaled, CV_8U, 255.0 / ((1 << bit_depth_) - 1));
+        plane = scaled;
+    }
+
+    if (isBayer()) {
+        cv::cvtColor(plane, bgr, bayerCode(color_, false));
+    } else if (color_ == ColorFormat::kRgb) {
+        cv::cvtColor(plane, bgr, cv::COLOR_RGB2BGR);
+    } else if (color_ == ColorFormat::kBgr) {
+        plane.copyTo(bgr);
+    } else {
+        cv::cvtColor(plane, bgr, cv::COLOR_GRAY2BGR);
+    }
+}
+
+} // namespace planetary
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "MappedFile.hpp"
+
+namespace planetary {
+
+/// Reader for uncompressed planetary captures: SER and raw AVI.
+///
+/// Astronomy cameras record these as plain arrays of fixed-size frames, so
+/// there is nothing to decode: the file is memory-mapped and each frame is
+/// a pointer into the mapping. Frames are independent, so random access is
+/// as cheap as sequential access and any number of threads can read at
+/// once (every method is const after construction).
+///
+/// SER: mono, Bayer and RGB/BGR, 8 or 16 bits per sample (any depth up to
+/// 16 stored in 16-bit words). Raw AVI: 8-bit gray (Y800/GREY or BI_RGB
+/// with a palette) and 24-bit BI_RGB, including OpenDML files over 1 GB.
+class RawVideoReader {
+public:
+    enum class ColorFormat {
+        kMono,
+        kBayerRggb,
+        kBayerGrbg,
+        kBayerGbrg,
+        kBayerBggr,
+        kRgb,
+        kBgr,
+    };
+
+    /// True when [path] is a SER file or an AVI with an uncompressed video
+    /// stream (checks the header only)
+    static bool isRawVideo(const std::string& path);
+
+    /// Map [path]. Throws std::runtime_error if it is not a supported
+    /// raw format.
+    explicit RawVideoReader(const std::string& path);
+
+    int64_t getFrameCount() const { return static_cast<int64_t>(offsets_.size()); }
+    int getWidth() const { return width_; }
+    int getHeight() const { return height_; }
+
+    /// Frame rate from the SER timestamps or the AVI header (0 if unknown)
+    double getFPS() const { return fps_; }
+
+    /// Capture time of frame [index] in seconds after the first frame:
+    /// the SER timestamp when the file has them, otherwise derived from
+    /// the frame rate (0 if that is unknown too)
+    double timestamp(int64_t index) const;
+
+    ColorFormat colorFormat() const { return color_; }
+    bool isBayer() const;
+
+    /// Significant bits per sample (8 for 8-bit data, up to 16)
+    int bitDepth() const { return bit_depth_; }
+
+    /// Frame [index] exactly as stored: a zero-copy view into the mapping
+    /// (CV_8U or CV_16U, 1 or 3 channels), valid while the reader lives.
+    /// 16-bit samples may be big-endian and AVI rows may be stored bottom
+    /// up; toLuma() and toBgr() take care of both.
+    cv::Mat frame(int64_t index) const;
+
+    /// 8-bit luma of frame [index]. Bayer frames are box-averaged over 2x2
+    /// cells, which cancels the colour mosaic (and halves the size) when
+    /// [downscale] > 1. A non-empty [roi] (frame coordinates) converts
+    /// only that region; with Bayer data and [downscale] > 1 it is widened
+    /// to whole cells. Returns true when [gray] is a zero-copy view.
+    bool toLuma(int64_t index, cv::Mat& gray, int downscale = 1,
+                const cv::Rect& roi = cv::Rect()) const;
+
+    /// Frame [index] as 8-bit BGR (debayered for Bayer data)
+    void toBgr(int64_t index, cv::Mat& bgr) const;
+
+private:
+    void parseSer(const std::string& path);
+    void parseAvi(const std::string& path);
+    cv::Mat normalized(int64_t index, const cv::Rect& roi = cv::Rect()) const;
+
+    MappedFile file_;
+    std::vector<uint64_t> offsets_;   // Byte offset of each frame
+
+    int width_ = 0;
+    int height_ = 0;
+    int bit_depth_ = 8;
+    int channels_ = 1;
+    size_t row_stride_ = 0;
+    ColorFormat color_ = ColorFormat::kMono;
+    bool big_endian_ = false;
+    bool bottom_up_ = false;
+    double fps_ = 0.0;
+    size_t timestamps_ = 0;           // Offset of the SER timestamp trailer (0 = none)
+};
+
+} // namespace planetary
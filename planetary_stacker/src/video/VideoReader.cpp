@@ -0,0 +1,426 @@
+#include "VideoReader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <stdexcept>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avutil.h>
+}
+
+namespace planetary {
+
+namespace {
+
+std::string avError(int code) {
+    char buffer[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(code, buffer, sizeof(buffer));
+    return buffer;
+}
+
+// Forward seeks shorter than this are decoded through instead of seeking,
+// since a seek always restarts from the previous keyframe anyway.
+constexpr int64_t kMaxDecodeAhead = 60;
+
+} // namespace
+
+VideoReader::VideoReader(const std::string& path, const FrameIndex* index, const DecodeOptions& decode) {
+    int ret = avformat_open_input(&format_ctx_, path.c_str(), nullptr, nullptr);
+    if (ret < 0) {
+        throw std::runtime_error("Cannot open video: " + path + " (" + avError(ret) + ")");
+    }
+
+    // Probing decodes frames from the start of the file; with an index the
+    // container header is enough as long as it carries the frame size
+    bool probed = false;
+    if (index == nullptr || index->empty()) {
+        ret = avformat_find_stream_info(format_ctx_, nullptr);
+        if (ret < 0) {
+            avformat_close_input(&format_ctx_);
+            throw std::runtime_error("Cannot read stream info: " + avError(ret));
+        }
+        probed = true;
+    }
+
+    const AVCodec* codec = nullptr;
+    stream_index_ = av_find_best_stream(format_ctx_, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (!probed && (stream_index_ < 0 || format_ctx_->streams[stream_index_]->codecpar->width <= 0)) {
+        ret = avformat_find_stream_info(format_ctx_, nullptr);
+        if (ret < 0) {
+            avformat_close_input(&format_ctx_);
+            throw std::runtime_error("Cannot read stream info: " + avError(ret));
+        }
+        stream_index_ = av_find_best_stream(format_ctx_, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    }
+    if (stream_index_ < 0 || codec == nullptr) {
+        avformat_close_input(&format_ctx_);
+        throw std::runtime_error("No decodable video stream found in: " + path);
+    }
+
+    AVStream* stream = format_ctx_->streams[stream_index_];
+
+    codec_ctx_ = avcodec_alloc_context3(codec);
+    if (codec_ctx_ == nullptr ||
+        avcodec_parameters_to_context(codec_ctx_, stream->codecpar) < 0) {
+        avcodec_free_context(&codec_ctx_);
+        avformat_close_input(&format_ctx_);
+        throw std::runtime_error("Cannot create decoder context");
+    }
+
+    // Let libavcodec pick the thread count unless the caller splits the
+    // cores itself; frame threading keeps sequential decode throughput
+    // high on multi-core phones.
+    codec_ctx_->thread_count = std::max(decode.threads, 0);
+    codec_ctx_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    codec_ctx_->pkt_timebase = stream->time_base;
+
+    codec_ctx_->lowres = std::clamp(decode.lowres, 0, static_cast<int>(codec->max_lowres));
+    if (decode.skip_loop_filter) {
+        codec_ctx_->skip_loop_filter = AVDISCARD_ALL;
+    }
+    reduced_quality_ = codec_ctx_->lowres > 0 || decode.skip_loop_filter;
+
+    ret = avcodec_open2(codec_ctx_, codec, nullptr);
+    if (ret < 0) {
+        avcodec_free_context(&codec_ctx_);
+        avformat_close_input(&format_ctx_);
+        throw std::runtime_error("Cannot open decoder: " + avError(ret));
+    }
+
+    frame_ = av_frame_alloc();
+    packet_ = av_packet_alloc();
+    if (frame_ == nullptr || packet_ == nullptr) {
+        av_frame_free(&frame_);
+        av_packet_free(&packet_);
+        avcodec_free_context(&codec_ctx_);
+        avformat_close_input(&format_ctx_);
+        throw std::runtime_error("Out of memory allocating decoder buffers");
+    }
+
+    time_base_ = av_q2d(stream->time_base);
+    start_pts_ = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+
+    if (stream->avg_frame_rate.num > 0 && stream->avg_frame_rate.den > 0) {
+        fps_ = av_q2d(stream->avg_frame_rate);
+    } else if (stream->r_frame_rate.num > 0 && stream->r_frame_rate.den > 0) {
+        fps_ = av_q2d(stream->r_frame_rate);
+    } else {
+        fps_ = 30.0;
+    }
+
+    if (stream->nb_frames > 0) {
+        frame_count_ = stream->nb_frames;
+    } else if (stream->duration != AV_NOPTS_VALUE) {
+        frame_count_ = std::llround(stream->duration * time_base_ * fps_);
+    } else if (format_ctx_->duration != AV_NOPTS_VALUE) {
+        frame_count_ = std::llround(format_ctx_->duration / static_cast<double>(AV_TIME_BASE) * fps_);
+    }
+
+    if (index != nullptr && !index->empty()) {
+        index_ = *index;
+        recording_valid_ = false;
+        start_pts_ = index_.start_pts;
+        frame_count_ = index_.frameCount();
+        if (index_.fps() > 0) {
+            fps_ = index_.fps();
+        }
+    }
+}
+
+std::unique_ptr<VideoReader> VideoReader::openIndexed(const std::string& path) {
+    FrameIndex index;
+    if (FrameIndex::load(path, index)) {
+        return std::make_unique<VideoReader>(path, &index);
+    }
+
+    auto reader = std::make_unique<VideoReader>(path);
+    reader->buildIndex().save(path);
+    return reader;
+}
+
+VideoReader::~VideoReader() {
+    av_packet_free(&packet_);
+    av_frame_free(&frame_);
+    avcodec_free_context(&codec_ctx_);
+    avformat_close_input(&format_ctx_);
+}
+
+int64_t VideoReader::getFrameCount() const {
+    return frame_count_;
+}
+
+int VideoReader::getWidth() const {
+    return format_ctx_->streams[stream_index_]->codecpar->width;
+}
+
+int VideoReader::getHeight() const {
+    return format_ctx_->streams[stream_index_]->codecpar->height;
+}
+
+int VideoReader::lowres() const {
+    return codec_ctx_->lowres;
+}
+
+double VideoReader::getFPS() const {
+    return fps_;
+}
+
+bool VideoReader::decodeNext() {
+    while (true) {
+        int ret = avcodec_receive_frame(codec_ctx_, frame_);
+        if (ret == 0) {
+            return true;
+        }
+        if (ret == AVERROR_EOF || (ret == AVERROR(EAGAIN) && draining_)) {
+            eof_ = true;
+            adoptRecording();
+            return false;
+        }
+        if (ret != AVERROR(EAGAIN)) {
+            throw std::runtime_error("Decode error: " + avError(ret));
+        }
+
+        ret = av_read_frame(format_ctx_, packet_);
+        if (ret < 0) {
+            // End of file: flush frames still buffered in the decoder
+            draining_ = true;
+            avcodec_send_packet(codec_ctx_, nullptr);
+            continue;
+        }
+
+        if (packet_->stream_index == stream_index_) {
+            if (recording_valid_) {
+                recordPacket(recording_);
+            }
+            ret = avcodec_send_packet(codec_ctx_, packet_);
+            // Corrupt packets are common in phone recordings; skip them
+            if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_INVALIDDATA) {
+                av_packet_unref(packet_);
+                throw std::runtime_error("Decode error: " + avError(ret));
+            }
+        }
+        av_packet_unref(packet_);
+    }
+}
+
+bool VideoReader::grab() {
+    if (eof_) {
+        return false;
+    }
+
+    if (!decodeNext()) {
+        return false;
+    }
+
+    const int64_t pts = frame_->best_effort_timestamp;
+    if (pts != AV_NOPTS_VALUE && (position_ < 0 || hasIndex())) {
+        // Exact when the timestamp table is known; otherwise only used to
+        // resynchronise after open or seek
+        position_ = indexFromPts(pts);
+    } else {
+        ++position_;
+    }
+    return true;
+}
+
+void VideoReader::retrieve(cv::Mat& bgr) {
+    if (position_ < 0) {
+        throw std::logic_error("retrieve() called before grab()");
+    }
+
+    converter_.toBgr(frame_, bgr);
+}
+
+bool VideoReader::retrieveLuma(cv::Mat& gray) {
+    if (position_ < 0) {
+        throw std::logic_error("retrieveLuma() called before grab()");
+    }
+    return converter_.toLuma(frame_, gray);
+}
+
+void VideoReader::retrieveFrame(DecodedFrame& out) {
+    if (position_ < 0) {
+        throw std::logic_error("retrieveFrame() called before grab()");
+    }
+
+    out.reset();
+    out.frame_ = av_frame_alloc();
+    if (out.frame_ == nullptr || av_frame_ref(out.frame_, frame_) < 0) {
+        out.reset();
+        throw std::runtime_error("Out of memory referencing decoded frame");
+    }
+    out.index_ = position_;
+    out.timestamp_ = timestamp();
+}
+
+double VideoReader::timestamp() const {
+    if (position_ < 0 || frame_->best_effort_timestamp == AV_NOPTS_VALUE) {
+        return fps_ > 0 ? position_ / fps_ : 0.0;
+    }
+    return (frame_->best_effort_timestamp - start_pts_) * time_base_;
+}
+
+int64_t VideoReader::indexFromPts(int64_t pts) const {
+    if (hasIndex()) {
+        return index_.indexFromPts(pts);
+    }
+    return std::llround((pts - start_pts_) * time_base_ * fps_);
+}
+
+int64_t VideoReader::ptsFromIndex(int64_t index) const {
+    if (hasIndex()) {
+        return index_.entries[std::clamp<int64_t>(index, 0, index_.frameCount() - 1)].pts;
+    }
+    return start_pts_ + std::llround(index / fps_ / time_base_);
+}
+
+void VideoReader::resetDecoder() {
+    avcodec_flush_buffers(codec_ctx_);
+    position_ = -1;
+    draining_ = false;
+    eof_ = false;
+}
+
+void VideoReader::rewind() {
+    av_seek_frame(format_ctx_, stream_index_, start_pts_, AVSEEK_FLAG_BACKWARD);
+    resetDecoder();
+
+    // A decode from the start sees every packet again
+    recording_.entries.clear();
+    recording_valid_ = !hasIndex();
+}
+
+void VideoReader::recordPacket(FrameIndex& index) const {
+    const int64_t pts = packet_->pts != AV_NOPTS_VALUE ? packet_->pts : packet_->dts;
+    if (pts == AV_NOPTS_VALUE) {
+        return;
+    }
+    FrameIndex::Entry entry{};
+    entry.pts = pts;
+    entry.pos = packet_->pos;
+    entry.flags = (packet_->flags & AV_PKT_FLAG_KEY) ? FrameIndex::kKeyframe : 0;
+    index.entries.push_back(entry);
+}
+
+void VideoReader::fillIndexHeader(FrameIndex& index) const {
+    const AVStream* stream = format_ctx_->streams[stream_index_];
+    index.width = getWidth();
+    index.height = getHeight();
+    index.time_base_num = stream->time_base.num;
+    index.time_base_den = stream->time_base.den;
+
+    AVRational rate = stream->avg_frame_rate;
+    if (rate.num <= 0 || rate.den <= 0) {
+        rate = stream->r_frame_rate;
+    }
+    if (rate.num <= 0 || rate.den <= 0) {
+        rate = AVRational{30, 1};
+    }
+    index.fps_num = rate.num;
+    index.fps_den = rate.den;
+    index.start_pts = start_pts_;
+}
+
+void VideoReader::adoptRecording() {
+    if (!recording_valid_ || recording_.empty()) {
+        return;
+    }
+    recording_valid_ = false;
+    recording_.finalize();
+    fillIndexHeader(recording_);
+    index_ = std::move(recording_);
+    recording_ = FrameIndex();
+    frame_count_ = index_.frameCount();
+}
+
+const FrameIndex& VideoReader::buildIndex() {
+    rewind();
+    recording_valid_ = false;
+
+    FrameIndex index;
+    index.entries.reserve(frame_count_ > 0 ? frame_count_ : 1024);
+
+    // Only packet headers are inspected; nothing is sent to the decoder
+    while (av_read_frame(format_ctx_, packet_) >= 0) {
+        if (packet_->stream_index == stream_index_) {
+            recordPacket(index);
+        }
+        av_packet_unref(packet_);
+    }
+
+    // Packets arrive in decode order; presentation order is timestamp order
+    index.finalize();
+    fillIndexHeader(index);
+    index_ = std::move(index);
+    if (!index_.empty()) {
+        frame_count_ = index_.frameCount();
+    }
+
+    rewind();
+    return index_;
+}
+
+bool VideoReader::seek(int64_t index) {
+    // A partial decode must not be mistaken for a complete index
+    recording_valid_ = false;
+
+    if (!hasIndex()) {
+        if (av_seek_frame(format_ctx_, stream_index_, ptsFromIndex(index), AVSEEK_FLAG_BACKWARD) < 0) {
+            return false;
+        }
+        resetDecoder();
+        return true;
+    }
+
+    // Land exactly on the GOP start; fall back to its byte offset for
+    // demuxers that cannot seek by timestamp (e.g. raw streams)
+    const FrameIndex::Entry& key = index_.entries[index_.keyframeAtOrBefore(index)];
+    int ret = av_seek_frame(format_ctx_, stream_index_, key.pts, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0 && key.pos >= 0) {
+        ret = av_seek_frame(format_ctx_, stream_index_, key.pos, AVSEEK_FLAG_BYTE);
+    }
+    if (ret < 0) {
+        return false;
+    }
+
+    resetDecoder();
+    return true;
+}
+
+cv::Mat VideoReader::readFrame(int64_t index) {
+    if (index < 0) {
+        return cv::Mat();
+    }
+
+    // Seek unless the frame is a short decode ahead of the current position
+    if (index < position_ || index > position_ + kMaxDecodeAhead || position_ < 0) {
+        if (!seek(index)) {
+            return cv::Mat();
+        }
+    }
+
+    while (position_ < index) {
+        if (!grab()) {
+            return cv::Mat();
+        }
+    }
+
+    cv::Mat bgr;
+    retrieve(bgr);
+    return bgr;
+}
+
+cv::Mat VideoReader::readFrameROI(int64_t index, const cv::Rect& roi) {
+    cv::Mat frame = readFrame(index);
+    if (frame.empty()) {
+        return frame;
+    }
+
+    const cv::Rect clipped = roi & cv::Rect(0, 0, frame.cols, frame.rows);
+    return frame(clipped).clone();
+}
+
+} // namespace planetary
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "DecodedFrame.hpp"
+#include "FrameConverter.hpp"
+#include "FrameIndex.hpp"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+
+namespace planetary {
+
+/// Decoder speed/quality trade-offs for passes that only rank frames
+struct DecodeOptions {
+    /// Ask the codec to decode at 1/2^lowres resolution (0 = full).
+    /// Only some codecs support it; the value is clamped to what the
+    /// codec allows (see VideoReader::lowres()).
+    int lowres = 0;
+
+    /// Skip the in-loop deblocking filter (H.264/HEVC). Much cheaper on
+    /// 4K, but frames carry block artefacts and must not be stacked.
+    bool skip_loop_filter = false;
+
+    /// Decoder threads (0 = let libavcodec choose). Set when several
+    /// readers decode segments of the same file side by side.
+    int threads = 0;
+};
+
+/// Streaming video decoder built on libavformat/libavcodec.
+///
+/// Frames are decoded sequentially and handed to the caller in memory, so
+/// the analysis stage never touches intermediate image files. Decoding and
+/// colour conversion are split (grab/retrieve, like cv::VideoCapture) so that
+/// frames skipped by sampling are decoded but never converted.
+///
+/// With a FrameIndex attached, frame numbers and seeks are exact; without
+/// one they are derived from timestamps and the nominal frame rate.
+class VideoReader {
+public:
+    using Keyframe = FrameIndex::Keyframe;
+
+    /// Open [path]. When [index] is given (e.g. loaded from the sidecar),
+    /// stream probing is skipped and frame numbering uses the index.
+    explicit VideoReader(
+        const std::string& path,
+        const FrameIndex* index = nullptr,
+        const DecodeOptions& decode = DecodeOptions()
+    );
+    ~VideoReader();
+
+    VideoReader(const VideoReader&) = delete;
+    VideoReader& operator=(const VideoReader&) = delete;
+
+    /// Open [path] with its sidecar index, building and saving the index
+    /// first if it is missing or stale.
+    static std::unique_ptr<VideoReader> openIndexed(const std::string& path);
+
+    /// Exact frame count when indexed, otherwise the container's estimate
+    int64_t getFrameCount() const;
+
+    /// Full-resolution frame size of the stream (independent of lowres)
+    int getWidth() const;
+    int getHeight() const;
+    double getFPS() const;
+
+    /// Low-resolution decode level in effect (frames are 1/2^lowres size)
+    int lowres() const;
+
+    /// True when decoded frames are degraded by DecodeOptions and only
+    /// suitable for ranking, not stacking
+    bool isReducedQuality() const { return reduced_quality_; }
+
+    /// Decode the next frame in presentation order.
+    /// Returns false at end of stream.
+    bool grab();
+
+    /// Convert the most recently grabbed frame to BGR.
+    /// Reuses the storage of [bgr] when it already has the right size.
+    void retrieve(cv::Mat& bgr);
+
+    /// Luma (Y) plane of the most recently grabbed frame as 8-bit grayscale.
+    ///
+    /// For 8-bit YUV and gray decoder output this is a zero-copy view into
+    /// the decoded frame, valid only until the next grab()/seek. Other
+    /// formats are converted into an internal buffer.
+    /// Returns true when [gray] is a zero-copy view.
+    bool retrieveLuma(cv::Mat& gray);
+
+    /// Reference the most recently grabbed frame without copying pixels,
+    /// so it can be converted later (e.g. on another thread) with a
+    /// FrameConverter
+    void retrieveFrame(DecodedFrame& out);
+
+    /// Index of the most recently grabbed frame (0-based, -1 before first grab)
+    int64_t position() const { return position_; }
+
+    /// Presentation timestamp of the most recently grabbed frame, in seconds
+    double timestamp() const;
+
+    /// Demux-only pass over the video packets (no decoding) that builds the
+    /// frame index and attaches it. Rewinds to the start when done.
+    const FrameIndex& buildIndex();
+
+    /// True once an index is attached: passed in, built, or recorded by a
+    /// complete sequential decode from the start of the file
+    bool hasIndex() const { return !index_.empty(); }
+    const FrameIndex& index() const { return index_; }
+
+    /// Keyframes from the index (empty when not indexed)
+    std::vector<Keyframe> keyframes() const { return index_.keyframes(); }
+
+    /// Seek so that the next grab() returns the keyframe at or before
+    /// [index]. Returns false if the demuxer cannot seek.
+    bool seek(int64_t index);
+
+    /// Seek to [index] and return that frame as BGR (empty on failure)
+    cv::Mat readFrame(int64_t index);
+
+    /// Seek to [index] and return the [roi] crop of that frame as BGR
+    cv::Mat readFrameROI(int64_t index, const cv::Rect& roi);
+
+private:
+    bool decodeNext();
+    int64_t indexFromPts(int64_t pts) const;
+    int64_t ptsFromIndex(int64_t index) const;
+    void resetDecoder();
+    void rewind();
+    void recordPacket(FrameIndex& index) const;
+    void fillIndexHeader(FrameIndex& index) const;
+    void adoptRecording();
+
+    AVFormatContext* format_ctx_ = nullptr;
+    AVCodecContext* codec_ctx_ = nullptr;
+    AVFrame* frame_ = nullptr;
+    AVPacket* packet_ = nullptr;
+    FrameConverter converter_;
+
+    int stream_index_ = -1;
+    double time_base_ = 0.0;
+    double fps_ = 0.0;
+    int64_t start_pts_ = 0;
+    int64_t frame_count_ = 0;
+
+    FrameIndex index_;
+
+    // Packets seen by a sequential decode from the start; becomes the
+    // index at end of stream unless a seek interrupts it
+    FrameIndex recording_;
+    bool recording_valid_ = true;
+
+    bool reduced_quality_ = false;
+    int64_t position_ = -1;
+    bool draining_ = false;
+    bool eof_ = false;
+};
+
+} // namespace planetary
@@ -0,0 +1,119 @@
+import 'dart:math' as math;
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:planetary_stacker/src/quality/score_statistics.dart';
+
+// Exact median of [values] (sorts a copy)
+double _median(List<double> values) {
+  final sorted = List<double>.from(values)..sort();
+  final mid = sorted.length ~/ 2;
+  return sorted.length.isOdd ? sorted[mid] : (sorted[mid - 1] + sorted[mid]) / 2;
+}
+
+// Standard normal sample (Box-Muller)
+double _gaussian(math.Random random) {
+  final u = 1 - random.nextDouble();
+  return math.sqrt(-2 * math.log(u)) * math.cos(2 * math.pi * random.nextDouble());
+}
+
+void main() {
+  group('P2Quantile', () {
+    test('is NaN before any value', () {
+      expect(P2Quantile(0.5).value, isNaN);
+    });
+
+    test('is exact up to five values', () {
+      final median = P2Quantile(0.5);
+      for (final v in [9.0, 1.0, 7.0, 3.0, 5.0]) {
+        median.add(v);
+      }
+      expect(median.count, 5);
+      expect(median.value, 5.0);
+    });
+
+    test('tracks the median of 200k samples within 0.1%', () {
+      final random = math.Random(2024);
+      final distributions = <String, double Function()>{
+        'gaussian': () => 100 + 15 * _gaussian(random),
+        'exponential': () => -50 * math.log(1 - random.nextDouble()),
+        'log-normal': () => math.exp(5 + 0.5 * _gaussian(random)),
+      };
+
+      distributions.forEach((name, sample) {
+        final estimate = P2Quantile(0.5);
+        final values = <double>[];
+        for (int i = 0; i < 200000; i++) {
+          final v = sample();
+          values.add(v);
+          estimate.add(v);
+        }
+        final exact = _median(values);
+        expect((estimate.value - exact).abs() / exact, lessThan(0.001), reason: name);
+      });
+    });
+  });
+
+  group('ScoreStatistics', () {
+    test('summarises a stream and skips NaN', () {
+      final stats = ScoreStatistics();
+      for (final v in [4.0, double.nan, 2.0, 8.0, 6.0]) {
+        stats.add(v);
+      }
+      expect(stats.count, 4);
+      expect(stats.min, 2.0);
+      expect(stats.max, 8.0);
+      expect(stats.mean, closeTo(5.0, 1e-12));
+      expect(stats.normalize(2.0), 0.0);
+      expect(stats.normalize(5.0), 0.5);
+      expect(stats.normalize(8.0), 1.0);
+    });
+
+    test('normalises equal values to 1', () {
+      final stats = ScoreStatistics()
+        ..add(3.0)
+        ..add(3.0);
+      expect(stats.normalize(3.0), 1.0);
+    });
+
+    test('reports zeros when empty', () {
+      final stats = ScoreStatistics();
+      expect(stats.count, 0);
+      expect(stats.min, 0);
+      expect(stats.max, 0);
+      expect(stats.median, 0);
+    });
+  });
+
+  group('selectTop', () {
+    double identity(double v) => v;
+
+    test('returns the best k, best first', () {
+      expect(selectTop([3.0, 9.0, 1.0, 7.0, 5.0], 3, identity), [9.0, 7.0, 5.0]);
+    });
+
+    test('keeps the earlier item on ties', () {
+      final items = [(0, 1.0), (1, 2.0), (2, 2.0), (3, 1.0), (4, 2.0)];
+      final top = selectTop(items, 3, ((int, double) item) => item.$2);
+      expect(top.map((item) => item.$1), [1, 2, 4]);
+      final all = selectTop(items, items.length, ((int, double) item) => item.$2);
+      expect(all.map((item) => item.$1), [1, 2, 4, 0, 3]);
+    });
+
+    test('matches a full stable sort', () {
+      final random = math.Random(7);
+      final values = [for (int i = 0; i < 5000; i++) random.nextInt(100).toDouble()];
+      final order = List<int>.generate(values.length, (i) => i)
+        ..sort((a, b) => values[a] != values[b] ? values[b].compareTo(values[a]) : a - b);
+      for (final k in [1, 10, 250, 5000]) {
+        expect(selectTop(List<int>.generate(values.length, (i) => i), k, (int i) => values[i]),
+            order.take(k).toList());
+      }
+    });
+
+    test('skips NaN and handles k outside the input', () {
+      expect(selectTop([1.0, double.nan, 2.0], 5, identity), [2.0, 1.0]);
+      expect(selectTop([1.0, 2.0], 0, identity), isEmpty);
+      expect(selectTop(<double>[], 3, identity), isEmpty);
+    });
+  });
+}